@@ -0,0 +1,23 @@
+#version 330 core
+
+// One axis of the separable Gaussian blur. Neighbouring taps are folded into single bilinear
+// fetches at weighted offsets, so the 13-tap kernel costs 7 texture reads per axis.
+in vec2 uv;
+
+out vec4 fragColor;
+
+uniform sampler2D inputTexture;
+uniform vec2 texelStep;            // One texel along the blur axis
+uniform float centerWeight;
+uniform float blurOffsets[3];
+uniform float blurWeights[3];
+
+void main() {
+    vec4 sum = texture(inputTexture, uv) * centerWeight;
+    for (int i = 0; i < 3; i++) {
+        vec2 offset = blurOffsets[i] * texelStep;
+        sum += texture(inputTexture, uv + offset) * blurWeights[i];
+        sum += texture(inputTexture, uv - offset) * blurWeights[i];
+    }
+    fragColor = sum;
+}
@@ -2,6 +2,8 @@
 
 in vec3 pos_world;
 in vec3 normal_world;
+in vec3 tangent_world;
+in vec2 uv;
 
 out vec4 fragColor;
 
@@ -10,12 +12,27 @@ uniform float k_d;
 uniform float k_s;
 
 uniform vec4 camera_pos;
+uniform vec4 camera_look;
 
 uniform vec4 cAmbient;
 uniform vec4 cDiffuse;
 uniform vec4 cSpecular;
 uniform float shininess;
 
+// Material texture on unit 0. useTexture stays false until the streamed texture is
+// resident; meanwhile a 1x1 placeholder is bound and the plain cDiffuse is used.
+uniform sampler2D materialTexture;
+uniform bool useTexture;
+uniform float blend;
+uniform vec2 textureRepeat;
+
+// Height map on unit 2, same streaming rules as materialTexture. Its gradient tilts the
+// normal within the tangent frame, so surface detail does not need more tessellation.
+uniform sampler2D bumpTexture;
+uniform bool useBump;
+uniform vec2 bumpRepeat;
+const float BUMP_DEPTH = 0.02;     // Height of a white texel, relative to one texture repeat
+
 uniform int numLights;
 uniform int lightTypes[8];
 uniform vec4 lightDirs[8];
@@ -25,22 +42,92 @@ uniform vec3 functions[8];
 uniform float angles[8];
 uniform float penumbras[8];
 
+// Shadow atlas: lightShadows[i] is the first tile of light i or -1 if it casts no shadow.
+// Directional lights own 3 consecutive cascade tiles, chosen by camera depth.
+uniform sampler2DShadow shadowAtlas;
+uniform int lightShadows[8];
+uniform mat4 shadowMatrices[16];   // world -> tile-local [0,1]^3
+uniform vec4 shadowTiles[16];      // atlas offset.xy, scale.zw of each tile
+uniform vec4 cascadeEnds;
+
+float shadowFactor(int firstTile, bool cascaded) {
+    if (firstTile < 0) {
+        return 1.0;
+    }
+
+    int tile = firstTile;
+    if (cascaded) {
+        float depth = dot(pos_world - vec3(camera_pos), normalize(vec3(camera_look)));
+        tile += int(depth > cascadeEnds.x) + int(depth > cascadeEnds.y);
+    }
+
+    vec4 p = shadowMatrices[tile] * vec4(pos_world, 1.0);
+    vec3 local = p.xyz / p.w;
+    if (any(lessThan(local, vec3(0.0))) || any(greaterThan(local, vec3(1.0)))) {
+        return 1.0;  // Outside the map: treat as lit
+    }
+
+    // 4 hardware-filtered taps, kept inside the tile so neighbours never bleed in
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    vec4 rect = shadowTiles[tile];
+    vec2 atlasUV = rect.xy + local.xy * rect.zw;
+    vec2 lo = rect.xy + texel;
+    vec2 hi = rect.xy + rect.zw - texel;
+    float lit = 0.0;
+    lit += texture(shadowAtlas, vec3(clamp(atlasUV + vec2(-0.5, -0.5) * texel, lo, hi), local.z));
+    lit += texture(shadowAtlas, vec3(clamp(atlasUV + vec2( 0.5, -0.5) * texel, lo, hi), local.z));
+    lit += texture(shadowAtlas, vec3(clamp(atlasUV + vec2(-0.5,  0.5) * texel, lo, hi), local.z));
+    lit += texture(shadowAtlas, vec3(clamp(atlasUV + vec2( 0.5,  0.5) * texel, lo, hi), local.z));
+    return lit * 0.25;
+}
+
+vec3 bumpedNormal(vec3 normal) {
+    vec3 tangent = normalize(tangent_world - dot(tangent_world, normal) * normal);
+    vec3 bitangent = cross(normal, tangent);
+
+    vec2 p = uv * bumpRepeat;
+    vec2 texel = 1.0 / vec2(textureSize(bumpTexture, 0));
+    float h = texture(bumpTexture, p).r;
+    float dhdu = (texture(bumpTexture, p + vec2(texel.x, 0.0)).r - h) / texel.x;
+    float dhdv = (texture(bumpTexture, p + vec2(0.0, texel.y)).r - h) / texel.y;
+
+    return normalize(normal - BUMP_DEPTH * (dhdu * tangent + dhdv * bitangent));
+}
+
+// Specialized variants are built with NUM_LIGHTS set to the most lights any draw of the
+// scene uses, which gives the loop a small compile-time bound; the generic fallback is
+// bounded by the array size. numLights is the count selected for the current draw.
+#ifdef NUM_LIGHTS
+#define LIGHT_COUNT NUM_LIGHTS
+#else
+#define LIGHT_COUNT 8
+#endif
+
 void main() {
 
     vec3 normal = normalize(normal_world);  // normalize normal vector for the interpolated ones
+    if (useBump) {
+        normal = bumpedNormal(normal);
+    }
+
+    vec4 diffuse = cDiffuse;
+    if (useTexture) {
+        vec4 texel = texture(materialTexture, uv * textureRepeat);
+        diffuse = mix(cDiffuse, texel, blend);
+    }
 
     fragColor = vec4(0.0);
     fragColor += k_a * cAmbient;  // Ambient term
 
-    for (int i = 0; i < numLights; i++) {
+    for (int i = 0; i < LIGHT_COUNT && i < numLights; i++) {
 
-        vec4 lightColor = lightColors[i];
+        vec4 lightColor = lightColors[i] * shadowFactor(lightShadows[i], lightTypes[i] == 0);
 
         if (lightTypes[i] == 0) { // Directional light
             vec4 lightDir = normalize(lightDirs[i]);
             vec4 r = normalize(reflect(lightDir, vec4(normal, 0.f)));
 
-            fragColor += k_d * cDiffuse * max(0.0, dot(normal, -vec3(lightDir))) * lightColor; // Diffusion term
+            fragColor += k_d * diffuse * max(0.0, dot(normal, -vec3(lightDir))) * lightColor; // Diffusion term
             shininess == 0 ? fragColor += k_s * cSpecular * lightColor :
                     fragColor += k_s * cSpecular *
                     pow(max(0, dot(vec3(r), normalize(vec3(camera_pos) - pos_world))), shininess) * lightColor;  // specular term
@@ -52,7 +139,7 @@ void main() {
             float d = length(vec4(pos_world, 1.0f) - lightPos[i]);
             float att = min(1.0f, 1.0f / (functions[i][0] + functions[i][1] * d + functions[i][2] * d * d));
 
-            fragColor += att * k_d * cDiffuse * max(0.0, dot(normal, -vec3(lightDir))) * lightColor; // Diffusion term
+            fragColor += att * k_d * diffuse * max(0.0, dot(normal, -vec3(lightDir))) * lightColor; // Diffusion term
             shininess == 0 ? fragColor += att * k_s * cSpecular * lightColor :
                     fragColor += att * k_s * cSpecular *
                     pow(max(0, dot(vec3(r), normalize(vec3(camera_pos) - pos_world))), shininess) * lightColor;  // specular term
@@ -71,7 +158,7 @@ void main() {
             }
             else if (theta > angles[i]) att = 0;
 
-            fragColor += att * k_d * cDiffuse * max(0.0, dot(normal, -vec3(lightDir))) * lightColor; // Diffusion term
+            fragColor += att * k_d * diffuse * max(0.0, dot(normal, -vec3(lightDir))) * lightColor; // Diffusion term
             shininess == 0 ? fragColor += att * k_s * cSpecular * lightColor :
                     fragColor += att * k_s * cSpecular *
                     pow(max(0, dot(vec3(r), normalize(vec3(camera_pos) - pos_world))), shininess) * lightColor;  // specular term
@@ -3,23 +3,43 @@
 // Task 4: declare a vec3 object-space position variable, using
 //         the `layout` and `in` keywords.
 layout(location = 0) in vec3 pos_obj;
-layout(location = 1) in vec3 normal_obj;
+// Tangent frame as a unit quaternion: rotates +x to the tangent and +z to the normal
+layout(location = 1) in vec4 frame_obj;
+layout(location = 2) in vec2 uv_obj;
+// Per-instance transform of a template instance; the identity for every other draw
+layout(location = 3) in mat4 instance;
 
 // Task 5: declare `out` variables for the world-space position and normal,
 //         to be passed to the fragment shader
 out vec3 pos_world;
 out vec3 normal_world;
+out vec3 tangent_world;
+out vec2 uv;
+
+// Must match depth.vert exactly so the GL_EQUAL main pass after a depth pre-pass passes
+invariant gl_Position;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 proj;
 
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
 void main() {
+    vec3 normal_obj = rotate(frame_obj, vec3(0.0, 0.0, 1.0));
+    vec3 tangent_obj = rotate(frame_obj, vec3(1.0, 0.0, 0.0));
+
+    mat4 world = instance * model;
+
     // Task 8: compute the world-space position and normal, then pass them to
     //         the fragment shader using the variables created in task 5
-    pos_world = vec3(model * vec4(pos_obj, 1));
-    normal_world = normalize(mat3(transpose(inverse(model))) * normal_obj);
+    pos_world = vec3(world * vec4(pos_obj, 1));
+    normal_world = normalize(mat3(transpose(inverse(world))) * normal_obj);
+    tangent_world = normalize(mat3(world) * tangent_obj);
+    uv = uv_obj;
 
     // Task 9: set gl_Position to the object space position transformed to clip space
-    gl_Position = proj * view * model * vec4(pos_obj, 1.0f);
+    gl_Position = proj * view * world * vec4(pos_obj, 1.0f);
 }
@@ -0,0 +1,5 @@
+#version 330 core
+
+// Depth-only pass: color writes are masked off, the rasterizer writes depth on its own.
+void main() {
+}
@@ -0,0 +1,17 @@
+#version 330 core
+
+// Position-only transform for the depth pre-pass. gl_Position is declared invariant
+// here and in default.vert so both passes produce bit-identical depths for GL_EQUAL.
+layout(location = 0) in vec3 pos_obj;
+layout(location = 3) in mat4 instance;
+
+invariant gl_Position;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 proj;
+
+void main() {
+    mat4 world = instance * model;
+    gl_Position = proj * view * world * vec4(pos_obj, 1.0f);
+}
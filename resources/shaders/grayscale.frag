@@ -0,0 +1,14 @@
+#version 330 core
+
+// Per-pixel filter: replaces each color with its Rec. 709 luma (see postprocess/filterkernels.h)
+in vec2 uv;
+
+out vec4 fragColor;
+
+uniform sampler2D inputTexture;
+
+void main() {
+    vec4 color = texture(inputTexture, uv);
+    float luma = dot(color.rgb, vec3(0.2126, 0.7152, 0.0722));
+    fragColor = vec4(vec3(luma), color.a);
+}
@@ -0,0 +1,24 @@
+#version 410 core
+
+// Corners of the coarse patches of shapes/patches.h, passed on to the control shader in world
+// space along with the transforms every vertex refined from them shares
+layout(location = 0) in vec3 pos_obj;
+layout(location = 1) in vec3 surface_obj;   // angle, coordinate along the surface, surface id
+// Per-instance transform of a template instance; the identity for every other draw
+layout(location = 3) in mat4 instance;
+
+// Precise, as the control shader's levels and the evaluated positions that are computed from
+// them must come out the same in the depth and shading programs
+precise out vec3 pos_corner;
+out vec3 surface_corner;
+precise out mat4 world_corner;
+out mat3 normal_corner;
+
+uniform mat4 model;
+
+void main() {
+    world_corner = instance * model;
+    normal_corner = mat3(transpose(inverse(world_corner)));
+    pos_corner = vec3(world_corner * vec4(pos_obj, 1.0));
+    surface_corner = surface_obj;
+}
@@ -1,11 +1,28 @@
 #include "mainwindow.h"
+#include "postprocess/filtertool.h"
+#include "utils/scenetools.h"
 
 #include <QApplication>
 #include <QScreen>
 #include <iostream>
 #include <QSettings>
+#include <cstring>
 
 int main(int argc, char *argv[]) {
+    // Headless tools run before any window or GL context exists
+    if (argc > 1 && std::strcmp(argv[1], "--filter") == 0) {
+        return runFilterTool(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--parse-benchmark") == 0) {
+        return runParseBenchmark(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--compile-scene") == 0) {
+        return runSceneCompiler(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--flatten-benchmark") == 0) {
+        return runFlattenBenchmark(argc, argv);
+    }
+
     QApplication a(argc, argv);
 
     QCoreApplication::setApplicationName("Projects 5 & 6: Lights, Camera & Action!");
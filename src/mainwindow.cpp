@@ -33,6 +33,9 @@ void MainWindow::initialize() {
     QLabel *filters_label = new QLabel(); // Filters label
     filters_label->setText("Filters");
     filters_label->setFont(font);
+    QLabel *rendering_label = new QLabel(); // Rendering label
+    rendering_label->setText("Rendering");
+    rendering_label->setFont(font);
     QLabel *ec_label = new QLabel(); // Extra Credit label
     ec_label->setText("Extra Credit");
     ec_label->setFont(font);
@@ -57,9 +60,47 @@ void MainWindow::initialize() {
     filter2->setText(QStringLiteral("Kernel-Based Filter"));
     filter2->setChecked(false);
 
+    // Create checkbox for depth pre-pass
+    depthPrepass = new QCheckBox();
+    depthPrepass->setText(QStringLiteral("Depth Pre-Pass"));
+    depthPrepass->setChecked(false);
+
+    // Create checkbox for shadow mapping
+    shadows = new QCheckBox();
+    shadows->setText(QStringLiteral("Shadows"));
+    shadows->setChecked(false);
+
+    // Create checkbox for dynamic resolution scaling
+    dynamicResolution = new QCheckBox();
+    dynamicResolution->setText(QStringLiteral("Dynamic Resolution"));
+    dynamicResolution->setChecked(false);
+
+    // Create checkbox for the adaptive tessellation governor
+    adaptiveQuality = new QCheckBox();
+    adaptiveQuality->setText(QStringLiteral("Adaptive Tessellation"));
+    adaptiveQuality->setChecked(false);
+
+    // Create checkbox for refining curved shapes in tessellation shaders
+    hardwareTessellation = new QCheckBox();
+    hardwareTessellation->setText(QStringLiteral("Hardware Tessellation"));
+    hardwareTessellation->setChecked(false);
+
+    // Create checkbox for printing GPU pass timings
+    gpuProfiler = new QCheckBox();
+    gpuProfiler->setText(QStringLiteral("GPU Profiler"));
+    gpuProfiler->setChecked(false);
+
     // Create file uploader for scene file
     uploadFile = new QPushButton();
     uploadFile->setText(QStringLiteral("Upload Scene File"));
+
+    // Progress of a scene loading in the background, shown only while it loads
+    loadProgress = new QProgressBar();
+    loadProgress->setRange(0, 100);
+    loadProgress->hide();
+    cancelLoad = new QPushButton();
+    cancelLoad->setText(QStringLiteral("Cancel Load"));
+    cancelLoad->hide();
     
     saveImage = new QPushButton();
     saveImage->setText(QStringLiteral("Save image"));
@@ -162,6 +203,8 @@ void MainWindow::initialize() {
     ec4->setChecked(false);
 
     vLayout->addWidget(uploadFile);
+    vLayout->addWidget(loadProgress);
+    vLayout->addWidget(cancelLoad);
     vLayout->addWidget(saveImage);
     vLayout->addWidget(tesselation_label);
     vLayout->addWidget(param1_label);
@@ -176,6 +219,13 @@ void MainWindow::initialize() {
     vLayout->addWidget(filters_label);
     vLayout->addWidget(filter1);
     vLayout->addWidget(filter2);
+    vLayout->addWidget(rendering_label);
+    vLayout->addWidget(depthPrepass);
+    vLayout->addWidget(shadows);
+    vLayout->addWidget(dynamicResolution);
+    vLayout->addWidget(adaptiveQuality);
+    vLayout->addWidget(hardwareTessellation);
+    vLayout->addWidget(gpuProfiler);
     // Extra Credit:
     vLayout->addWidget(ec_label);
     vLayout->addWidget(ec1);
@@ -202,7 +252,14 @@ void MainWindow::finish() {
 void MainWindow::connectUIElements() {
     connectPerPixelFilter();
     connectKernelBasedFilter();
+    connectDepthPrepass();
+    connectShadows();
+    connectDynamicResolution();
+    connectAdaptiveQuality();
+    connectHardwareTessellation();
+    connectGpuProfiler();
     connectUploadFile();
+    connectSceneLoader();
     connectSaveImage();
     connectParam1();
     connectParam2();
@@ -219,10 +276,40 @@ void MainWindow::connectKernelBasedFilter() {
     connect(filter2, &QCheckBox::clicked, this, &MainWindow::onKernelBasedFilter);
 }
 
+void MainWindow::connectDepthPrepass() {
+    connect(depthPrepass, &QCheckBox::clicked, this, &MainWindow::onDepthPrepass);
+}
+
+void MainWindow::connectShadows() {
+    connect(shadows, &QCheckBox::clicked, this, &MainWindow::onShadows);
+}
+
+void MainWindow::connectDynamicResolution() {
+    connect(dynamicResolution, &QCheckBox::clicked, this, &MainWindow::onDynamicResolution);
+}
+
+void MainWindow::connectAdaptiveQuality() {
+    connect(adaptiveQuality, &QCheckBox::clicked, this, &MainWindow::onAdaptiveQuality);
+}
+
+void MainWindow::connectHardwareTessellation() {
+    connect(hardwareTessellation, &QCheckBox::clicked, this, &MainWindow::onHardwareTessellation);
+}
+
+void MainWindow::connectGpuProfiler() {
+    connect(gpuProfiler, &QCheckBox::clicked, this, &MainWindow::onGpuProfiler);
+}
+
 void MainWindow::connectUploadFile() {
     connect(uploadFile, &QPushButton::clicked, this, &MainWindow::onUploadFile);
 }
 
+void MainWindow::connectSceneLoader() {
+    connect(&realtime->sceneLoader(), &SceneLoader::progress, this, &MainWindow::onLoadProgress);
+    connect(&realtime->sceneLoader(), &SceneLoader::finished, this, &MainWindow::onLoadFinished);
+    connect(cancelLoad, &QPushButton::clicked, this, &MainWindow::onCancelLoad);
+}
+
 void MainWindow::connectSaveImage() {
     connect(saveImage, &QPushButton::clicked, this, &MainWindow::onSaveImage);
 }
@@ -268,6 +355,36 @@ void MainWindow::onKernelBasedFilter() {
     realtime->settingsChanged();
 }
 
+void MainWindow::onDepthPrepass() {
+    settings.depthPrepass = !settings.depthPrepass;
+    realtime->settingsChanged();
+}
+
+void MainWindow::onShadows() {
+    settings.shadows = !settings.shadows;
+    realtime->settingsChanged();
+}
+
+void MainWindow::onDynamicResolution() {
+    settings.dynamicResolution = !settings.dynamicResolution;
+    realtime->settingsChanged();
+}
+
+void MainWindow::onAdaptiveQuality() {
+    settings.adaptiveQuality = !settings.adaptiveQuality;
+    realtime->settingsChanged();
+}
+
+void MainWindow::onHardwareTessellation() {
+    settings.hardwareTessellation = !settings.hardwareTessellation;
+    realtime->settingsChanged();
+}
+
+void MainWindow::onGpuProfiler() {
+    settings.gpuProfiler = !settings.gpuProfiler;
+    realtime->settingsChanged();
+}
+
 void MainWindow::onUploadFile() {
     // Get abs path of scene file
     QString configFilePath = QFileDialog::getOpenFileName(this, tr("Upload File"),
@@ -285,11 +402,29 @@ void MainWindow::onUploadFile() {
 
     settings.sceneFilePath = configFilePath.toStdString();
 
-    std::cout << "Loaded scenefile: \"" << configFilePath.toStdString() << "\"." << std::endl;
+    std::cout << "Loading scenefile: \"" << configFilePath.toStdString() << "\"." << std::endl;
 
     realtime->sceneChanged();
 }
 
+void MainWindow::onLoadProgress(int percent) {
+    loadProgress->setValue(percent);
+    loadProgress->show();
+    cancelLoad->show();
+}
+
+void MainWindow::onLoadFinished(bool ok) {
+    loadProgress->hide();
+    cancelLoad->hide();
+    if (!ok) {
+        std::cout << "Scene load failed or was cancelled; keeping the current scene." << std::endl;
+    }
+}
+
+void MainWindow::onCancelLoad() {
+    realtime->sceneLoader().cancel();
+}
+
 void MainWindow::onSaveImage() {
     if (settings.sceneFilePath.empty()) {
         std::cout << "No scene file loaded." << std::endl;
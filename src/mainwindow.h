@@ -6,6 +6,7 @@
 #include <QSpinBox>
 #include <QDoubleSpinBox>
 #include <QPushButton>
+#include <QProgressBar>
 #include "realtime.h"
 #include "utils/aspectratiowidget/aspectratiowidget.hpp"
 
@@ -25,7 +26,14 @@ private:
     void connectFar();
     void connectPerPixelFilter();
     void connectKernelBasedFilter();
+    void connectDepthPrepass();
+    void connectShadows();
+    void connectDynamicResolution();
+    void connectAdaptiveQuality();
+    void connectHardwareTessellation();
+    void connectGpuProfiler();
     void connectUploadFile();
+    void connectSceneLoader();
     void connectSaveImage();
     void connectExtraCredit();
 
@@ -33,7 +41,15 @@ private:
     AspectRatioWidget *aspectRatioWidget;
     QCheckBox *filter1;
     QCheckBox *filter2;
+    QCheckBox *depthPrepass;
+    QCheckBox *shadows;
+    QCheckBox *dynamicResolution;
+    QCheckBox *adaptiveQuality;
+    QCheckBox *hardwareTessellation;
+    QCheckBox *gpuProfiler;
     QPushButton *uploadFile;
+    QProgressBar *loadProgress;
+    QPushButton *cancelLoad;
     QPushButton *saveImage;
     QSlider *p1Slider;
     QSlider *p2Slider;
@@ -53,7 +69,16 @@ private:
 private slots:
     void onPerPixelFilter();
     void onKernelBasedFilter();
+    void onDepthPrepass();
+    void onShadows();
+    void onDynamicResolution();
+    void onAdaptiveQuality();
+    void onHardwareTessellation();
+    void onGpuProfiler();
     void onUploadFile();
+    void onLoadProgress(int percent);
+    void onLoadFinished(bool ok);
+    void onCancelLoad();
     void onSaveImage();
     void onValChangeP1(int newValue);
     void onValChangeP2(int newValue);
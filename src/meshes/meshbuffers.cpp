@@ -0,0 +1,147 @@
+#include "meshbuffers.h"
+
+#include "meshcache.h"
+#include "meshlets.h"
+#include "objloader.h"
+#include "simplifier.h"
+
+#include <iostream>
+
+// Bytes of vertex and index data copied to the GPU per frame. One mesh is always uploaded even
+// if it is larger, so a single big mesh cannot stall the queue forever.
+static constexpr size_t UPLOAD_BYTES_PER_FRAME = 8 * 1024 * 1024;
+
+static size_t meshBytes(const MeshData &mesh) {
+    return mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(uint32_t);
+}
+
+void MeshBuffers::finish() {
+    // Join the worker first so it doesn't touch m_loaded after it is cleared
+    m_pool.reset();
+    m_loaded.clear();
+
+    for (Entry &entry : m_entries) {
+        if (entry.state == MeshState::MESH_RESIDENT) {
+            glDeleteVertexArrays(1, &entry.vao);
+            glDeleteBuffers(1, &entry.vbo);
+            glDeleteBuffers(1, &entry.ebo);
+        }
+    }
+    m_entries.clear();
+    m_handles.clear();
+}
+
+int MeshBuffers::acquire(const std::string &path) {
+    auto found = m_handles.find(path);
+    if (found != m_handles.end()) {
+        return found->second;
+    }
+
+    int handle = m_entries.size();
+    m_entries.push_back({path, MeshState::MESH_LOADING, 0, 0, 0, AABB(), {}, {}});
+    m_handles[path] = handle;
+
+    // One load at a time: the OBJ parser already spreads each file across every core
+    if (!m_pool) {
+        m_pool = std::make_unique<ThreadPool>(1);
+    }
+    m_pool->submit([this, handle, path] {
+        LoadedMesh loaded = load(handle, path);
+        std::lock_guard<std::mutex> lock(m_loadedMutex);
+        m_loaded.push_back(std::move(loaded));
+    });
+    return handle;
+}
+
+// Runs on the worker thread: the compiled image if it is current, otherwise the OBJ itself,
+// which is then simplified into levels of detail, split into meshlets and compiled for the
+// next run
+MeshBuffers::LoadedMesh MeshBuffers::load(int handle, const std::string &path) {
+    LoadedMesh loaded;
+    loaded.handle = handle;
+    std::string cachefile = MeshCache::cachePath(path);
+    if (MeshCache::load(cachefile, path, loaded.mesh)) {
+        loaded.ok = true;
+        return loaded;
+    }
+    loaded.ok = ObjLoader::load(path, loaded.mesh);
+    if (!loaded.ok) {
+        return loaded;
+    }
+    Simplifier::buildLods(loaded.mesh);
+    for (size_t i = 0; i < loaded.mesh.lods.size(); i++) {
+        const MeshLod &lod = loaded.mesh.lods[i];
+        std::cout << "Mesh " << path << " level " << i << ": " << lod.indexCount / 3
+                  << " triangles, error " << lod.error << std::endl;
+    }
+    Meshlets::build(loaded.mesh);
+    if (!MeshCache::write(cachefile, path, loaded.mesh)) {
+        std::cerr << "could not write mesh cache " << cachefile << std::endl;
+    }
+    return loaded;
+}
+
+void MeshBuffers::upload(LoadedMesh &loaded) {
+    Entry &entry = m_entries[loaded.handle];
+    if (!loaded.ok) {
+        std::cerr << "Failed to load mesh " << entry.path << std::endl;
+        entry.state = MeshState::MESH_FAILED;
+        return;
+    }
+    const MeshData &mesh = loaded.mesh;
+
+    glGenVertexArrays(1, &entry.vao);
+    glGenBuffers(1, &entry.vbo);
+    glGenBuffers(1, &entry.ebo);
+    glBindVertexArray(entry.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, entry.vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * mesh.vertices.size(), mesh.vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, entry.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * mesh.indices.size(), mesh.indices.data(), GL_STATIC_DRAW);
+
+    // Position, tangent frame quaternion and texture coordinate; see shapes/vertexlayout.h
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    GLsizei stride = VERTEX_FLOATS * sizeof(GLfloat);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(VERTEX_FRAME_OFFSET * sizeof(GLfloat)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(VERTEX_UV_OFFSET * sizeof(GLfloat)));
+
+    // The element buffer binding is VAO state, so only the array buffer is unbound
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    entry.state = MeshState::MESH_RESIDENT;
+    entry.bounds = mesh.bounds;
+    entry.meshlets = std::move(loaded.mesh.meshlets);
+    entry.lods = std::move(loaded.mesh.lods);
+}
+
+bool MeshBuffers::update() {
+    std::vector<LoadedMesh> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_loadedMutex);
+        size_t bytes = 0;
+        size_t count = 0;
+        while (count < m_loaded.size() && (count == 0 || bytes + meshBytes(m_loaded[count].mesh) <= UPLOAD_BYTES_PER_FRAME)) {
+            bytes += meshBytes(m_loaded[count].mesh);
+            count++;
+        }
+        ready.assign(std::make_move_iterator(m_loaded.begin()),
+                     std::make_move_iterator(m_loaded.begin() + count));
+        m_loaded.erase(m_loaded.begin(), m_loaded.begin() + count);
+    }
+
+    bool resident = false;
+    for (LoadedMesh &loaded : ready) {
+        upload(loaded);
+        resident |= isResident(loaded.handle);
+    }
+    return resident;
+}
+
+bool MeshBuffers::isResident(int handle) const {
+    return handle >= 0 && size_t(handle) < m_entries.size() &&
+           m_entries[handle].state == MeshState::MESH_RESIDENT;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include "meshdata.h"
+#include "utils/threadpool.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Streams the meshes of PRIMITIVE_MESH shapes in the background. Each mesh is read from its
+// compiled image, or parsed from OBJ and compiled for next time, on a worker thread; the GL
+// thread only copies finished meshes into vertex and index buffers, a few megabytes per frame.
+// Meshes are shared by path. Until a mesh is resident it has nothing to draw, and its shapes
+// are skipped.
+class MeshBuffers
+{
+public:
+    void finish();
+
+    // Returns a handle for the mesh at path, starting its load if this is the first request
+    int acquire(const std::string &path);
+
+    // Uploads finished loads; call once per frame with the context current. Returns whether a
+    // mesh became resident, since that changes the bounds of the shapes using it.
+    bool update();
+
+    bool isResident(int handle) const;
+
+    // Vertex array of a resident mesh, with attributes 0-2 set up as for the implicit shapes
+    GLuint vao(int handle) const { return m_entries[handle].vao; }
+
+    // Object-space bounds of a resident mesh
+    const AABB &bounds(int handle) const { return m_entries[handle].bounds; }
+
+    // Meshlets of a resident mesh, kept on the CPU for culling (see Meshlets::cull())
+    const std::vector<Meshlet> &meshlets(int handle) const { return m_entries[handle].meshlets; }
+
+    // Levels of detail of a resident mesh, the full mesh first; all draw from the same vertices
+    const std::vector<MeshLod> &lods(int handle) const { return m_entries[handle].lods; }
+
+private:
+    enum class MeshState {
+        MESH_LOADING,
+        MESH_RESIDENT,
+        MESH_FAILED
+    };
+
+    // Output of a worker
+    struct LoadedMesh {
+        int handle;
+        bool ok;
+        MeshData mesh;
+    };
+
+    struct Entry {
+        std::string path;
+        MeshState state;
+        GLuint vao;
+        GLuint vbo;
+        GLuint ebo;
+        AABB bounds;
+        std::vector<Meshlet> meshlets;
+        std::vector<MeshLod> lods;
+    };
+
+    static LoadedMesh load(int handle, const std::string &path);
+    void upload(LoadedMesh &loaded);
+
+    std::vector<Entry> m_entries;
+    std::unordered_map<std::string, int> m_handles;
+
+    std::mutex m_loadedMutex;
+    std::vector<LoadedMesh> m_loaded;           // Guarded by m_loadedMutex
+
+    // Declared last so it is destroyed (and its worker joined) before the state it writes to
+    std::unique_ptr<ThreadPool> m_pool;
+};
@@ -0,0 +1,208 @@
+#include "meshcache.h"
+#include "meshlets.h"
+#include "simplifier.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+namespace {
+
+constexpr uint64_t MAGIC = 0x454843414348534dull;    // "MSHCACHE" read little-endian
+constexpr uint32_t VERSION = 4;
+constexpr size_t SECTION_ALIGNMENT = 64;
+
+static_assert(std::is_trivially_copyable_v<AABB>);
+static_assert(std::is_trivially_copyable_v<Meshlet>);
+static_assert(std::is_trivially_copyable_v<MeshLod>);
+
+enum Section {
+    SECTION_VERTICES,           // VERTEX_FLOATS floats per vertex
+    SECTION_INDICES,            // uint32_t per triangle corner, each level in meshlet order
+    SECTION_MESHLETS,           // Meshlet per meshlet
+    SECTION_LODS,               // MeshLod per level of detail
+    SECTION_COUNT
+};
+
+struct SectionRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t layout;
+
+    // Stamp of the mesh file this was compiled from
+    uint64_t sourceSize;
+    int64_t sourceModified;     // ms since epoch
+
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    AABB bounds;
+    uint32_t meshletCount;
+    uint32_t lodCount;
+
+    SectionRange sections[SECTION_COUNT];
+};
+
+constexpr uint32_t layoutWord() {
+    return uint32_t(sizeof(Header)) ^ uint32_t(VERTEX_FLOATS) << 10 ^ uint32_t(VERTEX_FRAME_OFFSET) << 16
+           ^ uint32_t(VERTEX_UV_OFFSET) << 22 ^ uint32_t(sizeof(Meshlet)) << 26 ^ uint32_t(sizeof(MeshLod)) << 20;
+}
+
+size_t alignUp(size_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+void stampSource(const std::string &meshfile, uint64_t &size, int64_t &modified) {
+    QFileInfo info(QString::fromStdString(meshfile));
+    size = info.size();
+    modified = info.lastModified().toMSecsSinceEpoch();
+}
+
+}
+
+std::string MeshCache::cachePath(const std::string &meshfile) {
+    return meshfile + ".cache";
+}
+
+bool MeshCache::write(const std::string &cachefile, const std::string &meshfile, const MeshData &mesh) {
+    Header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.layout = layoutWord();
+    stampSource(meshfile, header.sourceSize, header.sourceModified);
+    header.vertexCount = mesh.vertexCount();
+    header.indexCount = mesh.indices.size();
+    header.bounds = mesh.bounds;
+    header.meshletCount = mesh.meshlets.size();
+    header.lodCount = mesh.lods.size();
+
+    const char *sections[SECTION_COUNT] = {
+        reinterpret_cast<const char *>(mesh.vertices.data()),
+        reinterpret_cast<const char *>(mesh.indices.data()),
+        reinterpret_cast<const char *>(mesh.meshlets.data()),
+        reinterpret_cast<const char *>(mesh.lods.data())};
+    const uint64_t sizes[SECTION_COUNT] = {
+        mesh.vertices.size() * sizeof(float), mesh.indices.size() * sizeof(uint32_t),
+        mesh.meshlets.size() * sizeof(Meshlet), mesh.lods.size() * sizeof(MeshLod)};
+    size_t offset = alignUp(sizeof(Header));
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        header.sections[i] = {offset, sizes[i]};
+        offset = alignUp(offset + sizes[i]);
+    }
+
+    // Written to a temporary and renamed on commit, so a reader never maps half a file
+    QSaveFile file(QString::fromStdString(cachefile));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    static const char zeros[SECTION_ALIGNMENT] = {};
+    size_t written = 0;
+    auto writeAt = [&](size_t position, const char *data, size_t size) {
+        file.write(zeros, position - written);
+        file.write(data, size);
+        written = position + size;
+    };
+    writeAt(0, reinterpret_cast<const char *>(&header), sizeof(Header));
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        writeAt(header.sections[i].offset, sections[i], sizes[i]);
+    }
+    return file.commit();
+}
+
+bool MeshCache::load(const std::string &cachefile, const std::string &meshfile, MeshData &mesh) {
+    QFile file(QString::fromStdString(cachefile));
+    if (!file.open(QIODevice::ReadOnly) || size_t(file.size()) < sizeof(Header)) {
+        return false;
+    }
+    const char *data = reinterpret_cast<const char *>(file.map(0, file.size()));
+    if (data == nullptr) {
+        return false;
+    }
+    size_t fileSize = file.size();
+
+    Header header;
+    std::memcpy(&header, data, sizeof(Header));
+    uint64_t sourceSize;
+    int64_t sourceModified;
+    stampSource(meshfile, sourceSize, sourceModified);
+    if (header.magic != MAGIC || header.version != VERSION || header.layout != layoutWord()
+        || header.sourceSize != sourceSize || header.sourceModified != sourceModified) {
+        return false;
+    }
+
+    const uint64_t expectedSizes[SECTION_COUNT] = {
+        header.vertexCount * VERTEX_FLOATS * sizeof(float), header.indexCount * sizeof(uint32_t),
+        header.meshletCount * sizeof(Meshlet), header.lodCount * sizeof(MeshLod)};
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        const SectionRange &section = header.sections[i];
+        if (section.size != expectedSizes[i] || section.offset % SECTION_ALIGNMENT != 0
+            || section.offset > fileSize || section.size > fileSize - section.offset) {
+            std::cerr << "Ignoring corrupt mesh cache " << cachefile << std::endl;
+            return false;
+        }
+    }
+
+    // Every index must name a vertex before a draw can trust it
+    const float *vertices = reinterpret_cast<const float *>(data + header.sections[SECTION_VERTICES].offset);
+    const uint32_t *indices = reinterpret_cast<const uint32_t *>(data + header.sections[SECTION_INDICES].offset);
+    uint32_t maxIndex = 0;
+    for (uint64_t i = 0; i < header.indexCount; i++) {
+        maxIndex = std::max(maxIndex, indices[i]);
+    }
+    if (header.indexCount % 3 != 0 || (header.indexCount != 0 && maxIndex >= header.vertexCount)) {
+        std::cerr << "Ignoring corrupt mesh cache " << cachefile << std::endl;
+        return false;
+    }
+
+    // and the meshlets must tile the indices in order, or culling could draw past them
+    const Meshlet *meshlets = reinterpret_cast<const Meshlet *>(data + header.sections[SECTION_MESHLETS].offset);
+    uint64_t nextIndex = 0;
+    for (uint32_t i = 0; i < header.meshletCount; i++) {
+        if (meshlets[i].firstIndex != nextIndex || meshlets[i].triangleCount > Meshlets::MAX_TRIANGLES) {
+            std::cerr << "Ignoring corrupt mesh cache " << cachefile << std::endl;
+            return false;
+        }
+        nextIndex += meshlets[i].triangleCount * 3;
+    }
+    if (nextIndex != header.indexCount) {
+        std::cerr << "Ignoring corrupt mesh cache " << cachefile << std::endl;
+        return false;
+    }
+
+    // as must the levels of detail, each over a run of whole meshlets
+    const MeshLod *lods = reinterpret_cast<const MeshLod *>(data + header.sections[SECTION_LODS].offset);
+    nextIndex = 0;
+    uint64_t nextMeshlet = 0;
+    bool lodsValid = header.lodCount >= 1 && header.lodCount <= Simplifier::MAX_LODS;
+    for (uint32_t i = 0; i < header.lodCount && lodsValid; i++) {
+        const MeshLod &lod = lods[i];
+        uint64_t lodEnd = uint64_t(lod.firstMeshlet) + lod.meshletCount;
+        lodsValid = lod.firstIndex == nextIndex && lod.firstMeshlet == nextMeshlet && lodEnd <= header.meshletCount
+                    && (lodEnd == header.meshletCount ? header.indexCount : meshlets[lodEnd].firstIndex)
+                       == uint64_t(lod.firstIndex) + lod.indexCount;
+        nextIndex += lod.indexCount;
+        nextMeshlet = lodEnd;
+    }
+    if (!lodsValid || nextIndex != header.indexCount || nextMeshlet != header.meshletCount) {
+        std::cerr << "Ignoring corrupt mesh cache " << cachefile << std::endl;
+        return false;
+    }
+
+    mesh.vertices.assign(vertices, vertices + header.vertexCount * VERTEX_FLOATS);
+    mesh.indices.assign(indices, indices + header.indexCount);
+    mesh.bounds = header.bounds;
+    mesh.meshlets.assign(meshlets, meshlets + header.meshletCount);
+    mesh.lods.assign(lods, lods + header.lodCount);
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "meshdata.h"
+
+#include <string>
+
+// Compiled meshes: a versioned binary image of a loaded MeshData, written next to the mesh file
+// so later loads skip OBJ parsing, vertex deduplication, normal generation, simplification and
+// meshlet building. The image is a header (counts, bounds and a section table) followed by
+// 64-byte aligned sections holding the interleaved vertices, the indices, the meshlets and the
+// levels of detail exactly as MeshData stores them, so loading is a bulk copy out of the mapped
+// file. As with scene images (see SceneCache), the header is stamped with the source file's size
+// and modification time, and an image that doesn't match the current mesh file, format version
+// or struct layout is stale and ignored.
+namespace MeshCache {
+    // Where the compiled image of meshfile lives
+    std::string cachePath(const std::string &meshfile);
+
+    // Writes mesh, loaded from meshfile, to cachefile. Returns false if it can't.
+    bool write(const std::string &cachefile, const std::string &meshfile, const MeshData &mesh);
+
+    // Maps cachefile and fills mesh from it if it is a current image of meshfile.
+    // Returns false, without touching mesh, if the image is missing or stale.
+    bool load(const std::string &cachefile, const std::string &meshfile, MeshData &mesh);
+}
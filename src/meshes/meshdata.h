@@ -0,0 +1,42 @@
+#pragma once
+
+#include "shapes/vertexlayout.h"
+#include "utils/bounds.h"
+
+#include <cstdint>
+#include <vector>
+
+// A cluster of a mesh's triangles, culled as a unit (see Meshlets)
+struct Meshlet {
+    uint32_t firstIndex;                // into MeshData::indices
+    uint32_t triangleCount;
+    uint32_t vertexCount;               // distinct vertices its triangles use
+    float coneCutoff;                   // sine of the normal cone's half-angle; 1 never culls
+    glm::vec3 center;                   // bounding sphere, in object space
+    float radius;
+    glm::vec3 coneAxis;                 // average face normal
+    uint32_t padding;
+};
+
+// One level of detail: a range of MeshData::indices over the shared vertices, and its meshlets
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstMeshlet;              // into MeshData::meshlets
+    uint32_t meshletCount;
+    float error;                        // furthest its surface may be from the full mesh's, in object space
+};
+
+// A triangle mesh ready to upload: vertices interleaved in the layout of shapes/vertexlayout.h,
+// each distinct (position, texture coordinate, normal) once, and three indices per triangle.
+// The triangles of every level of detail follow each other in indices, the full mesh first.
+struct MeshData {
+    std::vector<float> vertices;        // VERTEX_FLOATS per vertex
+    std::vector<uint32_t> indices;      // each level in meshlet order once built
+    AABB bounds;                        // of the vertex positions, in object space
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshLod> lods;          // empty until built; then the full mesh is lods[0]
+
+    size_t vertexCount() const { return vertices.size() / VERTEX_FLOATS; }
+    size_t triangleCount() const { return indices.size() / 3; }
+};
@@ -0,0 +1,227 @@
+#include "meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr uint32_t NOT_IN_MESHLET = ~0u;
+
+// Normal cones wider than this (the cosine of the widest normal from the axis) are never
+// entirely back-facing from anywhere worth testing, so they are not culled
+constexpr float MIN_CONE_COSINE = 0.1f;
+
+glm::vec3 vertexPosition(const MeshData &mesh, uint32_t vertex) {
+    const float *p = &mesh.vertices[size_t(vertex) * VERTEX_FLOATS];
+    return glm::vec3(p[0], p[1], p[2]);
+}
+
+// Bounding sphere and normal cone of a meshlet whose triangles are at indices
+void computeBounds(const MeshData &mesh, const uint32_t *indices, Meshlet &meshlet) {
+    uint32_t cornerCount = meshlet.triangleCount * 3;
+
+    AABB box;
+    for (uint32_t i = 0; i < cornerCount; i++) {
+        box.expand(vertexPosition(mesh, indices[i]));
+    }
+    meshlet.center = box.center();
+    float radiusSquared = 0.f;
+    for (uint32_t i = 0; i < cornerCount; i++) {
+        glm::vec3 d = vertexPosition(mesh, indices[i]) - meshlet.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+    }
+    meshlet.radius = std::sqrt(radiusSquared);
+
+    // Face normals follow the counter-clockwise winding GL treats as front-facing
+    glm::vec3 normals[Meshlets::MAX_TRIANGLES];
+    uint32_t normalCount = 0;
+    glm::vec3 sum(0.f);
+    for (uint32_t i = 0; i < cornerCount; i += 3) {
+        glm::vec3 p0 = vertexPosition(mesh, indices[i]);
+        glm::vec3 n = glm::cross(vertexPosition(mesh, indices[i + 1]) - p0, vertexPosition(mesh, indices[i + 2]) - p0);
+        float length = glm::length(n);
+        if (length > 0.f) {
+            normals[normalCount] = n / length;
+            sum += normals[normalCount++];
+        }
+    }
+    float sumLength = glm::length(sum);
+    meshlet.coneAxis = sumLength > 0.f ? sum / sumLength : glm::vec3(0.f, 0.f, 1.f);
+    float minCosine = sumLength > 0.f ? 1.f : -1.f;
+    for (uint32_t i = 0; i < normalCount; i++) {
+        minCosine = std::min(minCosine, glm::dot(normals[i], meshlet.coneAxis));
+    }
+    // Seen from within 90 degrees minus the cone's half-angle of the axis, behind the meshlet,
+    // every face is back-facing; the cutoff is the cosine of that, the sine of the half-angle
+    meshlet.coneCutoff = minCosine > MIN_CONE_COSINE ? std::sqrt(1.f - minCosine * minCosine) : 1.f;
+}
+
+// Splits the triangles of one level of detail into meshlets, appending them to order in
+// meshlet order and the meshlets to mesh.meshlets
+void buildLevel(MeshData &mesh, const MeshLod &lod, std::vector<uint32_t> &order) {
+    uint32_t vertexCount = mesh.vertexCount();
+    uint32_t triangleCount = lod.indexCount / 3;
+    const uint32_t *indices = &mesh.indices[lod.firstIndex];
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Triangles around each vertex. Used triangles are swapped out of the live prefix of each
+    // list, so the search below only ever sees triangles that are still free.
+    std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+    for (uint32_t i = 0; i < lod.indexCount; i++) {
+        adjacencyStart[indices[i] + 1]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        adjacencyStart[v + 1] += adjacencyStart[v];
+    }
+    std::vector<uint32_t> liveCounts(vertexCount, 0);
+    std::vector<uint32_t> adjacency(lod.indexCount);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = indices[t * 3 + c];
+            adjacency[adjacencyStart[v] + liveCounts[v]++] = t;
+        }
+    }
+    auto removeTriangle = [&](uint32_t v, uint32_t t) {
+        uint32_t *list = &adjacency[adjacencyStart[v]];
+        uint32_t *found = std::find(list, list + liveCounts[v], t);
+        *found = list[--liveCounts[v]];
+    };
+
+    std::vector<bool> used(triangleCount, false);
+    std::vector<uint32_t> slots(vertexCount, NOT_IN_MESHLET);   // meshlet a vertex was last added to
+    std::vector<uint32_t> meshletVertices;
+    meshletVertices.reserve(Meshlets::MAX_VERTICES);
+
+    Meshlet meshlet = {};
+    meshlet.firstIndex = order.size();
+    uint32_t meshletIndex = 0;
+    uint32_t seedCursor = 0;
+    auto newVertices = [&](uint32_t t) {
+        uint32_t count = 0;
+        for (int c = 0; c < 3; c++) {
+            count += slots[indices[t * 3 + c]] != meshletIndex;
+        }
+        return count;
+    };
+    auto flush = [&] {
+        meshlet.vertexCount = meshletVertices.size();
+        computeBounds(mesh, &order[meshlet.firstIndex], meshlet);
+        mesh.meshlets.push_back(meshlet);
+        meshlet = {};
+        meshlet.firstIndex = order.size();
+        meshletVertices.clear();
+        meshletIndex++;
+    };
+
+    for (uint32_t emitted = 0; emitted < triangleCount; emitted++) {
+        // Prefer a free triangle touching the meshlet that adds the fewest vertices to it
+        uint32_t best = NOT_IN_MESHLET;
+        uint32_t bestNew = 3;
+        for (uint32_t v : meshletVertices) {
+            const uint32_t *list = &adjacency[adjacencyStart[v]];
+            for (uint32_t i = 0; i < liveCounts[v] && bestNew > 0; i++) {
+                uint32_t added = newVertices(list[i]);
+                if (added < bestNew) {
+                    best = list[i];
+                    bestNew = added;
+                }
+            }
+            if (bestNew == 0) {
+                break;
+            }
+        }
+        if (best != NOT_IN_MESHLET && meshletVertices.size() + bestNew > Meshlets::MAX_VERTICES) {
+            best = NOT_IN_MESHLET;
+        }
+        if (best == NOT_IN_MESHLET) {
+            // Nothing adjacent fits: start a new meshlet, or continue this one elsewhere if
+            // the part it was growing over has run out
+            while (used[seedCursor]) {
+                seedCursor++;
+            }
+            best = seedCursor;
+            bool adjacentLeft = false;
+            for (uint32_t v : meshletVertices) {
+                adjacentLeft |= liveCounts[v] > 0;
+            }
+            if (adjacentLeft || meshletVertices.size() + newVertices(best) > Meshlets::MAX_VERTICES) {
+                flush();
+            }
+        }
+
+        used[best] = true;
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = indices[best * 3 + c];
+            order.push_back(v);
+            removeTriangle(v, best);
+            if (slots[v] != meshletIndex) {
+                slots[v] = meshletIndex;
+                meshletVertices.push_back(v);
+            }
+        }
+        if (++meshlet.triangleCount == Meshlets::MAX_TRIANGLES) {
+            flush();
+        }
+    }
+    if (meshlet.triangleCount > 0) {
+        flush();
+    }
+}
+
+}
+
+void Meshlets::build(MeshData &mesh) {
+    mesh.meshlets.clear();
+    if (mesh.lods.empty()) {
+        mesh.lods.push_back({0, uint32_t(mesh.indices.size()), 0, 0, 0.f});
+    }
+
+    // The levels tile the indices in order, so each one's meshlets land where it already was
+    std::vector<uint32_t> order;
+    order.reserve(mesh.indices.size());
+    for (MeshLod &lod : mesh.lods) {
+        lod.firstMeshlet = mesh.meshlets.size();
+        buildLevel(mesh, lod, order);
+        lod.meshletCount = mesh.meshlets.size() - lod.firstMeshlet;
+    }
+    mesh.indices = std::move(order);
+}
+
+void Meshlets::cull(const Meshlet *meshlets, uint32_t meshletCount, const glm::mat4 &ctm, const Frustum &frustum,
+                    const glm::vec3 &cameraPos, std::vector<uint32_t> &firsts, std::vector<uint32_t> &counts) {
+    // Tested in object space: the planes and camera go through ctm once instead of every
+    // meshlet going through it. Which side of a face a point is on survives any affine map,
+    // but a mirroring one flips the winding GL culls by, so such shapes skip the cone test.
+    glm::vec3 camera = glm::vec3(glm::inverse(ctm) * glm::vec4(cameraPos, 1.f));
+    bool testCones = glm::determinant(glm::mat3(ctm)) > 0.f;
+    glm::vec4 planes[6];
+    for (int i = 0; i < 6; i++) {
+        planes[i] = frustum.planes[i] * ctm;
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
+    size_t firstRun = firsts.size();
+    for (uint32_t i = 0; i < meshletCount; i++) {
+        const Meshlet &meshlet = meshlets[i];
+        bool visible = true;
+        for (const glm::vec4 &plane : planes) {
+            visible &= glm::dot(glm::vec3(plane), meshlet.center) + plane.w >= -meshlet.radius;
+        }
+        if (visible && testCones) {
+            glm::vec3 view = meshlet.center - camera;
+            visible = glm::dot(view, meshlet.coneAxis) < meshlet.coneCutoff * glm::length(view) + meshlet.radius;
+        }
+        if (!visible) {
+            continue;
+        }
+        uint32_t count = meshlet.triangleCount * 3;
+        if (firsts.size() > firstRun && firsts.back() + counts.back() == meshlet.firstIndex) {
+            counts.back() += count;
+        } else {
+            firsts.push_back(meshlet.firstIndex);
+            counts.push_back(count);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "meshdata.h"
+#include "utils/bounds.h"
+
+#include <cstdint>
+#include <vector>
+
+// Clusters of a mesh small enough to cull one at a time. The builder reorders a mesh's triangles
+// so each meshlet is a contiguous range of MeshData::indices, grown greedily over shared
+// vertices to keep it compact, and gives it a bounding sphere and a cone bounding its face
+// normals. The culling pass rejects meshlets outside the view frustum or facing entirely away
+// from the camera, and returns what is left as index ranges to draw, with neighbours merged.
+namespace Meshlets {
+    constexpr uint32_t MAX_VERTICES = 64;
+    constexpr uint32_t MAX_TRIANGLES = 124;
+
+    // Splits each level of detail of mesh into meshlets, reordering its indices within the
+    // level, and fills mesh.meshlets and the levels' meshlet ranges. A mesh without levels is
+    // given one covering all of it.
+    void build(MeshData &mesh);
+
+    // Appends the index ranges of the meshlets that may be visible through frustum from
+    // cameraPos (both in world space) when drawn at ctm. A range is a first index and a count.
+    void cull(const Meshlet *meshlets, uint32_t meshletCount, const glm::mat4 &ctm, const Frustum &frustum,
+              const glm::vec3 &cameraPos, std::vector<uint32_t> &firsts, std::vector<uint32_t> &counts);
+}
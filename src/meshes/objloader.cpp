@@ -0,0 +1,412 @@
+#include "objloader.h"
+
+#include "utils/threadpool.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace {
+
+// Chunks smaller than this aren't worth a task of their own
+constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+
+constexpr int32_t ABSENT = -1;
+constexpr uint32_t NO_VERTEX = ~0u;
+
+// Which indices of a Corner count from the start of their chunk rather than of the file
+enum CornerFlags : uint8_t {
+    RELATIVE_POSITION = 1,
+    RELATIVE_UV = 2,
+    RELATIVE_NORMAL = 4
+};
+
+// A face corner as far as its chunk can resolve it: positive OBJ indices are made 0-based,
+// and negative ones, which count back from the end of the elements read so far, are made
+// relative to the chunk's first element since the chunk doesn't know how many came before it
+struct Corner {
+    int32_t position;
+    int32_t uv;                         // ABSENT if not given
+    int32_t normal;                     // same
+    uint8_t relative;                   // CornerFlags
+};
+
+struct ObjChunk {
+    const char *begin;
+    const char *end;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<Corner> corners;        // three per triangle
+    const char *error = nullptr;        // start of the first malformed line
+};
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *skipSpaces(const char *p, const char *end) {
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+bool readFloat(const char *&p, const char *end, float &value) {
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+') {
+        p++;
+    }
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec == std::errc::invalid_argument) {
+        return false;
+    }
+    if (result.ec == std::errc::result_out_of_range) {
+        value = 0.f; // Denormals in exported files; nothing real overflows a float
+    }
+    p = result.ptr;
+    return true;
+}
+
+bool readIndex(const char *&p, const char *end, int32_t &value) {
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc() || value == 0) {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
+
+// Makes an OBJ index 0-based, flagging it relative to the chunk if it counted back
+int32_t resolveIndex(int32_t index, size_t localCount, uint8_t flag, uint8_t &relative) {
+    if (index > 0) {
+        return index - 1;
+    }
+    relative |= flag;
+    return int32_t(localCount) + index;
+}
+
+// Reads one face vertex: p, p/t, p//n or p/t/n
+bool readCorner(const char *&p, const char *end, const ObjChunk &chunk, Corner &corner) {
+    int32_t index;
+    corner = {0, ABSENT, ABSENT, 0};
+    if (!readIndex(p, end, index)) {
+        return false;
+    }
+    corner.position = resolveIndex(index, chunk.positions.size(), RELATIVE_POSITION, corner.relative);
+    if (p == end || *p != '/') {
+        return true;
+    }
+    p++;
+    if (p < end && *p != '/') {
+        if (!readIndex(p, end, index)) {
+            return false;
+        }
+        corner.uv = resolveIndex(index, chunk.uvs.size(), RELATIVE_UV, corner.relative);
+    }
+    if (p == end || *p != '/') {
+        return true;
+    }
+    p++;
+    if (!readIndex(p, end, index)) {
+        return false;
+    }
+    corner.normal = resolveIndex(index, chunk.normals.size(), RELATIVE_NORMAL, corner.relative);
+    return true;
+}
+
+bool parseLine(const char *p, const char *end, ObjChunk &chunk) {
+    p = skipSpaces(p, end);
+    if (p == end || *p == '#') {
+        return true;
+    }
+    char first = *p;
+    char second = p + 1 < end ? p[1] : '\0';
+
+    if (first == 'v' && isSpace(second)) {
+        glm::vec3 position;
+        p += 2;
+        if (!readFloat(p, end, position.x) || !readFloat(p, end, position.y) || !readFloat(p, end, position.z)) {
+            return false;
+        }
+        chunk.positions.push_back(position);
+        return true;
+    }
+    if (first == 'v' && second == 't') {
+        glm::vec2 uv(0.f);
+        p += 2;
+        if (!readFloat(p, end, uv.x)) {
+            return false;
+        }
+        p = skipSpaces(p, end);
+        if (p < end && *p != '#' && !readFloat(p, end, uv.y)) {
+            return false;
+        }
+        chunk.uvs.push_back(uv);
+        return true;
+    }
+    if (first == 'v' && second == 'n') {
+        glm::vec3 normal;
+        p += 2;
+        if (!readFloat(p, end, normal.x) || !readFloat(p, end, normal.y) || !readFloat(p, end, normal.z)) {
+            return false;
+        }
+        chunk.normals.push_back(normal);
+        return true;
+    }
+    if (first == 'f' && isSpace(second)) {
+        p += 2;
+        Corner corner0, previous, corner;
+        int count = 0;
+        for (p = skipSpaces(p, end); p < end && *p != '#'; p = skipSpaces(p, end)) {
+            if (!readCorner(p, end, chunk, corner)) {
+                return false;
+            }
+            if (count == 0) {
+                corner0 = corner;
+            } else if (count >= 2) {
+                chunk.corners.insert(chunk.corners.end(), {corner0, previous, corner});
+            }
+            previous = corner;
+            count++;
+        }
+        return count >= 3;
+    }
+    // Groups, smoothing groups, materials, lines and points carry no triangle geometry
+    return true;
+}
+
+void parseChunk(ObjChunk &chunk) {
+    for (const char *line = chunk.begin; line < chunk.end; ) {
+        const char *newline = static_cast<const char *>(std::memchr(line, '\n', chunk.end - line));
+        const char *lineEnd = newline != nullptr ? newline : chunk.end;
+        if (!parseLine(line, lineEnd, chunk)) {
+            chunk.error = line;
+            return;
+        }
+        line = lineEnd + 1;
+    }
+}
+
+// Any unit vector perpendicular to n
+glm::vec3 perpendicular(const glm::vec3 &n) {
+    glm::vec3 axis = std::abs(n.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+    return glm::normalize(glm::cross(n, axis));
+}
+
+// Runs fn(begin, end) over [0, count) in contiguous slices, on the pool if there is one
+template <typename Fn>
+void forSlices(ThreadPool *pool, size_t count, const Fn &fn) {
+    size_t slices = pool != nullptr ? std::min<size_t>(pool->size(), count / 4096 + 1) : 1;
+    if (slices <= 1) {
+        fn(size_t(0), count);
+        return;
+    }
+    for (size_t s = 0; s < slices; s++) {
+        size_t begin = count * s / slices;
+        size_t end = count * (s + 1) / slices;
+        pool->submit([&fn, begin, end] { fn(begin, end); });
+    }
+    pool->wait();
+}
+
+}
+
+bool ObjLoader::load(const std::string &path, MeshData &mesh, int threads) {
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        std::cerr << "could not read mesh " << path << std::endl;
+        return false;
+    }
+    const char *data = reinterpret_cast<const char *>(file.map(0, file.size()));
+    if (data == nullptr) {
+        std::cerr << "could not map mesh " << path << std::endl;
+        return false;
+    }
+    size_t size = file.size();
+
+    // Chunks end just past a newline, so no line straddles two of them
+    std::unique_ptr<ThreadPool> pool;
+    if (size >= 2 * MIN_CHUNK_BYTES) {
+        pool = std::make_unique<ThreadPool>(threads);
+    }
+    size_t chunkCount = pool ? std::min<size_t>(size / MIN_CHUNK_BYTES, 2 * pool->size()) : 1;
+    std::vector<ObjChunk> chunks(std::max<size_t>(chunkCount, 1));
+    const char *begin = data;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        const char *end = data + size * (c + 1) / chunks.size();
+        if (c + 1 < chunks.size()) {
+            end = std::max(end, begin);
+            const char *newline = static_cast<const char *>(std::memchr(end, '\n', data + size - end));
+            end = newline != nullptr ? newline + 1 : data + size;
+        }
+        chunks[c].begin = begin;
+        chunks[c].end = end;
+        begin = end;
+    }
+    if (pool && chunks.size() > 1) {
+        for (ObjChunk &chunk : chunks) {
+            pool->submit([&chunk] { parseChunk(chunk); });
+        }
+        pool->wait();
+    } else {
+        parseChunk(chunks[0]);
+    }
+
+    // Merge in file order
+    size_t positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+    for (const ObjChunk &chunk : chunks) {
+        if (chunk.error != nullptr) {
+            size_t line = 1 + std::count(data, chunk.error, '\n');
+            std::cerr << path << ":" << line << ": malformed OBJ statement" << std::endl;
+            return false;
+        }
+        positionCount += chunk.positions.size();
+        uvCount += chunk.uvs.size();
+        normalCount += chunk.normals.size();
+        cornerCount += chunk.corners.size();
+    }
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    positions.reserve(positionCount);
+    uvs.reserve(uvCount);
+    normals.reserve(normalCount);
+
+    // Vertices are the distinct (position, uv, normal) triples, numbered in order of first use.
+    // The hash map from triple to vertex is bucketed by position index, which makes the hash
+    // exact and the chains short: a position only has more than one vertex along seams.
+    std::vector<uint32_t> firstVertex(positionCount, NO_VERTEX);
+    std::vector<uint32_t> nextVertex;
+    std::vector<Corner> vertexKeys;
+    nextVertex.reserve(positionCount);
+    vertexKeys.reserve(positionCount);
+    mesh.indices.clear();
+    mesh.indices.reserve(cornerCount);
+
+    for (const ObjChunk &chunk : chunks) {
+        int32_t positionBase = positions.size();
+        int32_t uvBase = uvs.size();
+        int32_t normalBase = normals.size();
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+
+        for (Corner corner : chunk.corners) {
+            if (corner.relative & RELATIVE_POSITION) {
+                corner.position += positionBase;
+            }
+            if (corner.relative & RELATIVE_UV) {
+                corner.uv += uvBase;
+            }
+            if (corner.relative & RELATIVE_NORMAL) {
+                corner.normal += normalBase;
+            }
+            // Faces may only refer back to elements already read
+            if (corner.position < 0 || corner.position >= int32_t(positions.size())
+                || corner.uv < ABSENT || corner.uv >= int32_t(uvs.size())
+                || corner.normal < ABSENT || corner.normal >= int32_t(normals.size())) {
+                std::cerr << path << ": face index out of range" << std::endl;
+                return false;
+            }
+
+            uint32_t vertex = firstVertex[corner.position];
+            while (vertex != NO_VERTEX && (vertexKeys[vertex].uv != corner.uv || vertexKeys[vertex].normal != corner.normal)) {
+                vertex = nextVertex[vertex];
+            }
+            if (vertex == NO_VERTEX) {
+                vertex = vertexKeys.size();
+                vertexKeys.push_back(corner);
+                nextVertex.push_back(firstVertex[corner.position]);
+                firstVertex[corner.position] = vertex;
+            }
+            mesh.indices.push_back(vertex);
+        }
+    }
+    chunks.clear();
+    size_t vertexCount = vertexKeys.size();
+
+    // Area-weighted face normals gathered per position, for the vertices that have none
+    bool generateNormals = std::any_of(vertexKeys.begin(), vertexKeys.end(),
+                                       [](const Corner &key) { return key.normal == ABSENT; });
+    std::vector<glm::vec3> positionNormals;
+    if (generateNormals) {
+        positionNormals.assign(positions.size(), glm::vec3(0.f));
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            int32_t p0 = vertexKeys[mesh.indices[i]].position;
+            int32_t p1 = vertexKeys[mesh.indices[i + 1]].position;
+            int32_t p2 = vertexKeys[mesh.indices[i + 2]].position;
+            glm::vec3 faceNormal = glm::cross(positions[p1] - positions[p0], positions[p2] - positions[p0]);
+            positionNormals[p0] += faceNormal;
+            positionNormals[p1] += faceNormal;
+            positionNormals[p2] += faceNormal;
+        }
+    }
+    std::vector<glm::vec3> vertexNormals(vertexCount);
+    forSlices(pool.get(), vertexCount, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            const Corner &key = vertexKeys[v];
+            glm::vec3 normal = key.normal != ABSENT ? normals[key.normal] : positionNormals[key.position];
+            float length = glm::length(normal);
+            vertexNormals[v] = length > 0.f ? normal / length : glm::vec3(0.f, 0.f, 1.f);
+        }
+    });
+
+    // Tangents point along increasing u, gathered from each textured triangle's uv gradient
+    std::vector<glm::vec3> tangents(vertexCount, glm::vec3(0.f));
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        const Corner &k0 = vertexKeys[mesh.indices[i]];
+        const Corner &k1 = vertexKeys[mesh.indices[i + 1]];
+        const Corner &k2 = vertexKeys[mesh.indices[i + 2]];
+        if (k0.uv == ABSENT || k1.uv == ABSENT || k2.uv == ABSENT) {
+            continue;
+        }
+        glm::vec3 e1 = positions[k1.position] - positions[k0.position];
+        glm::vec3 e2 = positions[k2.position] - positions[k0.position];
+        glm::vec2 d1 = uvs[k1.uv] - uvs[k0.uv];
+        glm::vec2 d2 = uvs[k2.uv] - uvs[k0.uv];
+        float det = d1.x * d2.y - d2.x * d1.y;
+        if (det == 0.f) {
+            continue;
+        }
+        glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) / det;
+        tangents[mesh.indices[i]] += tangent;
+        tangents[mesh.indices[i + 1]] += tangent;
+        tangents[mesh.indices[i + 2]] += tangent;
+    }
+
+    mesh.vertices.resize(vertexCount * VERTEX_FLOATS);
+    forSlices(pool.get(), vertexCount, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            const Corner &key = vertexKeys[v];
+            const glm::vec3 &normal = vertexNormals[v];
+            glm::vec3 tangent = tangents[v] - normal * glm::dot(normal, tangents[v]);
+            float length = glm::length(tangent);
+            tangent = length > 1e-12f ? tangent / length : perpendicular(normal);
+
+            const glm::vec3 &position = positions[key.position];
+            glm::vec4 frame = packTangentFrame(normal, tangent);
+            glm::vec2 uv = key.uv != ABSENT ? uvs[key.uv] : glm::vec2(0.f);
+            float *out = &mesh.vertices[v * VERTEX_FLOATS];
+            out[0] = position.x;
+            out[1] = position.y;
+            out[2] = position.z;
+            out[VERTEX_FRAME_OFFSET + 0] = frame.x;
+            out[VERTEX_FRAME_OFFSET + 1] = frame.y;
+            out[VERTEX_FRAME_OFFSET + 2] = frame.z;
+            out[VERTEX_FRAME_OFFSET + 3] = frame.w;
+            out[VERTEX_UV_OFFSET + 0] = uv.x;
+            out[VERTEX_UV_OFFSET + 1] = uv.y;
+        }
+    });
+
+    mesh.bounds = AABB();
+    for (const Corner &key : vertexKeys) {
+        mesh.bounds.expand(positions[key.position]);
+    }
+    return true;
+}
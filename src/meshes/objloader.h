@@ -0,0 +1,19 @@
+#pragma once
+
+#include "meshdata.h"
+
+#include <string>
+
+// Wavefront OBJ reader for the meshes of PRIMITIVE_MESH shapes. The file is memory-mapped and
+// cut at line boundaries into chunks that are parsed in parallel, each into its own positions,
+// texture coordinates, normals and triangulated faces; the chunks are then merged in file order,
+// so the result does not depend on the thread count. Only geometry is read: v, vt, vn and f
+// (polygons are fanned into triangles); groups, materials and other statements are skipped.
+namespace ObjLoader {
+    // Reads path into mesh, with corners sharing a position, texture coordinate and normal
+    // merged into one vertex. Vertices without a normal get the area-weighted average of the
+    // normals of the faces around their position, and tangents follow the texture coordinates
+    // where there are any. threads <= 0 uses one per core. Returns false if the file can't be
+    // read or is malformed.
+    bool load(const std::string &path, MeshData &mesh, int threads = 0);
+}
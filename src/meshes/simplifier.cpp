@@ -0,0 +1,509 @@
+#include "simplifier.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <queue>
+
+namespace {
+
+constexpr uint32_t NO_VERTEX = ~0u;
+
+// Weight of a unit difference in normal or texture coordinate against squared distance. It is
+// scaled by the squared length of the collapsing edge, so like the distance it shrinks as the
+// mesh gets denser and the two stay comparable at every level.
+constexpr float ATTRIBUTE_WEIGHT = 0.5f;
+
+// A collapse may turn no surviving triangle further than this (the cosine of the angle). Small
+// turns add up over a chain of collapses, so anything near a fold is refused.
+constexpr float MIN_NORMAL_COSINE = 0.5f;
+
+// A level that removes less than this fraction of the triangles of the one before is not worth
+// its memory; the chain stops there
+constexpr float MIN_REDUCTION = 0.1f;
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix of Garland & Heckbert.
+// Kept in doubles: the distances that matter are tiny next to the terms they cancel out of.
+struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+
+    static Quadric plane(const glm::dvec3 &n, double d) {
+        return {n.x * n.x, n.x * n.y, n.x * n.z, n.y * n.y, n.y * n.z, n.z * n.z,
+                n.x * d, n.y * d, n.z * d, d * d};
+    }
+
+    Quadric &operator+=(const Quadric &q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        return *this;
+    }
+
+    float evaluate(const glm::vec3 &point) const {
+        glm::dvec3 p(point);
+        double value = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                    + 2.f * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                    + 2.f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        // Rounding can take a sum of squares just below zero
+        return float(std::max(value, 0.0));
+    }
+};
+
+// A candidate collapse of vertex onto target
+struct Collapse {
+    float cost;
+    uint32_t vertex;
+    uint32_t target;
+
+    bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+// What the costs read of a vertex, together since they are read together
+struct Attributes {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+// Vertex data the costs need, with positions moved and scaled into the unit cube so quadrics
+// of large or far-off meshes keep their precision in floats
+struct Vertices {
+    std::vector<Attributes> attributes;
+    std::vector<uint32_t> welded;       // lowest-numbered vertex at the same position
+    float scale;                        // object-space length of a unit here
+};
+
+Vertices unpackVertices(const MeshData &mesh) {
+    uint32_t vertexCount = mesh.vertexCount();
+    Vertices vertices;
+    glm::vec3 size = mesh.bounds.max - mesh.bounds.min;
+    vertices.scale = std::max(std::max(size.x, size.y), size.z);
+    if (!(vertices.scale > 0.f)) {
+        vertices.scale = 1.f;
+    }
+    vertices.attributes.resize(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        const float *data = &mesh.vertices[size_t(v) * VERTEX_FLOATS];
+        const float *frame = data + VERTEX_FRAME_OFFSET;
+        Attributes &attributes = vertices.attributes[v];
+        attributes.position = (glm::vec3(data[0], data[1], data[2]) - mesh.bounds.min) / vertices.scale;
+        attributes.normal = glm::quat(frame[3], frame[0], frame[1], frame[2]) * glm::vec3(0.f, 0.f, 1.f);
+        attributes.uv = glm::vec2(data[VERTEX_UV_OFFSET], data[VERTEX_UV_OFFSET + 1]);
+    }
+
+    // Vertices split only by their attributes share a position bit for bit; an open-addressed
+    // table of the positions finds them
+    size_t tableSize = 1;
+    while (tableSize < size_t(vertexCount) * 2) {
+        tableSize *= 2;
+    }
+    std::vector<uint32_t> table(tableSize, NO_VERTEX);
+    vertices.welded.resize(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        const float *p = &mesh.vertices[size_t(v) * VERTEX_FLOATS];
+        uint32_t bits[3];
+        std::memcpy(bits, p, sizeof(bits));
+        size_t slot = ((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u)) & (tableSize - 1);
+        while (table[slot] != NO_VERTEX &&
+               std::memcmp(&mesh.vertices[size_t(table[slot]) * VERTEX_FLOATS], p, sizeof(bits)) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == NO_VERTEX) {
+            table[slot] = v;
+        }
+        vertices.welded[v] = table[slot];
+    }
+    return vertices;
+}
+
+glm::vec3 faceNormal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2) {
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+// Marks the welded positions that must stay put: those on texture or normal seams, where the
+// vertices either side would have to move together, and those on open or non-manifold edges,
+// whose outline collapses would erode
+std::vector<bool> lockedPositions(const Vertices &vertices, const std::vector<uint32_t> &corners) {
+    uint32_t vertexCount = vertices.welded.size();
+    uint32_t triangleCount = corners.size() / 3;
+    std::vector<bool> locked(vertexCount, false);
+
+    std::vector<uint32_t> wedge(vertexCount, NO_VERTEX);
+    for (uint32_t v : corners) {
+        uint32_t w = vertices.welded[v];
+        if (wedge[w] == NO_VERTEX) {
+            wedge[w] = v;
+        } else if (wedge[w] != v) {
+            locked[w] = true;
+        }
+    }
+
+    // Edges leaving and entering each welded position, as the positions at their other ends.
+    // An edge is closed and manifold when exactly one triangle runs along it each way.
+    std::vector<uint32_t> start(vertexCount + 1, 0);
+    for (uint32_t v : corners) {
+        start[vertices.welded[v] + 1]++;
+    }
+    for (uint32_t w = 0; w < vertexCount; w++) {
+        start[w + 1] += start[w];
+    }
+    std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+    std::vector<uint32_t> leaving(corners.size());
+    std::vector<uint32_t> entering(corners.size());
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (int c = 0; c < 3; c++) {
+            uint32_t w = vertices.welded[corners[t * 3 + c]];
+            leaving[fill[w]] = vertices.welded[corners[t * 3 + (c + 1) % 3]];
+            entering[fill[w]++] = vertices.welded[corners[t * 3 + (c + 2) % 3]];
+        }
+    }
+    for (uint32_t w = 0; w < vertexCount; w++) {
+        uint32_t *out = &leaving[start[w]];
+        uint32_t *in = &entering[start[w]];
+        uint32_t count = start[w + 1] - start[w];
+        std::sort(out, out + count);
+        std::sort(in, in + count);
+        // Walk both sorted lists together; every end must appear exactly once in each
+        uint32_t i = 0;
+        uint32_t j = 0;
+        while (i < count || j < count) {
+            uint32_t end = std::min(i < count ? out[i] : NO_VERTEX, j < count ? in[j] : NO_VERTEX);
+            uint32_t outCount = 0;
+            uint32_t inCount = 0;
+            for (; i < count && out[i] == end; i++) {
+                outCount++;
+            }
+            for (; j < count && in[j] == end; j++) {
+                inCount++;
+            }
+            if (outCount != 1 || inCount != 1) {
+                locked[w] = true;
+                locked[end] = true;
+            }
+        }
+    }
+    return locked;
+}
+
+// Distance from p to the triangle abc (Ericson, Real-Time Collision Detection, 5.1.5)
+float triangleDistance(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f) {
+        return glm::length(ap);
+    }
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3) {
+        return glm::length(bp);
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+        return glm::length(ap - ab * (d1 / (d1 - d3)));
+    }
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6) {
+        return glm::length(cp);
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+        return glm::length(ap - ac * (d2 / (d2 - d6)));
+    }
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+        return glm::length(bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+    }
+    float denominator = 1.f / (va + vb + vc);
+    return glm::length(ap - ab * (vb * denominator) - ac * (vc * denominator));
+}
+
+// Furthest any measured vertex of the full mesh lies from the triangles of corners around the
+// position that stands in for it, in the unit cube. The nearest point of the surface may lie
+// elsewhere, so this can only overestimate the distance, never miss part of it.
+float deviation(const Vertices &vertices, const std::vector<uint32_t> &corners, const std::vector<uint32_t> &remap) {
+    uint32_t vertexCount = vertices.welded.size();
+    std::vector<uint32_t> start(vertexCount + 1, 0);
+    for (uint32_t v : corners) {
+        start[vertices.welded[v] + 1]++;
+    }
+    for (uint32_t w = 0; w < vertexCount; w++) {
+        start[w + 1] += start[w];
+    }
+    std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+    std::vector<uint32_t> around(corners.size());
+    for (size_t i = 0; i < corners.size(); i++) {
+        around[fill[vertices.welded[corners[i]]]++] = i / 3;
+    }
+
+    float furthest = 0.f;
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (remap[v] == NO_VERTEX) {
+            continue;
+        }
+        uint32_t w = vertices.welded[remap[v]];
+        const glm::vec3 &p = vertices.attributes[v].position;
+        float nearest = std::numeric_limits<float>::max();
+        for (uint32_t i = start[w]; i < start[w + 1]; i++) {
+            const uint32_t *triangle = &corners[size_t(around[i]) * 3];
+            nearest = std::min(nearest, triangleDistance(p, vertices.attributes[triangle[0]].position,
+                                                         vertices.attributes[triangle[1]].position,
+                                                         vertices.attributes[triangle[2]].position));
+        }
+        if (start[w] < start[w + 1]) {
+            furthest = std::max(furthest, nearest);
+        }
+    }
+    return furthest;
+}
+
+}
+
+float Simplifier::simplify(const MeshData &mesh, const std::vector<uint32_t> &indices, size_t targetTriangles,
+                           std::vector<uint32_t> &simplified, std::vector<uint32_t> &remap) {
+    Vertices vertices = unpackVertices(mesh);
+    uint32_t vertexCount = mesh.vertexCount();
+    uint32_t triangleCount = indices.size() / 3;
+    if (triangleCount <= targetTriangles) {
+        simplified = indices;
+        return deviation(vertices, simplified, remap) * vertices.scale;
+    }
+
+    std::vector<uint32_t> corners = indices;
+    std::vector<bool> locked = lockedPositions(vertices, corners);
+    auto movable = [&](uint32_t v) { return !locked[vertices.welded[v]]; };
+
+    std::vector<std::vector<uint32_t>> triangles(vertexCount);
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const uint32_t *triangle = &corners[t * 3];
+        glm::dvec3 p0 = vertices.attributes[triangle[0]].position;
+        glm::dvec3 n = glm::cross(glm::dvec3(vertices.attributes[triangle[1]].position) - p0,
+                                  glm::dvec3(vertices.attributes[triangle[2]].position) - p0);
+        double length = glm::length(n);
+        Quadric plane = length > 0.0 ? Quadric::plane(n / length, -glm::dot(n / length, p0)) : Quadric{};
+        for (int c = 0; c < 3; c++) {
+            triangles[triangle[c]].push_back(t);
+            quadrics[triangle[c]] += plane;
+        }
+    }
+
+    std::vector<bool> removed(vertexCount, false);
+    std::vector<bool> dead(triangleCount, false);
+    std::vector<uint32_t> onto(vertexCount, NO_VERTEX);    // where each removed vertex went
+
+    // Each movable vertex has at most one collapse in the heap. A vertex whose neighbourhood
+    // changes while it waits is only marked stale, and recosted when its entry comes up: the
+    // edits around it rarely make it cheaper, and this keeps the heap to one entry per vertex.
+    std::vector<Collapse> entries;
+    entries.reserve(vertexCount);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap(std::greater<Collapse>(), std::move(entries));
+    std::vector<bool> queued(vertexCount, false);
+    std::vector<bool> stale(vertexCount, false);
+
+    // Pushes the cheapest collapse of v onto any of its neighbours
+    auto pushBest = [&](uint32_t v) {
+        Collapse best = {std::numeric_limits<float>::max(), v, NO_VERTEX};
+        const Attributes &from = vertices.attributes[v];
+        // Only vertices that can move are costed, and those have a closed fan around them, so
+        // the corner after them in each triangle visits every neighbour once
+        for (uint32_t t : triangles[v]) {
+            const uint32_t *triangle = &corners[t * 3];
+            uint32_t target = triangle[triangle[0] == v ? 1 : triangle[1] == v ? 2 : 0];
+            const Attributes &to = vertices.attributes[target];
+            glm::vec3 edge = to.position - from.position;
+            glm::vec3 dn = to.normal - from.normal;
+            glm::vec2 duv = to.uv - from.uv;
+            float cost = quadrics[v].evaluate(to.position) + ATTRIBUTE_WEIGHT * glm::dot(edge, edge) * (glm::dot(dn, dn) + glm::dot(duv, duv));
+            if (cost < best.cost) {
+                best.cost = cost;
+                best.target = target;
+            }
+        }
+        if (best.target != NO_VERTEX) {
+            heap.push(best);
+            queued[v] = true;
+        }
+    };
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (!triangles[v].empty() && movable(v)) {
+            pushBest(v);
+        }
+    }
+
+    // Positions around a vertex, stamped so membership tests are one lookup
+    std::vector<uint32_t> marks(vertexCount, 0);
+    uint32_t stamp = 0;
+
+    // Whether moving v onto target keeps the surface a manifold that faces the same way: the
+    // two may share no neighbours but the far corners of the triangles along their edge, and
+    // no triangle that survives may turn over or degenerate
+    auto canCollapse = [&](uint32_t v, uint32_t target) {
+        stamp++;
+        uint32_t shared = 0;
+        for (uint32_t t : triangles[v]) {
+            const uint32_t *triangle = &corners[t * 3];
+            bool alongEdge = triangle[0] == target || triangle[1] == target || triangle[2] == target;
+            shared += alongEdge;
+            for (int c = 0; c < 3; c++) {
+                marks[vertices.welded[triangle[c]]] = stamp;
+            }
+            if (alongEdge) {
+                continue;
+            }
+            glm::vec3 p[3];
+            glm::vec3 moved[3];
+            for (int c = 0; c < 3; c++) {
+                p[c] = vertices.attributes[triangle[c]].position;
+                moved[c] = triangle[c] == v ? vertices.attributes[target].position : p[c];
+            }
+            glm::vec3 before = faceNormal(p[0], p[1], p[2]);
+            glm::vec3 after = faceNormal(moved[0], moved[1], moved[2]);
+            if (glm::dot(before, after) <= MIN_NORMAL_COSINE * glm::length(before) * glm::length(after)) {
+                return false;
+            }
+        }
+
+        uint32_t common = 0;
+        uint32_t self = vertices.welded[v];
+        uint32_t other = vertices.welded[target];
+        stamp++;
+        for (uint32_t t : triangles[target]) {
+            for (int c = 0; c < 3; c++) {
+                uint32_t w = vertices.welded[corners[t * 3 + c]];
+                if (w != self && w != other && marks[w] == stamp - 1) {
+                    common++;
+                    marks[w] = stamp;
+                }
+            }
+        }
+        return common <= shared;
+    };
+
+    auto removeTriangle = [&](uint32_t v, uint32_t t) {
+        std::vector<uint32_t> &list = triangles[v];
+        auto found = std::find(list.begin(), list.end(), t);
+        *found = list.back();
+        list.pop_back();
+    };
+
+    // A vertex whose neighbours changed is recosted now if nothing of it is queued
+    auto touch = [&](uint32_t w) {
+        if (!movable(w) || removed[w]) {
+            return;
+        }
+        if (queued[w]) {
+            stale[w] = true;
+        } else {
+            pushBest(w);
+        }
+    };
+
+    uint32_t liveTriangles = triangleCount;
+    while (liveTriangles > targetTriangles && !heap.empty()) {
+        Collapse collapse = heap.top();
+        heap.pop();
+        uint32_t v = collapse.vertex;
+        uint32_t target = collapse.target;
+        queued[v] = false;
+        if (removed[v]) {
+            continue;
+        }
+        if (stale[v] || removed[target]) {
+            stale[v] = false;
+            pushBest(v);
+            continue;
+        }
+        if (!canCollapse(v, target)) {
+            continue;
+        }
+
+        for (uint32_t t : triangles[v]) {
+            uint32_t *triangle = &corners[t * 3];
+            if (triangle[0] == target || triangle[1] == target || triangle[2] == target) {
+                dead[t] = true;
+                liveTriangles--;
+                for (int c = 0; c < 3; c++) {
+                    if (triangle[c] != v) {
+                        removeTriangle(triangle[c], t);
+                    }
+                }
+            } else {
+                for (int c = 0; c < 3; c++) {
+                    if (triangle[c] == v) {
+                        triangle[c] = target;
+                    }
+                }
+                triangles[target].push_back(t);
+            }
+        }
+        removed[v] = true;
+        onto[v] = target;
+        quadrics[target] += quadrics[v];
+
+        // The target's quadric grew, and the removed vertex's neighbours now have the target
+        // as a neighbour instead; all of them are corners of the triangles it handed over
+        for (uint32_t t : triangles[v]) {
+            if (!dead[t]) {
+                for (int c = 0; c < 3; c++) {
+                    touch(corners[t * 3 + c]);
+                }
+            }
+        }
+        touch(target);
+        triangles[v].clear();
+        triangles[v].shrink_to_fit();
+    }
+
+    simplified.clear();
+    simplified.reserve(size_t(liveTriangles) * 3);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (!dead[t]) {
+            simplified.insert(simplified.end(), &corners[t * 3], &corners[t * 3] + 3);
+        }
+    }
+
+    // A target may itself have been collapsed later on, so follow each vertex to where it ended up
+    for (uint32_t &r : remap) {
+        while (r != NO_VERTEX && onto[r] != NO_VERTEX) {
+            r = onto[r];
+        }
+    }
+    return deviation(vertices, simplified, remap) * vertices.scale;
+}
+
+void Simplifier::buildLods(MeshData &mesh) {
+    mesh.lods.clear();
+    mesh.lods.push_back({0, uint32_t(mesh.indices.size()), 0, 0, 0.f});
+
+    std::vector<uint32_t> level(mesh.indices);
+    std::vector<uint32_t> next;
+
+    // Every level is measured against the full mesh's vertices, through the vertex each one
+    // was collapsed onto
+    std::vector<uint32_t> remap(mesh.vertexCount(), NO_VERTEX);
+    for (uint32_t v : mesh.indices) {
+        remap[v] = v;
+    }
+    while (mesh.lods.size() < MAX_LODS) {
+        size_t triangles = level.size() / 3;
+        size_t target = triangles / 2;
+        if (target < MIN_LOD_TRIANGLES) {
+            break;
+        }
+        float error = simplify(mesh, level, target, next, remap);
+        if (next.size() / 3 > triangles * (1.f - MIN_REDUCTION)) {
+            break;
+        }
+        mesh.lods.push_back({uint32_t(mesh.indices.size()), uint32_t(next.size()), 0, 0, error});
+        mesh.indices.insert(mesh.indices.end(), next.begin(), next.end());
+        level.swap(next);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "meshdata.h"
+
+#include <cstdint>
+#include <vector>
+
+// Levels of detail by quadric error edge collapse (Garland & Heckbert). Each vertex carries the
+// sum of the squared-distance quadrics of the planes of its triangles, and collapsing it onto a
+// neighbour costs that quadric at the neighbour's position plus a weighted difference of their
+// normals and texture coordinates, so seams in shading and texturing are kept where the shape
+// allows. Candidate collapses are popped cheapest first from a binary heap. Vertices on borders,
+// texture or normal seams and non-manifold edges are kept in place, and collapses that would
+// flip a triangle are skipped. Collapses only ever move a vertex onto one of its neighbours, so
+// every level indexes the same vertices and the levels share one vertex buffer.
+namespace Simplifier {
+    constexpr int MAX_LODS = 8;                 // including the full mesh
+    constexpr size_t MIN_LOD_TRIANGLES = 256;   // no level is simplified below this
+
+    // Simplifies the triangles of indices towards targetTriangles, writing the result to
+    // simplified. remap holds, for each vertex of a reference mesh, the vertex that stands in
+    // for it in indices (~0u if it is not measured), and is updated to stand-ins in the result.
+    // Returns the furthest a measured vertex lies from the result's surface, in object space.
+    float simplify(const MeshData &mesh, const std::vector<uint32_t> &indices, size_t targetTriangles,
+                   std::vector<uint32_t> &simplified, std::vector<uint32_t> &remap);
+
+    // Appends a chain of levels to mesh.indices, each about half the triangles of the one
+    // before, and fills mesh.lods with the full mesh first. A level's error is the furthest
+    // any vertex of the full mesh lies from its surface.
+    void buildLods(MeshData &mesh);
+}
@@ -0,0 +1,471 @@
+#include "cpufilters.h"
+
+#include "postprocess/filterkernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The AVX2 paths are compiled per function with a target attribute, so the rest of the
+// program does not need -mavx2 and still runs on CPUs without it
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPUFILTERS_AVX2 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define CPUFILTERS_AVX2 0
+#endif
+
+// Rows per task for row-parallel passes, floats per task for column-parallel ones
+static constexpr int BAND_ROWS = 32;
+static constexpr int BAND_FLOATS = 256;
+
+template <typename Fn>
+static void parallelBands(ThreadPool &pool, int count, int band, const Fn &fn) {
+    for (int begin = 0; begin < count; begin += band) {
+        int end = std::min(count, begin + band);
+        pool.submit([&fn, begin, end] { fn(begin, end); });
+    }
+    pool.wait();
+}
+
+static inline int clampIndex(int i, int size) {
+    return std::clamp(i, 0, size - 1);
+}
+
+FloatImage imageFromRGBA8(const uint8_t *data, int width, int height, int bytesPerLine) {
+    FloatImage image(width, height);
+    for (int y = 0; y < height; y++) {
+        const uint8_t *in = data + size_t(y) * bytesPerLine;
+        float *out = image.row(y);
+        for (int i = 0; i < width * 4; i++) {
+            out[i] = in[i] * (1.f / 255.f);
+        }
+    }
+    return image;
+}
+
+void imageToRGBA8(const FloatImage &image, uint8_t *data, int bytesPerLine) {
+    for (int y = 0; y < image.height; y++) {
+        const float *in = image.row(y);
+        uint8_t *out = data + size_t(y) * bytesPerLine;
+        for (int i = 0; i < image.width * 4; i++) {
+            out[i] = static_cast<uint8_t>(std::clamp(in[i], 0.f, 1.f) * 255.f + 0.5f);
+        }
+    }
+}
+
+bool CpuFilters::hasAvx2() {
+#if CPUFILTERS_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------
+// Grayscale
+
+static void grayscalePixels(float *p, int first, int last) {
+    for (int x = first; x < last; x++) {
+        float *px = p + x * 4;
+        float luma = LUMA_R * px[0] + LUMA_G * px[1] + LUMA_B * px[2];
+        px[0] = px[1] = px[2] = luma;
+    }
+}
+
+#if CPUFILTERS_AVX2
+AVX2_TARGET static void grayscaleRowsAvx2(FloatImage &image, int y0, int y1) {
+    const __m256 luma = _mm256_setr_ps(LUMA_R, LUMA_G, LUMA_B, 0.f, LUMA_R, LUMA_G, LUMA_B, 0.f);
+    for (int y = y0; y < y1; y++) {
+        float *p = image.row(y);
+        int x = 0;
+        for (; x + 2 <= image.width; x += 2) {
+            __m256 v = _mm256_loadu_ps(p + x * 4);
+            // Dot product of rgb written to rgb of each pixel, then alpha blended back in
+            __m256 l = _mm256_dp_ps(v, luma, 0x77);
+            _mm256_storeu_ps(p + x * 4, _mm256_blend_ps(l, v, 0x88));
+        }
+        grayscalePixels(p, x, image.width);
+    }
+}
+#endif
+
+void CpuFilters::grayscale(FloatImage &image, ThreadPool &pool) {
+    parallelBands(pool, image.height, BAND_ROWS, [&](int y0, int y1) {
+#if CPUFILTERS_AVX2
+        if (hasAvx2()) {
+            grayscaleRowsAvx2(image, y0, y1);
+            return;
+        }
+#endif
+        for (int y = y0; y < y1; y++) {
+            grayscalePixels(image.row(y), 0, image.width);
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------------------------
+// Separable convolution. taps holds 2 * radius + 1 weights for offsets -radius..radius.
+
+static void convolvePixelsH(const float *src, float *dst, int width, const std::vector<float> &taps,
+                            int radius, int first, int last) {
+    for (int x = first; x < last; x++) {
+        float acc[4] = {0.f, 0.f, 0.f, 0.f};
+        for (int k = -radius; k <= radius; k++) {
+            const float *s = src + clampIndex(x + k, width) * 4;
+            float w = taps[k + radius];
+            for (int c = 0; c < 4; c++) {
+                acc[c] += w * s[c];
+            }
+        }
+        std::copy(acc, acc + 4, dst + x * 4);
+    }
+}
+
+static void convolveRowsV(const FloatImage &src, FloatImage &dst, const std::vector<float> &taps,
+                          int radius, int y0, int y1) {
+    int n = src.width * 4;
+    for (int y = y0; y < y1; y++) {
+        float *out = dst.row(y);
+        std::fill(out, out + n, 0.f);
+        for (int k = -radius; k <= radius; k++) {
+            const float *in = src.row(clampIndex(y + k, src.height));
+            float w = taps[k + radius];
+            for (int i = 0; i < n; i++) {
+                out[i] += w * in[i];
+            }
+        }
+    }
+}
+
+#if CPUFILTERS_AVX2
+AVX2_TARGET static void convolveRowsHAvx2(const FloatImage &src, FloatImage &dst, const std::vector<float> &taps,
+                                          int radius, int y0, int y1) {
+    int width = src.width;
+    // Pixels whose whole footprint is inside the row are done two at a time
+    int first = std::min(radius, width);
+    int last = std::max(first, width - radius - 1);
+    for (int y = y0; y < y1; y++) {
+        const float *in = src.row(y);
+        float *out = dst.row(y);
+        convolvePixelsH(in, out, width, taps, radius, 0, first);
+        int x = first;
+        for (; x + 2 <= last; x += 2) {
+            __m256 acc = _mm256_setzero_ps();
+            for (int k = -radius; k <= radius; k++) {
+                __m256 v = _mm256_loadu_ps(in + (x + k) * 4);
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(taps[k + radius]), v));
+            }
+            _mm256_storeu_ps(out + x * 4, acc);
+        }
+        convolvePixelsH(in, out, width, taps, radius, x, width);
+    }
+}
+
+AVX2_TARGET static void convolveRowsVAvx2(const FloatImage &src, FloatImage &dst, const std::vector<float> &taps,
+                                          int radius, int y0, int y1) {
+    int n = src.width * 4;
+    for (int y = y0; y < y1; y++) {
+        float *out = dst.row(y);
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256 acc = _mm256_setzero_ps();
+            for (int k = -radius; k <= radius; k++) {
+                __m256 v = _mm256_loadu_ps(src.row(clampIndex(y + k, src.height)) + i);
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(taps[k + radius]), v));
+            }
+            _mm256_storeu_ps(out + i, acc);
+        }
+        for (; i < n; i++) {
+            float acc = 0.f;
+            for (int k = -radius; k <= radius; k++) {
+                acc += taps[k + radius] * src.row(clampIndex(y + k, src.height))[i];
+            }
+            out[i] = acc;
+        }
+    }
+}
+#endif
+
+static void separableConvolve(FloatImage &image, const std::vector<float> &taps, int radius, ThreadPool &pool) {
+    FloatImage temp(image.width, image.height);
+    parallelBands(pool, image.height, BAND_ROWS, [&](int y0, int y1) {
+#if CPUFILTERS_AVX2
+        if (CpuFilters::hasAvx2()) {
+            convolveRowsHAvx2(image, temp, taps, radius, y0, y1);
+            return;
+        }
+#endif
+        for (int y = y0; y < y1; y++) {
+            convolvePixelsH(image.row(y), temp.row(y), image.width, taps, radius, 0, image.width);
+        }
+    });
+    parallelBands(pool, image.height, BAND_ROWS, [&](int y0, int y1) {
+#if CPUFILTERS_AVX2
+        if (CpuFilters::hasAvx2()) {
+            convolveRowsVAvx2(temp, image, taps, radius, y0, y1);
+            return;
+        }
+#endif
+        convolveRowsV(temp, image, taps, radius, y0, y1);
+    });
+}
+
+void CpuFilters::gaussianBlur(FloatImage &image, int radius, float sigma, ThreadPool &pool) {
+    std::vector<float> weights = gaussianWeights(radius, sigma);
+    std::vector<float> taps(2 * radius + 1);
+    for (int k = -radius; k <= radius; k++) {
+        taps[k + radius] = weights[std::abs(k)];
+    }
+    separableConvolve(image, taps, radius, pool);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Box blur. The horizontal pass keeps a running sum per row; the vertical pass keeps one
+// per column, so both cost two adds per pixel regardless of the radius.
+
+static void boxRowsH(const FloatImage &src, FloatImage &dst, int radius, int y0, int y1) {
+    int width = src.width;
+    float scale = 1.f / (2 * radius + 1);
+    for (int y = y0; y < y1; y++) {
+        const float *in = src.row(y);
+        float *out = dst.row(y);
+        float acc[4] = {0.f, 0.f, 0.f, 0.f};
+        for (int k = -radius; k <= radius; k++) {
+            for (int c = 0; c < 4; c++) {
+                acc[c] += in[clampIndex(k, width) * 4 + c];
+            }
+        }
+        for (int x = 0; x < width; x++) {
+            const float *add = in + clampIndex(x + radius + 1, width) * 4;
+            const float *sub = in + clampIndex(x - radius, width) * 4;
+            for (int c = 0; c < 4; c++) {
+                out[x * 4 + c] = acc[c] * scale;
+                acc[c] += add[c] - sub[c];
+            }
+        }
+    }
+}
+
+static void boxColumnsV(const FloatImage &src, FloatImage &dst, int radius, int i0, int i1) {
+    int height = src.height;
+    float scale = 1.f / (2 * radius + 1);
+    std::vector<float> acc(i1 - i0, 0.f);
+    for (int k = -radius; k <= radius; k++) {
+        const float *in = src.row(clampIndex(k, height));
+        for (int i = i0; i < i1; i++) {
+            acc[i - i0] += in[i];
+        }
+    }
+    for (int y = 0; y < height; y++) {
+        const float *add = src.row(clampIndex(y + radius + 1, height));
+        const float *sub = src.row(clampIndex(y - radius, height));
+        float *out = dst.row(y);
+        for (int i = i0; i < i1; i++) {
+            out[i] = acc[i - i0] * scale;
+            acc[i - i0] += add[i] - sub[i];
+        }
+    }
+}
+
+#if CPUFILTERS_AVX2
+AVX2_TARGET static void boxColumnsVAvx2(const FloatImage &src, FloatImage &dst, int radius, int i0, int i1) {
+    // Bands are multiples of 8 floats except possibly the last, which falls back to scalar
+    if ((i1 - i0) % 8 != 0) {
+        boxColumnsV(src, dst, radius, i0, i1);
+        return;
+    }
+    int height = src.height;
+    __m256 scale = _mm256_set1_ps(1.f / (2 * radius + 1));
+    __m256 acc[BAND_FLOATS / 8];
+    int lanes = (i1 - i0) / 8;
+    for (int j = 0; j < lanes; j++) {
+        acc[j] = _mm256_setzero_ps();
+    }
+    for (int k = -radius; k <= radius; k++) {
+        const float *in = src.row(clampIndex(k, height)) + i0;
+        for (int j = 0; j < lanes; j++) {
+            acc[j] = _mm256_add_ps(acc[j], _mm256_loadu_ps(in + j * 8));
+        }
+    }
+    for (int y = 0; y < height; y++) {
+        const float *add = src.row(clampIndex(y + radius + 1, height)) + i0;
+        const float *sub = src.row(clampIndex(y - radius, height)) + i0;
+        float *out = dst.row(y) + i0;
+        for (int j = 0; j < lanes; j++) {
+            _mm256_storeu_ps(out + j * 8, _mm256_mul_ps(acc[j], scale));
+            __m256 delta = _mm256_sub_ps(_mm256_loadu_ps(add + j * 8), _mm256_loadu_ps(sub + j * 8));
+            acc[j] = _mm256_add_ps(acc[j], delta);
+        }
+    }
+}
+#endif
+
+void CpuFilters::boxBlur(FloatImage &image, int radius, ThreadPool &pool) {
+    if (radius <= 0) {
+        return;
+    }
+    FloatImage temp(image.width, image.height);
+    parallelBands(pool, image.height, BAND_ROWS, [&](int y0, int y1) {
+        boxRowsH(image, temp, radius, y0, y1);
+    });
+    parallelBands(pool, image.width * 4, BAND_FLOATS, [&](int i0, int i1) {
+#if CPUFILTERS_AVX2
+        if (hasAvx2()) {
+            boxColumnsVAvx2(temp, image, radius, i0, i1);
+            return;
+        }
+#endif
+        boxColumnsV(temp, image, radius, i0, i1);
+    });
+}
+
+// ---------------------------------------------------------------------------------------------
+// Sobel on a luma plane
+
+static float sobelAt(const std::vector<float> &luma, int width, int height, int x, int y) {
+    auto at = [&](int dx, int dy) {
+        return luma[size_t(clampIndex(y + dy, height)) * width + clampIndex(x + dx, width)];
+    };
+    float gx = (at(1, -1) + 2.f * at(1, 0) + at(1, 1)) - (at(-1, -1) + 2.f * at(-1, 0) + at(-1, 1));
+    float gy = (at(-1, 1) + 2.f * at(0, 1) + at(1, 1)) - (at(-1, -1) + 2.f * at(0, -1) + at(1, -1));
+    return std::sqrt(gx * gx + gy * gy);
+}
+
+static void writeGray(float *p, int x, float value) {
+    p[x * 4] = p[x * 4 + 1] = p[x * 4 + 2] = value;
+}
+
+#if CPUFILTERS_AVX2
+AVX2_TARGET static void sobelRowsAvx2(const std::vector<float> &luma, FloatImage &image, int y0, int y1) {
+    int width = image.width;
+    int height = image.height;
+    const __m256 two = _mm256_set1_ps(2.f);
+    for (int y = y0; y < y1; y++) {
+        const float *above = &luma[size_t(clampIndex(y - 1, height)) * width];
+        const float *middle = &luma[size_t(y) * width];
+        const float *below = &luma[size_t(clampIndex(y + 1, height)) * width];
+        float *out = image.row(y);
+
+        if (width > 0) {
+            writeGray(out, 0, sobelAt(luma, width, height, 0, y));
+        }
+        int x = 1;
+        for (; x + 8 < width; x += 8) {
+            __m256 a0 = _mm256_loadu_ps(above + x - 1), a1 = _mm256_loadu_ps(above + x), a2 = _mm256_loadu_ps(above + x + 1);
+            __m256 m0 = _mm256_loadu_ps(middle + x - 1), m2 = _mm256_loadu_ps(middle + x + 1);
+            __m256 b0 = _mm256_loadu_ps(below + x - 1), b1 = _mm256_loadu_ps(below + x), b2 = _mm256_loadu_ps(below + x + 1);
+
+            __m256 gx = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(a2, b2), _mm256_mul_ps(two, m2)),
+                                      _mm256_add_ps(_mm256_add_ps(a0, b0), _mm256_mul_ps(two, m0)));
+            __m256 gy = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(b0, b2), _mm256_mul_ps(two, b1)),
+                                      _mm256_add_ps(_mm256_add_ps(a0, a2), _mm256_mul_ps(two, a1)));
+            __m256 magnitude = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy)));
+
+            alignas(32) float values[8];
+            _mm256_store_ps(values, magnitude);
+            for (int j = 0; j < 8; j++) {
+                writeGray(out, x + j, values[j]);
+            }
+        }
+        for (; x < width; x++) {
+            writeGray(out, x, sobelAt(luma, width, height, x, y));
+        }
+    }
+}
+#endif
+
+void CpuFilters::sobel(FloatImage &image, ThreadPool &pool) {
+    int width = image.width;
+    std::vector<float> luma(size_t(width) * image.height);
+    parallelBands(pool, image.height, BAND_ROWS, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const float *p = image.row(y);
+            for (int x = 0; x < width; x++) {
+                luma[size_t(y) * width + x] = LUMA_R * p[x * 4] + LUMA_G * p[x * 4 + 1] + LUMA_B * p[x * 4 + 2];
+            }
+        }
+    });
+    parallelBands(pool, image.height, BAND_ROWS, [&](int y0, int y1) {
+#if CPUFILTERS_AVX2
+        if (hasAvx2()) {
+            sobelRowsAvx2(luma, image, y0, y1);
+            return;
+        }
+#endif
+        for (int y = y0; y < y1; y++) {
+            for (int x = 0; x < width; x++) {
+                writeGray(image.row(y), x, sobelAt(luma, width, image.height, x, y));
+            }
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------------------------
+// General 2D convolution
+
+static void convolvePixels2D(const FloatImage &src, float *out, const std::vector<float> &kernel,
+                             int radius, int y, int first, int last) {
+    int size = 2 * radius + 1;
+    for (int x = first; x < last; x++) {
+        float acc[4] = {0.f, 0.f, 0.f, 0.f};
+        for (int dy = -radius; dy <= radius; dy++) {
+            const float *in = src.row(clampIndex(y + dy, src.height));
+            for (int dx = -radius; dx <= radius; dx++) {
+                const float *s = in + clampIndex(x + dx, src.width) * 4;
+                float w = kernel[(dy + radius) * size + dx + radius];
+                for (int c = 0; c < 4; c++) {
+                    acc[c] += w * s[c];
+                }
+            }
+        }
+        std::copy(acc, acc + 4, out + x * 4);
+    }
+}
+
+#if CPUFILTERS_AVX2
+AVX2_TARGET static void convolveRows2DAvx2(const FloatImage &src, FloatImage &dst, const std::vector<float> &kernel,
+                                           int radius, int y0, int y1) {
+    int width = src.width;
+    int size = 2 * radius + 1;
+    int first = std::min(radius, width);
+    int last = std::max(first, width - radius - 1);
+    for (int y = y0; y < y1; y++) {
+        float *out = dst.row(y);
+        convolvePixels2D(src, out, kernel, radius, y, 0, first);
+        int x = first;
+        for (; x + 2 <= last; x += 2) {
+            __m256 acc = _mm256_setzero_ps();
+            for (int dy = -radius; dy <= radius; dy++) {
+                const float *in = src.row(clampIndex(y + dy, src.height)) + x * 4;
+                const float *weights = &kernel[(dy + radius) * size + radius];
+                for (int dx = -radius; dx <= radius; dx++) {
+                    __m256 v = _mm256_loadu_ps(in + dx * 4);
+                    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(weights[dx]), v));
+                }
+            }
+            _mm256_storeu_ps(out + x * 4, acc);
+        }
+        convolvePixels2D(src, out, kernel, radius, y, x, width);
+    }
+}
+#endif
+
+void CpuFilters::convolve(FloatImage &image, const std::vector<float> &kernel, int radius, ThreadPool &pool) {
+    if (kernel.size() != size_t(2 * radius + 1) * (2 * radius + 1)) {
+        return;
+    }
+    FloatImage src = image;
+    parallelBands(pool, image.height, BAND_ROWS, [&](int y0, int y1) {
+#if CPUFILTERS_AVX2
+        if (hasAvx2()) {
+            convolveRows2DAvx2(src, image, kernel, radius, y0, y1);
+            return;
+        }
+#endif
+        for (int y = y0; y < y1; y++) {
+            convolvePixels2D(src, image.row(y), kernel, radius, y, 0, image.width);
+        }
+    });
+}
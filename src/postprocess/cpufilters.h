@@ -0,0 +1,45 @@
+#pragma once
+
+#include "utils/threadpool.h"
+
+#include <cstdint>
+#include <vector>
+
+// Interleaved RGBA float image with channels in [0, 1]
+struct FloatImage {
+    int width = 0;
+    int height = 0;
+    std::vector<float> pixels;
+
+    FloatImage() = default;
+    FloatImage(int width, int height) : width(width), height(height), pixels(size_t(width) * height * 4) {}
+
+    float *row(int y) { return &pixels[size_t(y) * width * 4]; }
+    const float *row(int y) const { return &pixels[size_t(y) * width * 4]; }
+};
+
+FloatImage imageFromRGBA8(const uint8_t *data, int width, int height, int bytesPerLine);
+void imageToRGBA8(const FloatImage &image, uint8_t *data, int bytesPerLine);
+
+// CPU versions of the post-process filters for captured frames. They use the constants in
+// filterkernels.h and clamp-to-edge sampling like the GPU chain. Work is split into row or
+// column bands on the pool; the inner loops use AVX2 when the CPU has it and plain C++
+// otherwise, with identical results up to float rounding.
+namespace CpuFilters {
+    bool hasAvx2();
+
+    // Per-pixel filter of the GPU chain
+    void grayscale(FloatImage &image, ThreadPool &pool);
+
+    // Kernel-based filter of the GPU chain when called with BLUR_RADIUS and BLUR_SIGMA
+    void gaussianBlur(FloatImage &image, int radius, float sigma, ThreadPool &pool);
+
+    // Separable box blur; sliding-window sums make it O(1) per pixel for any radius
+    void boxBlur(FloatImage &image, int radius, ThreadPool &pool);
+
+    // Gradient magnitude of the luma, written as gray; alpha is kept
+    void sobel(FloatImage &image, ThreadPool &pool);
+
+    // Arbitrary (2 * radius + 1)^2 kernel, row-major; alpha is convolved like the colors
+    void convolve(FloatImage &image, const std::vector<float> &kernel, int radius, ThreadPool &pool);
+}
@@ -0,0 +1,41 @@
+#include "dynamicresolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::reset() {
+    m_scale = MAX_SCALE;
+    m_totalMs = 0.0;
+    m_samples = 0;
+    m_frames = 0;
+}
+
+void DynamicResolution::update(double gpuMs, double budgetMs) {
+    if (gpuMs >= 0.0) {
+        m_totalMs += gpuMs;
+        m_samples++;
+    }
+    if (++m_frames < INTERVAL) {
+        return;
+    }
+    m_frames = 0;
+    if (m_samples == 0) {
+        return;
+    }
+
+    double averageMs = m_totalMs / m_samples;
+    m_totalMs = 0.0;
+    m_samples = 0;
+
+    double target = budgetMs * HEADROOM;
+    float wanted = m_scale * std::sqrt(float(target / std::max(averageMs, 0.01)));
+    wanted = std::clamp(wanted, m_scale * (1.f - MAX_CHANGE), m_scale * (1.f + MAX_CHANGE));
+
+    // Over the target, drop by at least one step; under it, grow to the nearest step but only
+    // with clear headroom, so a frame time close to the target does not flip between steps
+    float quantized = wanted < m_scale ? std::floor(wanted / STEP) * STEP : std::floor(wanted / STEP + 0.5f) * STEP;
+    if (wanted > m_scale && averageMs > target * 0.8) {
+        quantized = m_scale;    // Only grow with clear headroom
+    }
+    m_scale = std::clamp(quantized, MIN_SCALE, MAX_SCALE);
+}
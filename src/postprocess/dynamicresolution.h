@@ -0,0 +1,31 @@
+#pragma once
+
+// Picks the fraction of the widget resolution to render the scene at so the measured GPU
+// frame time stays under a budget. Fill cost scales with the pixel count, i.e. with scale^2,
+// so each adjustment moves the scale by sqrt(budget / measured), limited per step to avoid
+// oscillating. The scale is quantized so pooled render targets are not reallocated for
+// every tiny change.
+class DynamicResolution
+{
+public:
+    void reset();
+
+    // Feeds one frame's GPU time (ms, or negative if unknown); re-evaluates every INTERVAL frames
+    void update(double gpuMs, double budgetMs);
+
+    float scale() const { return m_scale; }
+
+    static constexpr float MIN_SCALE = 0.5f;
+    static constexpr float MAX_SCALE = 1.f;
+
+private:
+    static constexpr int INTERVAL = 8;
+    static constexpr float STEP = 1.f / 16.f;       // Quantization of the scale
+    static constexpr float MAX_CHANGE = 0.15f;      // Largest relative change per adjustment
+    static constexpr double HEADROOM = 0.85;        // Aim below the budget to absorb spikes
+
+    float m_scale = MAX_SCALE;
+    double m_totalMs = 0.0;
+    int m_samples = 0;
+    int m_frames = 0;
+};
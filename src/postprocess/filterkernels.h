@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+// Filter parameters shared by the GPU post-process chain and anything that has to reproduce
+// its output, so both agree on what "per-pixel" and "kernel-based" filtering mean.
+
+// Per-pixel filter: Rec. 709 luma grayscale
+constexpr float LUMA_R = 0.2126f;
+constexpr float LUMA_G = 0.7152f;
+constexpr float LUMA_B = 0.0722f;
+
+// Kernel-based filter: separable Gaussian blur
+constexpr int BLUR_RADIUS = 6;
+constexpr float BLUR_SIGMA = 3.f;
+
+// Normalized Gaussian weights for offsets 0..radius (the kernel is symmetric)
+inline std::vector<float> gaussianWeights(int radius, float sigma) {
+    std::vector<float> weights(radius + 1);
+    float sum = 0.f;
+    for (int i = 0; i <= radius; i++) {
+        weights[i] = std::exp(-0.5f * i * i / (sigma * sigma));
+        sum += i == 0 ? weights[i] : 2.f * weights[i];
+    }
+    for (float &w : weights) {
+        w /= sum;
+    }
+    return weights;
+}
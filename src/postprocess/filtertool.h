@@ -0,0 +1,6 @@
+#pragma once
+
+// Headless entry point: applies the CPU filters to a saved frame and reports throughput.
+//   --filter <input> <output> [grayscale|blur|box:<radius>|sobel|convolve:<radius>]...
+// Filters run in the order given; with none, it runs the GPU chain's grayscale then blur.
+int runFilterTool(int argc, char *argv[]);
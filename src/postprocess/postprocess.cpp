@@ -0,0 +1,185 @@
+#include "postprocess.h"
+
+#include "postprocess/filterkernels.h"
+#include "utils/shaderloader.h"
+
+void PostProcess::initialize() {
+    m_grayscaleProgram = ShaderLoader::createShaderProgram(":/resources/shaders/postprocess.vert",
+                                                           ":/resources/shaders/grayscale.frag");
+    m_blurProgram = ShaderLoader::createShaderProgram(":/resources/shaders/postprocess.vert",
+                                                      ":/resources/shaders/blur.frag");
+    glGenVertexArrays(1, &m_vao);
+
+    // Sampling between texels i and i + 1 at offset (i w_i + (i+1) w_(i+1)) / (w_i + w_(i+1))
+    // returns exactly the weighted sum of both, so BLUR_RADIUS taps per side take half the
+    // fetches. blur.frag is written for BLUR_RADIUS / 2 pairs.
+    std::vector<float> weights = gaussianWeights(BLUR_RADIUS, BLUR_SIGMA);
+    m_blurOffsets.clear();
+    m_blurWeights.clear();
+    for (int i = 1; i < BLUR_RADIUS; i += 2) {
+        float weight = weights[i] + weights[i + 1];
+        m_blurOffsets.push_back((i * weights[i] + (i + 1) * weights[i + 1]) / weight);
+        m_blurWeights.push_back(weight);
+    }
+
+    glUseProgram(m_blurProgram);
+    glUniform1i(glGetUniformLocation(m_blurProgram, "inputTexture"), 0);
+    glUniform1f(glGetUniformLocation(m_blurProgram, "centerWeight"), weights[0]);
+    glUniform1fv(glGetUniformLocation(m_blurProgram, "blurOffsets"), m_blurOffsets.size(), m_blurOffsets.data());
+    glUniform1fv(glGetUniformLocation(m_blurProgram, "blurWeights"), m_blurWeights.size(), m_blurWeights.data());
+    glUseProgram(m_grayscaleProgram);
+    glUniform1i(glGetUniformLocation(m_grayscaleProgram, "inputTexture"), 0);
+    glUseProgram(0);
+}
+
+void PostProcess::finish() {
+    for (std::unique_ptr<RenderTarget> &target : m_targets) {
+        deleteTarget(*target);
+    }
+    m_targets.clear();
+
+    glDeleteProgram(m_grayscaleProgram);
+    glDeleteProgram(m_blurProgram);
+    glDeleteVertexArrays(1, &m_vao);
+    m_grayscaleProgram = 0;
+    m_blurProgram = 0;
+    m_vao = 0;
+}
+
+void PostProcess::createTarget(RenderTarget &target, int width, int height, bool depth) {
+    target.width = width;
+    target.height = height;
+
+    glGenTextures(1, &target.color);
+    glBindTexture(GL_TEXTURE_2D, target.color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    // Linear filtering is what makes the folded blur taps work
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previous;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+
+    if (depth) {
+        glGenRenderbuffers(1, &target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Error: post-process framebuffer is not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+void PostProcess::deleteTarget(RenderTarget &target) {
+    glDeleteFramebuffers(1, &target.fbo);
+    glDeleteTextures(1, &target.color);
+    if (target.depth != 0) {
+        glDeleteRenderbuffers(1, &target.depth);
+    }
+    target = RenderTarget();
+}
+
+RenderTarget *PostProcess::acquire(int width, int height, bool depth) {
+    RenderTarget *reusable = nullptr;
+    for (std::unique_ptr<RenderTarget> &target : m_targets) {
+        if (target->inUse || (target->depth != 0) != depth) {
+            continue;
+        }
+        if (target->width == width && target->height == height) {
+            target->inUse = true;
+            return target.get();
+        }
+        reusable = target.get();
+    }
+
+    // After a resize, reallocate a stale target in place rather than growing the pool
+    if (reusable == nullptr) {
+        m_targets.push_back(std::make_unique<RenderTarget>());
+        reusable = m_targets.back().get();
+    } else {
+        deleteTarget(*reusable);
+    }
+    createTarget(*reusable, width, height, depth);
+    reusable->inUse = true;
+    return reusable;
+}
+
+void PostProcess::release(RenderTarget *target) {
+    if (target != nullptr) {
+        target->inUse = false;
+    }
+}
+
+void PostProcess::run(RenderTarget *source, const Options &options, GLuint outputFbo,
+                      int outputWidth, int outputHeight, GpuProfiler &profiler) {
+    std::vector<Pass> passes;
+    if (options.perPixel) {
+        passes.push_back({"post: grayscale", m_grayscaleProgram, {0.f, 0.f}});
+    }
+    if (options.kernel) {
+        passes.push_back({"post: blur x", m_blurProgram, {1.f, 0.f}});
+        passes.push_back({"post: blur y", m_blurProgram, {0.f, 1.f}});
+    }
+    if (passes.empty()) {
+        // Nothing to filter: just resolve (and upscale, at reduced resolution) into the output
+        profiler.begin("post: upscale");
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source->fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFbo);
+        glBlitFramebuffer(0, 0, source->width, source->height, 0, 0, outputWidth, outputHeight,
+                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+        profiler.end();
+        release(source);
+        return;
+    }
+
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(m_vao);
+    glActiveTexture(GL_TEXTURE0);
+
+    RenderTarget *input = source;
+    for (size_t i = 0; i < passes.size(); i++) {
+        const Pass &pass = passes[i];
+        bool last = i + 1 == passes.size();
+
+        RenderTarget *output = last ? nullptr : acquire(input->width, input->height, false);
+        if (last) {
+            glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+            glViewport(0, 0, outputWidth, outputHeight);
+        } else {
+            glBindFramebuffer(GL_FRAMEBUFFER, output->fbo);
+            glViewport(0, 0, output->width, output->height);
+        }
+
+        profiler.begin(pass.name);
+        glUseProgram(pass.program);
+        if (pass.program == m_blurProgram) {
+            glUniform2f(glGetUniformLocation(pass.program, "texelStep"),
+                        pass.direction[0] / input->width, pass.direction[1] / input->height);
+        }
+        glBindTexture(GL_TEXTURE_2D, input->color);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        profiler.end();
+
+        release(input);
+        input = output;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glBindVertexArray(0);
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+}
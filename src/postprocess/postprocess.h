@@ -0,0 +1,70 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include "utils/gpuprofiler.h"
+
+#include <memory>
+#include <vector>
+
+// Offscreen color (and optionally depth) target, handed out by PostProcess::acquire()
+struct RenderTarget {
+    GLuint fbo = 0;
+    GLuint color = 0;
+    GLuint depth = 0;   // Renderbuffer, 0 if the target has no depth
+    int width = 0;
+    int height = 0;
+    bool inUse = false;
+};
+
+// Runs the enabled screen-space filters over the rendered scene: the scene is drawn into a
+// pooled offscreen target, then each pass reads the previous result and writes the next,
+// ping-ponging between two pooled color targets, and the last pass writes straight to the
+// output framebuffer. Targets are reused across frames and only reallocated on resize.
+class PostProcess
+{
+public:
+    struct Options {
+        bool perPixel = false;      // Grayscale
+        bool kernel = false;        // Separable Gaussian blur
+    };
+
+    void initialize();
+    void finish();
+
+    bool hasPasses(const Options &options) const { return options.perPixel || options.kernel; }
+
+    // Returns a free target of the given size, allocating one only if none is pooled
+    RenderTarget *acquire(int width, int height, bool depth);
+    void release(RenderTarget *target);
+
+    // Filters source into outputFbo (viewport outputWidth x outputHeight) and releases source.
+    // Sources smaller than the output are upscaled by the last pass, or by a blit if no filter
+    // is enabled. Each pass is timed under its own name in profiler.
+    void run(RenderTarget *source, const Options &options, GLuint outputFbo,
+             int outputWidth, int outputHeight, GpuProfiler &profiler);
+
+private:
+    struct Pass {
+        const char *name;
+        GLuint program;
+        float direction[2];     // Blur axis in texels, unused by per-pixel passes
+    };
+
+    void createTarget(RenderTarget &target, int width, int height, bool depth);
+    void deleteTarget(RenderTarget &target);
+
+    GLuint m_grayscaleProgram = 0;
+    GLuint m_blurProgram = 0;
+    GLuint m_vao = 0;           // Empty; the fullscreen triangle comes from gl_VertexID
+
+    // Gaussian taps folded pairwise into bilinear fetches, see initialize()
+    std::vector<float> m_blurOffsets;
+    std::vector<float> m_blurWeights;
+
+    std::vector<std::unique_ptr<RenderTarget>> m_targets;
+};
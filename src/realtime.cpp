@@ -1,16 +1,23 @@
 #include "realtime.h"
 
 #include <QCoreApplication>
+#include <QFile>
 #include <QMouseEvent>
 #include <QKeyEvent>
 #include <iostream>
 #include "settings.h"
 #include "utils/shaderloader.h"
+#include "utils/lightselection.h"
+#include "utils/transformhierarchy.h"
+#include "utils/scenediff.h"
+#include "meshes/meshlets.h"
 #include "camera/camera.h"
 #include "shapes/cone.h"
 #include "shapes/cube.h"
 #include "shapes/cylinder.h"
+#include "shapes/patches.h"
 #include "shapes/sphere.h"
+#include "shapes/vertexlayout.h"
 
 // ================== Project 5: Lights, Camera
 
@@ -34,17 +41,166 @@ Realtime::Realtime(QWidget *parent)
     m_keyMap[Qt::Key_Space]   = false;
 
     // If you must use this function, do not edit anything above this
+    connect(&m_sceneWatcher, &QFileSystemWatcher::fileChanged, this, &Realtime::reloadScene);
 }
 
 /** Helper Functions **/
 
-void Realtime::setUpLights(std::string filepath, RenderData &renderData) {
-    SceneParser::parse(settings.sceneFilePath, sceneData);
+// Loads filepath on the scene loader's worker thread while the current scene keeps rendering.
+// A reload (the watched file was edited) is diffed against the current scene when it is done;
+// any other load is staged and then replaces it.
+void Realtime::loadScene(const std::string &filepath, bool reload) {
+    if (filepath.empty()) {
+        return;
+    }
+    m_loadPath = filepath;
+    m_loadIsReload = reload;
+    m_stagedScene.reset(); // Superseded
+    m_sceneLoader.load(filepath);
+}
+
+// Watches filepath, the scene now shown, for edits
+void Realtime::watchScene(const std::string &filepath) {
+    if (!m_sceneWatcher.files().isEmpty()) {
+        m_sceneWatcher.removePaths(m_sceneWatcher.files());
+    }
+    m_sceneWatcher.addPath(QString::fromStdString(filepath));
+}
+
+// Reloads the edited scenefile in the background. Editors often save several times in a row,
+// or by replacing the file, so each save restarts the reload and the path is watched again if
+// the watcher lost it. Edits to a scene that is being replaced are ignored.
+void Realtime::reloadScene(const QString &path) {
+    if (!m_sceneWatcher.files().contains(path) && QFile::exists(path)) {
+        m_sceneWatcher.addPath(path);
+    }
+    if ((m_sceneLoader.isLoading() || m_stagedScene) && !m_loadIsReload) {
+        return;
+    }
+    loadScene(path.toStdString(), true);
+}
 
+// Picks up a finished load, and advances the upload of a staged scene. Called once per frame
+// with the context current.
+void Realtime::updateSceneLoad() {
+    if (std::unique_ptr<RenderData> loaded = m_sceneLoader.take()) {
+        if (m_loadIsReload) {
+            applyReload(*loaded);
+        } else {
+            stageScene(std::move(loaded));
+        }
+    }
+    if (m_stagedScene) {
+        uploadStagedScene();
+    }
+}
+
+// Swaps in a finished reload. When the graph kept its shape, only what differs is patched:
+// moved groups go through the transform hierarchy, and materials, lights and templates are
+// replaced along with the state derived from them. Otherwise the new scene replaces the old
+// one whole, which is still cheaper than a load since the parsing has been done.
+void Realtime::applyReload(RenderData &next) {
+    SceneDiff::Changes changes = SceneDiff::diff(sceneData, next);
+    if (changes.structural) {
+        sceneData = std::move(next);
+    } else {
+        SceneDiff::apply(changes, sceneData, next);
+    }
     m_ka = sceneData.globalData.ka;
     m_kd = sceneData.globalData.kd;
     m_ks = sceneData.globalData.ks;
+    if (changes.structural || changes.camera) {
+        camera = Camera(sceneData.cameraData, m_width, m_height);
+    }
+    if (changes.structural || changes.materials) {
+        setUpTextures();
+    }
+    if (changes.structural || changes.templates) {
+        setUpInstances();
+    }
+    if (changes.structural) {
+        setUpMeshes();
+    }
+    if (changes.structural || changes.lights || changes.templates) {
+        setUpLightArrays();
+        selectShapeLights();
+    }
+}
+
+// Longest of m's basis vectors: how far it stretches a unit length, exactly so without shear
+static float maxScale(const glm::mat4 &m) {
+    return std::sqrt(std::max({glm::dot(glm::vec3(m[0]), glm::vec3(m[0])), glm::dot(glm::vec3(m[1]), glm::vec3(m[1])),
+                               glm::dot(glm::vec3(m[2]), glm::vec3(m[2]))}));
+}
 
+static std::vector<std::vector<glm::mat4>> templateInstances(const RenderData &renderData) {
+    std::vector<std::vector<glm::mat4>> instances(renderData.templates.size());
+    for (const RenderInstance &instance : renderData.instances) {
+        instances[instance.templateIndex].push_back(instance.ctm);
+    }
+    return instances;
+}
+
+// Takes a loaded scene aside until its instance buffers are resident
+void Realtime::stageScene(std::unique_ptr<RenderData> scene) {
+    m_stagedInstances = templateInstances(*scene);
+    m_stagedScene = std::move(scene);
+    m_stagedTemplate = 0;
+    m_stagedOffset = 0;
+    size_t count = m_stagedInstances.size();
+    if (m_stagedBuffers.size() < count) {
+        size_t previous = m_stagedBuffers.size();
+        m_stagedBuffers.resize(count);
+        glGenBuffers(count - previous, &m_stagedBuffers[previous]);
+    }
+}
+
+// Uploads up to STAGING_BYTES_PER_FRAME of the staged scene's instance buffers, then swaps the
+// scene in, all of its state at once, when they are complete
+void Realtime::uploadStagedScene() {
+    size_t budget = STAGING_BYTES_PER_FRAME;
+    while (m_stagedTemplate < m_stagedInstances.size() && budget > 0) {
+        const std::vector<glm::mat4> &instances = m_stagedInstances[m_stagedTemplate];
+        size_t bytes = sizeof(glm::mat4) * instances.size();
+        glBindBuffer(GL_ARRAY_BUFFER, m_stagedBuffers[m_stagedTemplate]);
+        if (m_stagedOffset == 0) {
+            glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+        }
+        size_t slice = std::min(bytes - m_stagedOffset, budget);
+        glBufferSubData(GL_ARRAY_BUFFER, m_stagedOffset, slice,
+                        reinterpret_cast<const char *>(instances.data()) + m_stagedOffset);
+        m_stagedOffset += slice;
+        budget -= slice;
+        if (m_stagedOffset == bytes) {
+            m_stagedTemplate++;
+            m_stagedOffset = 0;
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (m_stagedTemplate < m_stagedInstances.size()) {
+        return;
+    }
+
+    sceneData = std::move(*m_stagedScene);
+    m_stagedScene.reset();
+    // The old scene's buffers are reused by the next staging
+    std::swap(m_instanceBuffers, m_stagedBuffers);
+    m_templateInstances = std::move(m_stagedInstances);
+    m_instancesDirty = false;
+
+    m_ka = sceneData.globalData.ka;
+    m_kd = sceneData.globalData.kd;
+    m_ks = sceneData.globalData.ks;
+    camera = Camera(sceneData.cameraData, m_width, m_height);
+    setUpLightArrays();
+    setUpMeshes();
+    selectShapeLights();
+    setUpTextures();
+    watchScene(m_loadPath);
+}
+
+// Unpacks sceneData.lights into the per-light uniform arrays
+void Realtime::setUpLightArrays() {
     lightTypes.clear();
     lightDirs.clear();
     lightColors.clear();
@@ -91,55 +247,324 @@ void Realtime::setUpLights(std::string filepath, RenderData &renderData) {
     }
 }
 
+static void hashBytes(uint64_t &hash, const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+}
+
+// Builds the draw list (the scene's shapes, then each template's shapes drawn instanced) and
+// picks, for every item, the MAX_LIGHTS_PER_DRAW lights that contribute most to its world
+// bounds. Lights whose attenuation radius or spot cone misses the item are skipped, so
+// scenes with more lights than the shader arrays hold still render correctly. An instanced
+// item shares one selection across its instances, made for the union of their bounds.
+void Realtime::selectShapeLights() {
+    m_lightRadii.clear();
+    for (const SceneLightData &light : sceneData.lights) {
+        m_lightRadii.push_back(LightSelection::attenuationRadius(light));
+    }
+
+    m_drawItems.clear();
+    for (uint32_t i = 0; i < sceneData.shapes.size(); i++) {
+        m_drawItems.push_back({&sceneData.shapes, i, -1});
+    }
+    for (int t = 0; t < sceneData.templates.size(); t++) {
+        const RenderShapes &shapes = sceneData.templates[t].shapes;
+        for (uint32_t i = 0; i < shapes.size(); i++) {
+            m_drawItems.push_back({&shapes, i, t});
+        }
+    }
+
+    m_shapeLights.assign(m_drawItems.size() * MAX_LIGHTS_PER_DRAW, -1);
+    m_shapeLightCounts.assign(m_drawItems.size(), 0);
+    m_maxShapeLights = 0;
+    m_shapeBounds.clear();
+    m_shapeScales.clear();
+    m_shapeKeys.assign(m_drawItems.size(), 0);
+
+    for (size_t i = 0; i < m_drawItems.size(); i++) {
+        const DrawItem &item = m_drawItems[i];
+        const glm::mat4 &ctm = item.shapes->ctms[item.shape];
+        AABB local = localBounds(item);
+        AABB bounds;
+        float scale = 0.f;
+        if (item.templateIndex < 0) {
+            bounds = transformBounds(local, ctm);
+            scale = maxScale(ctm);
+        } else {
+            for (const glm::mat4 &instance : m_templateInstances[item.templateIndex]) {
+                bounds.expand(transformBounds(local, instance * ctm));
+                scale = std::max(scale, maxScale(instance * ctm));
+            }
+        }
+        m_shapeBounds.push_back(bounds);
+        m_shapeScales.push_back(scale);
+        refreshItem(i);
+    }
+
+    // Item indices may now refer to different shapes
+    m_shadowAtlas.invalidate();
+}
+
+// Gathers the instance CTMs of each template, for uploadInstances() to upload
+void Realtime::setUpInstances() {
+    m_templateInstances = templateInstances(sceneData);
+    m_instancesDirty = true;
+}
+
+// Rehashes item i and picks its lights again, for its current transforms and m_shapeBounds[i]
+void Realtime::refreshItem(size_t i) {
+    const DrawItem &item = m_drawItems[i];
+    const glm::mat4 &ctm = item.shapes->ctms[item.shape];
+    PrimitiveType type = item.shapes->types[item.shape];
+    uint64_t key = 14695981039346656037ull;
+    hashBytes(key, &type, sizeof(type));
+    hashBytes(key, &ctm[0][0], sizeof(glm::mat4));
+    if (item.templateIndex >= 0) {
+        for (const glm::mat4 &instance : m_templateInstances[item.templateIndex]) {
+            hashBytes(key, &instance[0][0], sizeof(glm::mat4));
+        }
+    }
+    m_shapeKeys[i] = key;
+
+    std::vector<int> selected;
+    LightSelection::select(sceneData.lights, m_lightRadii, m_shapeBounds[i], MAX_LIGHTS_PER_DRAW, selected);
+    std::copy(selected.begin(), selected.end(), m_shapeLights.begin() + i * MAX_LIGHTS_PER_DRAW);
+    m_shapeLightCounts[i] = selected.size();
+    m_maxShapeLights = std::max<int>(m_maxShapeLights, selected.size());
+}
+
+// Moves a group of the scene: node indexes sceneData.hierarchy, and local replaces the
+// composition of its transformations. Takes effect at the next paintGL().
+void Realtime::moveNode(int node, const glm::mat4 &local) {
+    TransformHierarchy::setLocal(sceneData, node, local);
+    update();
+}
+
+// Applies the nodes moved since the last frame. Moved shapes get new bounds, shadow keys and
+// lights in place, which costs in proportion to what moved; moving a light or a template
+// instance changes what other items see, so those redo the whole selection.
+void Realtime::updateTransforms() {
+    TransformHierarchy::Update moved = TransformHierarchy::update(sceneData);
+    if (moved.instancesMoved) {
+        setUpInstances();
+    }
+    if (moved.lightsMoved || moved.instancesMoved) {
+        setUpLightArrays();
+        selectShapeLights();
+        return;
+    }
+    // Scene shapes are the first items, in order
+    for (auto [begin, end] : moved.shapeRanges) {
+        for (uint32_t i = begin; i < end; i++) {
+            m_shapeBounds[i] = transformBounds(localBounds(m_drawItems[i]), sceneData.shapes.ctms[i]);
+            m_shapeScales[i] = maxScale(sceneData.shapes.ctms[i]);
+            refreshItem(i);
+        }
+    }
+}
+
+// Requests the texture and bump map of every material that has them. Loads are asynchronous and
+// shared by path, so this returns immediately and reloading a scene reuses whatever is resident.
+void Realtime::setUpTextures() {
+    m_materialTextures.clear();
+    m_materialBumpMaps.clear();
+    for (const SceneMaterial &material : sceneData.materials) {
+        const SceneFileMap &map = material.textureMap;
+        const SceneFileMap &bump = material.bumpMap;
+        m_materialTextures.push_back(map.isUsed ? m_textures.acquire(map.filename) : -1);
+        m_materialBumpMaps.push_back(bump.isUsed ? m_textures.acquire(bump.filename) : -1);
+    }
+}
+
+// Requests the mesh of every mesh path in the scene. Like textures, meshes load asynchronously
+// and are shared by path; shapes whose mesh isn't resident yet are skipped when drawing.
+void Realtime::setUpMeshes() {
+    m_meshHandles.clear();
+    for (const std::string &meshfile : sceneData.meshfiles) {
+        m_meshHandles.push_back(m_meshes.acquire(meshfile));
+    }
+}
+
+// Mesh buffer handle of an item's mesh, or -1 if it isn't a mesh
+int Realtime::meshHandle(const DrawItem &item) const {
+    uint32_t meshfile = item.shapes->meshfiles[item.shape];
+    if (item.shapes->types[item.shape] != PrimitiveType::PRIMITIVE_MESH || meshfile == NO_MESHFILE) {
+        return -1;
+    }
+    return m_meshHandles[meshfile];
+}
+
+// Object-space bounds of an item: its mesh's once resident, otherwise the unit primitive's
+AABB Realtime::localBounds(const DrawItem &item) const {
+    int mesh = meshHandle(item);
+    return m_meshes.isResident(mesh) ? m_meshes.bounds(mesh) : unitPrimitiveBounds();
+}
+
+// Sizes vbo for shape's tessellation and has the shape write it straight into the mapped
+// storage, so the vertices are never built up in client memory first. If the buffer can't be
+// mapped, or its storage is lost while mapped, the tessellation goes through a temporary
+// instead. Returns the number of vertices.
+template <typename Shape>
+static GLsizei uploadShape(GLuint vbo, const Shape &shape) {
+    size_t floats = shape.vertexCount() * VERTEX_FLOATS;
+    GLsizeiptr bytes = floats * sizeof(GLfloat);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+    void *mapped = bytes > 0 ? glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)
+                             : nullptr;
+    bool written = false;
+    if (mapped != nullptr) {
+        shape.generateShape(std::span<float>(static_cast<float *>(mapped), floats));
+        written = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+    }
+    if (!written && bytes > 0) {
+        std::vector<float> vertices(floats);
+        shape.generateShape(vertices);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, vertices.data());
+    }
+    return shape.vertexCount();
+}
+
 void Realtime::setUpShapes() {
     // Shape VAO/VBO generation
-    Cube cube{};
-    cube.updateParams(settings.shapeParameter1);
-    std::vector<float> cubeVerts = cube.generateShape();
+    // The sliders are the upper bound; the quality governor may ask for less
+    int param1 = m_qualityGovernor.apply(settings.shapeParameter1);
+    int param2 = m_qualityGovernor.apply(settings.shapeParameter2);
+    m_shapeParam1 = param1;
+    m_shapeParam2 = param2;
+    m_shapesPatched = settings.hardwareTessellation;
 
+    Cube cube{};
+    cube.updateParams(param1);
     Cone cone{};
-    cone.updateParams(settings.shapeParameter1, settings.shapeParameter2);
-    std::vector<float> coneVerts = cone.generateShape();
-
+    cone.updateParams(param1, param2);
     Cylinder cylinder{};
-    cylinder.updateParams(settings.shapeParameter1, settings.shapeParameter2);
-    std::vector<float> cylinderVerts = cylinder.generateShape();
-
+    cylinder.updateParams(param1, param2);
     Sphere sphere{};
-    sphere.updateParams(settings.shapeParameter1, settings.shapeParameter2);
-    std::vector<float> sphereVerts = sphere.generateShape();
+    sphere.updateParams(param1, param2);
 
-    vertsList = {cubeVerts, coneVerts, cylinderVerts, sphereVerts};
+    // New tessellation means new shadow caster geometry
+    m_shadowAtlas.invalidate();
 
     for (int i = 0; i < 4; i++) {
-        glGenBuffers(1, &vbos[i]);
-        glBindBuffer(GL_ARRAY_BUFFER, vbos[i]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vertsList[i].size(), vertsList[i].data(), GL_STATIC_DRAW);
+        // Re-tessellation reuses the existing objects; only their storage is replaced
+        if (vbos[i] == 0) {
+            glGenBuffers(1, &vbos[i]);
+        }
+        // Shapes drawn as patches are refined on the GPU, so their CPU tessellation is neither
+        // generated nor kept
+        if (isPatched(i)) {
+            glBindBuffer(GL_ARRAY_BUFFER, vbos[i]);
+            glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+            m_shapeVertexCounts[i] = 0;
+        } else {
+            switch (i) {
+            case 0: m_shapeVertexCounts[i] = uploadShape(vbos[i], cube); break;
+            case 1: m_shapeVertexCounts[i] = uploadShape(vbos[i], cone); break;
+            case 2: m_shapeVertexCounts[i] = uploadShape(vbos[i], cylinder); break;
+            case 3: m_shapeVertexCounts[i] = uploadShape(vbos[i], sphere); break;
+            }
+        }
 
-        glGenVertexArrays(1, &vaos[i]);
+        if (vaos[i] == 0) {
+            glGenVertexArrays(1, &vaos[i]);
+        }
         glBindVertexArray(vaos[i]);
 
         glEnableVertexAttribArray(0);
         glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
 
-        glVertexAttribPointer(0, vertsList[i].size() / 2, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), nullptr);
-        glVertexAttribPointer(1, vertsList[i].size() / 2, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), reinterpret_cast<void*>(3 * sizeof(GLfloat)));
+        // Position, tangent frame quaternion and texture coordinate; see shapes/vertexlayout.h
+        GLsizei stride = VERTEX_FLOATS * sizeof(GLfloat);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(VERTEX_FRAME_OFFSET * sizeof(GLfloat)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(VERTEX_UV_OFFSET * sizeof(GLfloat)));
         glBindVertexArray(0);
         glBindBuffer(GL_ARRAY_BUFFER,0);
     }
 }
 
+// Uploads the coarse patches the curved shapes are drawn from under hardware tessellation,
+// into their own buffers at the same indices as vaos. They depend on no setting, so this runs
+// once; the detail is all picked per frame by the tessellation shaders.
+void Realtime::setUpPatches() {
+    glPatchParameteri(GL_PATCH_VERTICES, Patches::PATCH_VERTICES);
+    for (int i = 1; i < 4; i++) {
+        std::vector<float> patches;
+        switch (i) {
+        case 1: patches = Patches::cone(); break;
+        case 2: patches = Patches::cylinder(); break;
+        case 3: patches = Patches::sphere(); break;
+        }
+        glGenBuffers(1, &m_patchVbos[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, m_patchVbos[i]);
+        glBufferData(GL_ARRAY_BUFFER, patches.size() * sizeof(GLfloat), patches.data(), GL_STATIC_DRAW);
+        m_patchVertexCounts[i] = patches.size() / Patches::PATCH_FLOATS;
+
+        glGenVertexArrays(1, &m_patchVaos[i]);
+        glBindVertexArray(m_patchVaos[i]);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+
+        // Corner position, then its surface coordinates and surface id
+        GLsizei stride = Patches::PATCH_FLOATS * sizeof(GLfloat);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(3 * sizeof(GLfloat)));
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Whether the shape at index into vaos is drawn from its patches this frame
+bool Realtime::isPatched(int index) const {
+    return settings.hardwareTessellation && index >= 0 && m_patchVertexCounts[index] > 0;
+}
+
+// Specializes the default program for the most lights any shape of the loaded scene uses.
+// The request only queues the compile; until it finishes, paintGL() keeps rendering with m_shader.
+// The tessellating variant is only requested while hardware tessellation is on.
+void Realtime::requestSceneShader() {
+    int numLights = m_maxShapeLights;
+    std::vector<std::string> defines = {"NUM_LIGHTS " + std::to_string(numLights)};
+    if (numLights != m_sceneShaderLights) {
+        m_sceneShaderLights = numLights;
+        m_sceneShader = m_shaderBuilder.request(":/resources/shaders/default.vert",
+                                                ":/resources/shaders/default.frag", defines);
+    }
+    if (settings.hardwareTessellation && numLights != m_sceneTessShaderLights) {
+        m_sceneTessShaderLights = numLights;
+        m_sceneTessShader = m_shaderBuilder.request(
+            ":/resources/shaders/tessellation.vert", ":/resources/shaders/tessellation.tesc",
+            ":/resources/shaders/tessellation.tese", ":/resources/shaders/default.frag", defines);
+    }
+}
+
 void Realtime::finish() {
     killTimer(m_timer);
     this->makeCurrent();
 
     // Students: anything requiring OpenGL calls when the program exits should be done here
     glDeleteProgram(m_shader);
+    m_shaderBuilder.clear();
+    m_profiler.clear();
+    m_shadowAtlas.finish();
+    m_textures.finish();
+    m_meshes.finish();
+    m_postProcess.finish();
 
     for (int i = 0; i < 4; i++) {
         glDeleteVertexArrays(1, &vaos[i]);
         glDeleteBuffers(1, &vbos[i]);
+        glDeleteVertexArrays(1, &m_patchVaos[i]);
+        glDeleteBuffers(1, &m_patchVbos[i]);
     }
+    glDeleteBuffers(m_instanceBuffers.size(), m_instanceBuffers.data());
+    m_instanceBuffers.clear();
+    glDeleteBuffers(m_stagedBuffers.size(), m_stagedBuffers.data());
+    m_stagedBuffers.clear();
 
     this->doneCurrent();
 }
@@ -167,117 +592,378 @@ void Realtime::initializeGL() {
     glViewport(0, 0, size().width() * m_devicePixelRatio, size().height() * m_devicePixelRatio);
 
     // Students: anything requiring OpenGL calls when the program starts should be done here
-    setUpLights(settings.sceneFilePath, sceneData);
+    loadScene(settings.sceneFilePath);
     glClearColor(0,0,0,1);
 
     m_shader = ShaderLoader::createShaderProgram(":/resources/shaders/default.vert", ":/resources/shaders/default.frag");
+    m_program = m_shader;
+    m_shaderBuilder.initialize();
+    m_depthShader = m_shaderBuilder.request(":/resources/shaders/depth.vert", ":/resources/shaders/depth.frag");
+    m_tessShader = m_shaderBuilder.request(":/resources/shaders/tessellation.vert", ":/resources/shaders/tessellation.tesc",
+                                           ":/resources/shaders/tessellation.tese", ":/resources/shaders/default.frag");
+    m_tessDepthShader = m_shaderBuilder.request(":/resources/shaders/tessellation.vert",
+                                                ":/resources/shaders/tessellation.tesc",
+                                                ":/resources/shaders/tessellation.tese",
+                                                ":/resources/shaders/depth.frag");
+    m_shadowAtlas.initialize();
+    m_textures.initialize();
+    m_postProcess.initialize();
+    setUpPatches();
     setUpShapes();
 
     initialized = true;
 }
 
-void Realtime::draw(RenderShapeData shape) {
+// Returns the index into vaos/m_shapeVertexCounts holding the tessellation of the given primitive
+static int shapeIndex(PrimitiveType type) {
+    switch (type) {
+    case PrimitiveType::PRIMITIVE_CUBE:     return 0;
+    case PrimitiveType::PRIMITIVE_CONE:     return 1;
+    case PrimitiveType::PRIMITIVE_CYLINDER: return 2;
+    case PrimitiveType::PRIMITIVE_SPHERE:   return 3;
+    default:                                return -1;
+    }
+}
+
+// Uploads the per-frame shadow atlas state to program. The atlas lives on texture unit 1
+// so unit 0 stays free for material textures.
+void Realtime::setUpShadowUniforms(GLuint program) {
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_shadowAtlas.texture());
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "shadowAtlas"), 1);
+
+    const std::vector<glm::mat4> &matrices = m_shadowAtlas.tileMatrices();
+    const std::vector<glm::vec4> &rects = m_shadowAtlas.tileRects();
+    if (!matrices.empty()) {
+        glUniformMatrix4fv(glGetUniformLocation(program, "shadowMatrices"), matrices.size(), GL_FALSE, &matrices[0][0][0]);
+        glUniform4fv(glGetUniformLocation(program, "shadowTiles"), rects.size(), &rects[0][0]);
+    }
+    glm::vec4 cascadeEnds = m_shadowAtlas.cascadeEnds();
+    glUniform4fv(glGetUniformLocation(program, "cascadeEnds"), 1, &cascadeEnds[0]);
+    glm::vec4 look = camera.getData().look;
+    glUniform4fv(glGetUniformLocation(program, "camera_look"), 1, &look[0]);
+    glUseProgram(0);
+}
+
+// Uploads what the tessellation control shader sizes patch edges by this frame: a segment
+// per TESS_PIXELS_PER_SEGMENT pixels, fewer when the quality governor is holding detail back.
+// The depth program gets the same values, or the pre-pass depths would not match the shading
+// pass's.
+void Realtime::setUpTessellationUniforms(int viewportHeight) {
+    if (!settings.hardwareTessellation) {
+        return;
+    }
+    float pixelsPerUnit = 0.5f * camera.getProjMatrix()[1][1] * viewportHeight;
+    float density = pixelsPerUnit / TESS_PIXELS_PER_SEGMENT * m_qualityGovernor.level();
     glm::vec4 cameraPos = camera.getData().pos;
-    int numLights = sceneData.lights.size();
+    for (GLuint program : {m_tessProgram, m_shaderBuilder.get(m_tessDepthShader, 0)}) {
+        if (program == 0) {
+            continue;
+        }
+        glUseProgram(program);
+        glUniform1f(glGetUniformLocation(program, "tessDensity"), density);
+        glUniform1f(glGetUniformLocation(program, "tessDistance"), 0.f);
+        glUniform4fv(glGetUniformLocation(program, "camera_pos"), 1, &cameraPos[0]);
+    }
+    glUseProgram(0);
+}
+
+// Shadow tiles are cached across camera moves, so shadow casters are sized as if every edge
+// were seen from unit distance: SHADOW_TESS_SEGMENTS_PER_UNIT segments per world unit, however
+// the camera moves. A quality governor step re-tessellates, which invalidates every tile, so
+// the governor's level can still apply.
+void Realtime::setUpShadowTessellationUniforms() {
+    GLuint program = m_shaderBuilder.get(m_tessDepthShader, 0);
+    if (!settings.hardwareTessellation || program == 0) {
+        return;
+    }
+    glUseProgram(program);
+    glUniform1f(glGetUniformLocation(program, "tessDensity"), SHADOW_TESS_SEGMENTS_PER_UNIT * m_qualityGovernor.level());
+    glUniform1f(glGetUniformLocation(program, "tessDistance"), 1.f);
+    glUseProgram(0);
+}
+
+// Uploads the instance CTMs of every template, one buffer per template, after a scene load
+void Realtime::uploadInstances() {
+    size_t count = m_templateInstances.size();
+    if (m_instanceBuffers.size() < count) {
+        size_t previous = m_instanceBuffers.size();
+        m_instanceBuffers.resize(count);
+        glGenBuffers(count - previous, &m_instanceBuffers[previous]);
+    }
+    for (size_t t = 0; t < count; t++) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffers[t]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * m_templateInstances[t].size(),
+                     m_templateInstances[t].data(), GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_instancesDirty = false;
+}
+
+// Points attributes 3-6 (the instance matrix columns) of the bound VAO at the instances of
+// templateIndex, or for a shape outside any template disables them so the shader reads the
+// identity. Returns how many instances to draw.
+int Realtime::bindInstances(int templateIndex) {
+    if (templateIndex < 0) {
+        for (int column = 0; column < 4; column++) {
+            glDisableVertexAttribArray(3 + column);
+            glm::vec4 identity(0.f);
+            identity[column] = 1.f;
+            glVertexAttrib4fv(3 + column, &identity[0]);
+        }
+        return 1;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffers[templateIndex]);
+    for (int column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              reinterpret_cast<void*>(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(3 + column, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return m_templateInstances[templateIndex].size();
+}
+
+// Picks the level of detail of every mesh item for the depth pre-pass and the shading pass,
+// from how many pixels its error would cover at the item's nearest point, and culls the
+// meshlets of that level for items drawn once. Instanced items are drawn whole, since GL 4.1
+// can't give each instance its own index ranges. Shadow maps see from the lights and are
+// cached across frames, so they draw the full meshes.
+void Realtime::cullMeshlets(int viewportHeight) {
+    Frustum frustum = frustumFromMatrix(camera.getProjMatrix() * camera.getViewMatrix());
+    glm::vec3 cameraPos = glm::vec3(camera.getData().pos);
+    float pixelsPerUnit = 0.5f * camera.getProjMatrix()[1][1] * viewportHeight;
+    m_itemLods.assign(m_drawItems.size(), 0);
+    m_itemRuns.clear();
+    m_runFirsts.clear();
+    m_runCounts.clear();
+    for (size_t i = 0; i < m_drawItems.size(); i++) {
+        const DrawItem &item = m_drawItems[i];
+        m_itemRuns.push_back(m_runFirsts.size());
+        int mesh = meshHandle(item);
+        if (!m_meshes.isResident(mesh)) {
+            continue;
+        }
+
+        const std::vector<MeshLod> &lods = m_meshes.lods(mesh);
+        float distance = std::max(std::sqrt(distanceSquared(m_shapeBounds[i], cameraPos)), settings.nearPlane);
+        float pixelsPerError = pixelsPerUnit * m_shapeScales[i] / distance;
+        uint32_t lod = 0;
+        while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerError <= LOD_PIXEL_ERROR) {
+            lod++;
+        }
+        m_itemLods[i] = lod;
+
+        if (item.templateIndex < 0) {
+            const Meshlet *meshlets = &m_meshes.meshlets(mesh)[lods[lod].firstMeshlet];
+            Meshlets::cull(meshlets, lods[lod].meshletCount, item.shapes->ctms[item.shape], frustum, cameraPos,
+                           m_runFirsts, m_runCounts);
+        }
+    }
+    m_itemRuns.push_back(m_runFirsts.size());
+
+    m_drawCounts.assign(m_runCounts.begin(), m_runCounts.end());
+    m_drawOffsets.resize(m_runFirsts.size());
+    for (size_t r = 0; r < m_runFirsts.size(); r++) {
+        m_drawOffsets[r] = reinterpret_cast<const void *>(m_runFirsts[r] * sizeof(GLuint));
+    }
+}
+
+// Draws the bound mesh of item i: if culled, the level cullMeshlets() picked and only its
+// meshlets that survived, otherwise the full mesh
+void Realtime::drawMesh(size_t i, int mesh, int instances, bool culled) {
+    if (!culled || instances != 1) {
+        const MeshLod &lod = m_meshes.lods(mesh)[culled ? m_itemLods[i] : 0];
+        glDrawElementsInstanced(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT,
+                                reinterpret_cast<const void *>(lod.firstIndex * sizeof(GLuint)), instances);
+        return;
+    }
+    uint32_t begin = m_itemRuns[i];
+    uint32_t end = m_itemRuns[i + 1];
+    if (begin < end) {
+        glMultiDrawElements(GL_TRIANGLES, &m_drawCounts[begin], GL_UNSIGNED_INT, &m_drawOffsets[begin], end - begin);
+    }
+}
+
+// Depth-only draw for the pre-pass and shadow maps: only the transform uniforms matter here
+void Realtime::drawDepth(size_t i, GLuint program, bool culled) {
+    const DrawItem &item = m_drawItems[i];
+    int index = shapeIndex(item.shapes->types[item.shape]);
+    int mesh = meshHandle(item);
+    if (index < 0 && !m_meshes.isResident(mesh)) {
+        return;
+    }
+
+    // Patches go through the tessellating depth program instead, which the pre-pass or shadow
+    // tile has given the same view and projection as program. They wait for the shading
+    // program too, so a shape never lays down depth it isn't shaded at.
+    bool patched = isPatched(index);
+    GLuint drawProgram = program;
+    if (patched) {
+        drawProgram = m_shaderBuilder.get(m_tessDepthShader, 0);
+        if (drawProgram == 0 || m_tessProgram == 0) {
+            return;
+        }
+        glUseProgram(drawProgram);
+    }
 
-    PrimitiveType type = shape.primitive.type;
+    GLint modelLoc = glGetUniformLocation(drawProgram, "model");
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &item.shapes->ctms[item.shape][0][0]);
+
+    if (patched) {
+        glBindVertexArray(m_patchVaos[index]);
+    } else {
+        glBindVertexArray(index >= 0 ? vaos[index] : m_meshes.vao(mesh));
+    }
+    int instances = bindInstances(item.templateIndex);
+    if (patched) {
+        glDrawArraysInstanced(GL_PATCHES, 0, m_patchVertexCounts[index], instances);
+        glUseProgram(program);
+    } else if (index >= 0) {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, m_shapeVertexCounts[index], instances);
+    } else {
+        drawMesh(i, mesh, instances, culled);
+    }
+}
+
+void Realtime::draw(const DrawItem &item, int shapeID) {
+    glm::vec4 cameraPos = camera.getData().pos;
+
+    PrimitiveType type = item.shapes->types[item.shape];
     GLuint vao;
-    std::vector<float> verts;
-    glm::mat4 ctm = shape.ctm;
-
-    glm::vec4 cAmbient = shape.primitive.material.cAmbient;
-    glm::vec4 cDiffuse = shape.primitive.material.cDiffuse;
-    glm::vec4 cSpecular = shape.primitive.material.cSpecular;
-    float shininess = shape.primitive.material.shininess;
-
-    if (type == PrimitiveType::PRIMITIVE_CUBE) {
-        vao = vaos[0];
-        verts = vertsList[0];
-    } else if (type == PrimitiveType::PRIMITIVE_CONE) {
-        vao = vaos[1];
-        verts = vertsList[1];
-    } else if (type == PrimitiveType::PRIMITIVE_CYLINDER) {
-        vao = vaos[2];
-        verts = vertsList[2];
-    } else if (type == PrimitiveType::PRIMITIVE_SPHERE) {
-        vao = vaos[3];
-        verts = vertsList[3];
+    const glm::mat4 &ctm = item.shapes->ctms[item.shape];
+
+    uint32_t materialIndex = item.shapes->materials[item.shape];
+    const SceneMaterial &material = sceneData.materials[materialIndex];
+    glm::vec4 cAmbient = material.cAmbient;
+    glm::vec4 cDiffuse = material.cDiffuse;
+    glm::vec4 cSpecular = material.cSpecular;
+    float shininess = material.shininess;
+
+    // Implicit shapes use the tessellation at vaos[index], or their patches and the tessellating
+    // program once it is built; meshes are drawn once resident
+    int index = shapeIndex(type);
+    int mesh = meshHandle(item);
+    bool patched = isPatched(index);
+    GLuint program = patched ? m_tessProgram : m_program;
+    if (patched) {
+        vao = m_patchVaos[index];
+    } else if (index >= 0) {
+        vao = vaos[index];
+    } else if (m_meshes.isResident(mesh)) {
+        vao = m_meshes.vao(mesh);
+    } else {
+        return;
+    }
+    if (program == 0) {
+        return;
     }
 
     glBindVertexArray(vao);
-    glUseProgram(m_shader);
+    glUseProgram(program);
 
     // Camera
-    GLint modelLoc = glGetUniformLocation(m_shader, "model");
+    GLint modelLoc = glGetUniformLocation(program, "model");
     glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &ctm[0][0]);
 
-    GLint viewLoc = glGetUniformLocation(m_shader, "view");
+    GLint viewLoc = glGetUniformLocation(program, "view");
     glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &camera.getViewMatrix()[0][0]);
 
-    GLint projLoc = glGetUniformLocation(m_shader, "proj");
+    GLint projLoc = glGetUniformLocation(program, "proj");
     glUniformMatrix4fv(projLoc, 1, GL_FALSE, &camera.getProjMatrix()[0][0]);
 
-    GLint cameraPosLoc = glGetUniformLocation(m_shader, "camera_pos");
+    GLint cameraPosLoc = glGetUniformLocation(program, "camera_pos");
     glUniform4f(cameraPosLoc, cameraPos[0], cameraPos[1], cameraPos[2], cameraPos[3]);
 
     // Global Properties
-    GLint kaLoc = glGetUniformLocation(m_shader, "k_a");
+    GLint kaLoc = glGetUniformLocation(program, "k_a");
     glUniform1f(kaLoc, m_ka);
 
-    GLint kdLoc = glGetUniformLocation(m_shader, "k_d");
+    GLint kdLoc = glGetUniformLocation(program, "k_d");
     glUniform1f(kdLoc, m_kd);
 
-    GLint ksLoc = glGetUniformLocation(m_shader, "k_s");
+    GLint ksLoc = glGetUniformLocation(program, "k_s");
     glUniform1f(ksLoc, m_ks);
 
     // Shape Properties
-    GLint ambientLoc = glGetUniformLocation(m_shader, "cAmbient");
+    GLint ambientLoc = glGetUniformLocation(program, "cAmbient");
     glUniform4f(ambientLoc, cAmbient[0], cAmbient[1], cAmbient[2], cAmbient[3]);
 
-    GLint diffuseLoc = glGetUniformLocation(m_shader, "cDiffuse");
+    GLint diffuseLoc = glGetUniformLocation(program, "cDiffuse");
     glUniform4f(diffuseLoc, cDiffuse[0], cDiffuse[1], cDiffuse[2], cDiffuse[3]);
 
-    GLint specLoc = glGetUniformLocation(m_shader, "cSpecular");
+    GLint specLoc = glGetUniformLocation(program, "cSpecular");
     glUniform4f(specLoc, cSpecular[0], cSpecular[1], cSpecular[2], cSpecular[3]);
 
-    GLint shininessLoc = glGetUniformLocation(m_shader, "shininess");
+    GLint shininessLoc = glGetUniformLocation(program, "shininess");
     glUniform1f(shininessLoc, shininess);
 
-    // Lights
-    GLint numLightsLoc = glGetUniformLocation(m_shader, "numLights");
-    glUniform1i(numLightsLoc, numLights);
-
-    for (int i = 0; i < sceneData.lights.size(); i++) {
-        std::string str = "lightTypes[" + std::to_string(i) + "]";
-        GLint lightTypesLoc = glGetUniformLocation(m_shader, str.c_str());
-        glUniform1i(lightTypesLoc, lightTypes[i]);
-
-        str = "lightPos[" + std::to_string(i) + "]";
-        GLint lightPosLoc = glGetUniformLocation(m_shader, str.c_str());
-        glUniform4f(lightPosLoc, lightPos[i][0],  lightPos[i][1],  lightPos[i][2],  lightPos[i][3]);
-
-        str =  "lightColors[" + std::to_string(i) + "]";
-        GLint lightColorsLoc= glGetUniformLocation(m_shader, str.c_str());
-        glUniform4f(lightColorsLoc, lightColors[i][0], lightColors[i][1], lightColors[i][2], lightColors[i][3]);
-
-        str =  "lightDirs[" + std::to_string(i) + "]";
-        GLint lightDirsLoc = glGetUniformLocation(m_shader, str.c_str());
-        glUniform4f(lightDirsLoc, lightDirs[i][0], lightDirs[i][1], lightDirs[i][2], lightDirs[i][3]);
-
-        str =  "functions[" + std::to_string(i) + "]";
-        GLint functionsLoc = glGetUniformLocation(m_shader, str.c_str());
-        glUniform3f(functionsLoc, functions[i][0], functions[i][1], functions[i][2]);
+    // Texture: the placeholder stays bound until the real one has streamed in
+    int texture = m_materialTextures[materialIndex];
+    glBindTexture(GL_TEXTURE_2D, m_textures.texture(texture));
+    glUniform1i(glGetUniformLocation(program, "materialTexture"), 0);
+    glUniform1i(glGetUniformLocation(program, "useTexture"), m_textures.isResident(texture));
+    glUniform1f(glGetUniformLocation(program, "blend"), material.blend);
+    glUniform2f(glGetUniformLocation(program, "textureRepeat"), material.textureMap.repeatU, material.textureMap.repeatV);
+
+    // Bump map on unit 2, after the shadow atlas on unit 1
+    int bumpMap = m_materialBumpMaps[materialIndex];
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, m_textures.texture(bumpMap));
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "bumpTexture"), 2);
+    glUniform1i(glGetUniformLocation(program, "useBump"), m_textures.isResident(bumpMap));
+    glUniform2f(glGetUniformLocation(program, "bumpRepeat"), material.bumpMap.repeatU, material.bumpMap.repeatV);
+
+    // Lights: only the ones selected for this shape, packed into the front of each array
+    int first = shapeID * MAX_LIGHTS_PER_DRAW;
+    int numLights = m_shapeLightCounts[shapeID];
+
+    GLint drawTypes[MAX_LIGHTS_PER_DRAW];
+    glm::vec4 drawPos[MAX_LIGHTS_PER_DRAW];
+    glm::vec4 drawColors[MAX_LIGHTS_PER_DRAW];
+    glm::vec4 drawDirs[MAX_LIGHTS_PER_DRAW];
+    glm::vec3 drawFunctions[MAX_LIGHTS_PER_DRAW];
+    float drawAngles[MAX_LIGHTS_PER_DRAW];
+    float drawPenumbras[MAX_LIGHTS_PER_DRAW];
+    GLint drawShadows[MAX_LIGHTS_PER_DRAW];
+    for (int j = 0; j < numLights; j++) {
+        int i = m_shapeLights[first + j];
+        drawTypes[j] = lightTypes[i];
+        drawPos[j] = lightPos[i];
+        drawColors[j] = lightColors[i];
+        drawDirs[j] = lightDirs[i];
+        drawFunctions[j] = functions[i];
+        drawAngles[j] = angles[i];
+        drawPenumbras[j] = penumbras[i];
+        drawShadows[j] = settings.shadows ? m_shadowAtlas.lightTile(i) : -1;
+    }
 
-        str =  "angles[" + std::to_string(i) + "]";
-        GLint anglesLoc = glGetUniformLocation(m_shader, str.c_str());
-        glUniform1f(anglesLoc, angles[i]);
+    GLint numLightsLoc = glGetUniformLocation(program, "numLights");
+    glUniform1i(numLightsLoc, numLights);
 
-        str =  "penumbras[" + std::to_string(i) + "]";
-        GLint penumbrasLoc = glGetUniformLocation(m_shader, str.c_str());
-        glUniform1f(penumbrasLoc, penumbras[i]);
+    if (numLights > 0) {
+        glUniform1iv(glGetUniformLocation(program, "lightTypes"), numLights, drawTypes);
+        glUniform4fv(glGetUniformLocation(program, "lightPos"), numLights, &drawPos[0][0]);
+        glUniform4fv(glGetUniformLocation(program, "lightColors"), numLights, &drawColors[0][0]);
+        glUniform4fv(glGetUniformLocation(program, "lightDirs"), numLights, &drawDirs[0][0]);
+        glUniform3fv(glGetUniformLocation(program, "functions"), numLights, &drawFunctions[0][0]);
+        glUniform1fv(glGetUniformLocation(program, "angles"), numLights, drawAngles);
+        glUniform1fv(glGetUniformLocation(program, "penumbras"), numLights, drawPenumbras);
+        glUniform1iv(glGetUniformLocation(program, "lightShadows"), numLights, drawShadows);
     }
 
-    glDrawArrays(GL_TRIANGLES, 0, verts.size() / 6);
+    int instances = bindInstances(item.templateIndex);
+    if (patched) {
+        glDrawArraysInstanced(GL_PATCHES, 0, m_patchVertexCounts[index], instances);
+    } else if (index >= 0) {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, m_shapeVertexCounts[index], instances);
+    } else {
+        drawMesh(shapeID, mesh, instances, true);
+    }
 
     glBindVertexArray(0);
     glUseProgram(0);
@@ -285,16 +971,148 @@ void Realtime::draw(RenderShapeData shape) {
 
 void Realtime::paintGL() {
     // Students: anything requiring OpenGL calls every frame should be done here
-    glViewport(0, 0, m_width*  m_devicePixelRatio, m_height * m_devicePixelRatio);
+    int outputWidth = m_width * m_devicePixelRatio;
+    int outputHeight = m_height * m_devicePixelRatio;
+
+    // Dynamic resolution renders the scene at a fraction of the output size, picked from the
+    // GPU time of recent frames, and lets the post-process chain upscale it
+    float scale = 1.f;
+    if (settings.dynamicResolution) {
+        m_dynamicResolution.update(m_profiler.latestFrameMs(), settings.frameBudgetMs);
+        scale = m_dynamicResolution.scale();
+    } else {
+        m_dynamicResolution.reset();
+    }
+    // The governor trades tessellation for time; re-tessellate whenever it changes level. With
+    // dynamic resolution on, resolution owns the budget: the governor only lowers quality once
+    // the scale has bottomed out and only raises it again once the scale is back at full.
+    if (settings.adaptiveQuality) {
+        bool mayLower = !settings.dynamicResolution || scale <= DynamicResolution::MIN_SCALE;
+        bool mayRaise = !settings.dynamicResolution || scale >= DynamicResolution::MAX_SCALE;
+        if (m_qualityGovernor.update(m_profiler.latestFrameMs(), settings.frameBudgetMs, mayLower, mayRaise)) {
+            setUpShapes();
+        }
+    } else if (m_qualityGovernor.level() < 1.f) {
+        m_qualityGovernor.reset();
+        setUpShapes();
+    }
+
+    int viewportWidth = std::max(1, int(outputWidth * scale));
+    int viewportHeight = std::max(1, int(outputHeight * scale));
+
+    // Whatever is bound on entry is the final target: the widget's framebuffer, or the
+    // capture FBO in saveViewportImage(). With filters on or at reduced resolution, the
+    // scene goes offscreen first.
+    GLint outputFbo;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outputFbo);
+    PostProcess::Options post;
+    post.perPixel = settings.perPixelFilter;
+    post.kernel = settings.kernelBasedFilter;
+    RenderTarget *sceneTarget = nullptr;
+    if (m_postProcess.hasPasses(post) || viewportWidth != outputWidth || viewportHeight != outputHeight) {
+        sceneTarget = m_postProcess.acquire(viewportWidth, viewportHeight, true);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneTarget->fbo);
+    }
+
+    glViewport(0, 0, viewportWidth, viewportHeight);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear buffers
 
+    // Moved nodes may change the lights a shape uses, and with them the shader it needs
+    updateSceneLoad();
+    if (!sceneData.hierarchy.dirty.empty()) {
+        updateTransforms();
+    }
+    // A mesh that just became resident has real bounds, so its lights and shadows change
+    if (m_meshes.update()) {
+        selectShapeLights();
+    }
+
+    // Pick up any shader variants that finished compiling since the last frame
+    requestSceneShader();
+    m_shaderBuilder.poll();
+    m_program = m_shaderBuilder.get(m_sceneShader, m_shader);
+    m_tessProgram = settings.hardwareTessellation
+                        ? m_shaderBuilder.get(m_sceneTessShader, m_shaderBuilder.get(m_tessShader, 0))
+                        : 0;
+
+    // Upload textures decoded since the last frame, within the per-frame and VRAM budgets
+    m_textures.update(size_t(settings.textureBudgetMB) * 1024 * 1024);
+
+    GLuint depthProgram = m_shaderBuilder.get(m_depthShader, 0);
+    GLuint tessDepthProgram = settings.hardwareTessellation ? m_shaderBuilder.get(m_tessDepthShader, 0) : 0;
+
+    if (m_instancesDirty) {
+        uploadInstances();
+    }
+
+    // Shadow tiles are cached; update() only re-renders the ones whose light or casters changed.
+    // Their casters' tessellation must not depend on the camera, or a cached tile would not match.
+    if (settings.shadows && depthProgram != 0) {
+        m_profiler.begin("shadow maps");
+        setUpShadowTessellationUniforms();
+        std::vector<GLuint> depthPrograms = {depthProgram};
+        if (tessDepthProgram != 0) {
+            depthPrograms.push_back(tessDepthProgram);
+        }
+        m_shadowAtlas.update(sceneData.lights, m_shapeBounds, m_shapeKeys, camera.getData(),
+                             camera.getAspectRatio(), settings.nearPlane, settings.farPlane, depthPrograms,
+                             [&](int i) { drawDepth(i, depthProgram, false); });
+        m_profiler.end();
+    }
+
+    // From here on tessellation levels follow the camera, the same in the pre-pass and shading pass
+    setUpTessellationUniforms(viewportHeight);
+    setUpShadowUniforms(m_program);
+    if (m_tessProgram != 0) {
+        setUpShadowUniforms(m_tessProgram);
+    }
+
+    // Large meshes only submit the clusters that can be seen this frame
+    cullMeshlets(viewportHeight);
+
+    // Optional depth pre-pass: lay down the nearest depth with color writes off, then shade
+    // with GL_EQUAL so the lighting loop runs once per visible pixel instead of per layer
+    bool prepass = settings.depthPrepass && depthProgram != 0;
+    if (prepass) {
+        m_profiler.begin("depth pre-pass");
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        for (GLuint program : {tessDepthProgram, depthProgram}) {
+            if (program == 0) {
+                continue;
+            }
+            glUseProgram(program);
+            GLint viewLoc = glGetUniformLocation(program, "view");
+            glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &camera.getViewMatrix()[0][0]);
+            GLint projLoc = glGetUniformLocation(program, "proj");
+            glUniformMatrix4fv(projLoc, 1, GL_FALSE, &camera.getProjMatrix()[0][0]);
+        }
+        for (size_t i = 0; i < m_drawItems.size(); i++) {
+            drawDepth(i, depthProgram, true);
+        }
+        glBindVertexArray(0);
+        glUseProgram(0);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+        m_profiler.end();
+    }
+
     // Draw scene objects
-    for (RenderShapeData &shape : sceneData.shapes) {
-        draw(shape);
+    m_profiler.begin("shading pass");
+    for (int i = 0; i < m_drawItems.size(); i++) {
+        draw(m_drawItems[i], i);
     }
+    m_profiler.end();
 
-    glViewport(0, 0, m_width*  m_devicePixelRatio, m_height * m_devicePixelRatio);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (prepass) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    if (sceneTarget != nullptr) {
+        m_postProcess.run(sceneTarget, post, outputFbo, outputWidth, outputHeight, m_profiler);
+    }
+    m_profiler.endFrame(settings.gpuProfiler);
 }
 
 
@@ -312,21 +1130,19 @@ void Realtime::sceneChanged() {
     sceneLoaded = true;
     update(); // asks for a PaintGL() call to occur
 
-    // Reload the scene data
-    setUpLights(settings.sceneFilePath, sceneData);
-
-    // Update the camera data based on the scene's camera settings
-    SceneCameraData cData = sceneData.cameraData;
-    camera = Camera(cData, m_width, m_height);
-
-//    // Trigger a redraw
-//    update();
+    // Load the scene data in the background; the camera follows the scene when it is swapped in
+    loadScene(settings.sceneFilePath);
 }
 
 void Realtime::settingsChanged() {
     if (initialized) {
-        setUpLights(settings.sceneFilePath, sceneData); // Update lights
-        setUpShapes();
+        // Re-tessellating also invalidates every cached shadow tile, so only settings that change
+        // the shapes' tessellation trigger it
+        if (m_qualityGovernor.apply(settings.shapeParameter1) != m_shapeParam1
+            || m_qualityGovernor.apply(settings.shapeParameter2) != m_shapeParam2
+            || settings.hardwareTessellation != m_shapesPatched) {
+            setUpShapes();
+        }
         update(); // asks for a PaintGL() call to occur
     }
 }
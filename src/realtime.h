@@ -2,14 +2,26 @@
 
 // Defined before including GLEW to suppress deprecation messages on macOS
 #include "utils/sceneparser.h"
+#include "utils/sceneloader.h"
+#include "utils/shaderbuilder.h"
+#include "utils/gpuprofiler.h"
+#include "utils/bounds.h"
+#include "utils/qualitygovernor.h"
+#include "shadows/shadowatlas.h"
+#include "textures/texturecache.h"
+#include "meshes/meshbuffers.h"
+#include "postprocess/postprocess.h"
+#include "postprocess/dynamicresolution.h"
 #ifdef __APPLE__
 #define GL_SILENCE_DEPRECATION
 #endif
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <memory>
 #include <unordered_map>
 #include <QElapsedTimer>
+#include <QFileSystemWatcher>
 #include <QOpenGLWidget>
 #include <QTime>
 #include <QTimer>
@@ -22,6 +34,8 @@ public:
     void sceneChanged();
     void settingsChanged();
     void saveViewportImage(std::string filePath);
+    void moveNode(int node, const glm::mat4 &local);
+    SceneLoader &sceneLoader() { return m_sceneLoader; }
 
 public slots:
     void tick(QTimerEvent* event);                      // Called once per tick of m_timer
@@ -54,7 +68,24 @@ private:
     int m_width;
     int m_height;
 
-    GLuint m_shader;
+    GLuint m_shader;                                    // Generic program, always valid once initialized
+    GLuint m_program;                                   // Program used for the current frame
+    ShaderBuilder m_shaderBuilder;                      // Builds specialized variants in the background
+    int m_sceneShader = -1;                             // Handle of the variant for the loaded scene
+    int m_sceneShaderLights = -1;                       // Light count m_sceneShader was specialized for
+    int m_depthShader = -1;                             // Position-only program for the depth pre-pass
+
+    // Hardware tessellation of the curved shapes: the same three programs with tessellation
+    // stages, drawing the patches of shapes/patches.h instead of the CPU tessellation
+    int m_tessShader = -1;                              // Generic, like m_shader but built in the background
+    int m_sceneTessShader = -1;                         // Specialized like m_sceneShader, once the mode is used
+    int m_sceneTessShaderLights = -1;
+    int m_tessDepthShader = -1;
+    GLuint m_tessProgram = 0;                           // For the current frame, 0 until one is built
+    static constexpr float TESS_PIXELS_PER_SEGMENT = 8.f;   // Target edge segment length on screen
+    static constexpr float SHADOW_TESS_SEGMENTS_PER_UNIT = 32.f;    // Of shadow casters, in world space
+
+    GpuProfiler m_profiler;
 
     float m_ka;
     float m_kd;
@@ -67,13 +98,107 @@ private:
     std::vector<glm::vec3> functions;
     std::vector<float> angles;
     std::vector<float> penumbras;
-
-    std::vector<std::vector<float>> vertsList;
+    std::vector<float> m_lightRadii;                    // Attenuation radius of each light
+
+    // One draw call: a shape of sceneData.shapes, or a template shape drawn once per instance
+    struct DrawItem {
+        const RenderShapes *shapes;                     // sceneData.shapes or a template's shapes
+        uint32_t shape;                                 // Index into shapes
+        int templateIndex;                              // -1 outside any template
+    };
+    std::vector<DrawItem> m_drawItems;                  // sceneData.shapes, then every template's shapes
+
+    // Lights chosen for item i are the first m_shapeLightCounts[i] of its MAX_LIGHTS_PER_DRAW
+    // slots in m_shapeLights; fixed slots let one item's lights change without moving the rest
+    std::vector<int> m_shapeLights;
+    std::vector<int> m_shapeLightCounts;
+    int m_maxShapeLights = 0;
+    std::vector<AABB> m_shapeBounds;                    // World bounds of each item, over all its instances
+    std::vector<float> m_shapeScales;                   // Largest scale of each item's transforms, over the same
+    std::vector<uint64_t> m_shapeKeys;                  // Hash of each item's primitive and transforms
+
+    std::vector<std::vector<glm::mat4>> m_templateInstances;    // Instance CTMs of each template
+    std::vector<GLuint> m_instanceBuffers;              // Same, uploaded as per-instance attributes
+    bool m_instancesDirty = false;
+
+    ShadowAtlas m_shadowAtlas;
+
+    TextureCache m_textures;
+    std::vector<int> m_materialTextures;                // Texture cache handle of each material, or -1
+    std::vector<int> m_materialBumpMaps;                // Same for the bump maps
+
+    MeshBuffers m_meshes;
+    std::vector<int> m_meshHandles;                     // Mesh buffer handle of each of sceneData.meshfiles
+
+    // Level of detail each mesh item draws this frame: the coarsest whose error covers at most
+    // LOD_PIXEL_ERROR pixels on screen
+    static constexpr float LOD_PIXEL_ERROR = 1.f;
+    std::vector<uint32_t> m_itemLods;
+
+    // Index ranges of the meshlets of each mesh item that survived culling this frame: item i's
+    // are [m_itemRuns[i], m_itemRuns[i + 1]) of the arrays below, as glMultiDrawElements() takes them
+    std::vector<uint32_t> m_itemRuns;
+    std::vector<uint32_t> m_runFirsts;
+    std::vector<uint32_t> m_runCounts;
+    std::vector<GLsizei> m_drawCounts;
+    std::vector<const void *> m_drawOffsets;
+
+    PostProcess m_postProcess;                          // Per-pixel and kernel-based filters
+    DynamicResolution m_dynamicResolution;              // Scene render scale when enabled
+    QualityGovernor m_qualityGovernor;                  // Tessellation below the sliders when enabled
+
+    std::vector<GLsizei> m_shapeVertexCounts = std::vector<GLsizei>(4, 0);  // Vertices in each of vbos
+    std::vector<GLuint> m_patchVaos = std::vector<GLuint>(4, 0);           // Patches of each shape, none for the cube
+    std::vector<GLuint> m_patchVbos = std::vector<GLuint>(4, 0);
+    std::vector<GLsizei> m_patchVertexCounts = std::vector<GLsizei>(4, 0);
+    int m_shapeParam1 = 0;                              // Parameters the shapes were last tessellated with
+    int m_shapeParam2 = 0;
+    bool m_shapesPatched = false;                       // Whether that left the curved shapes to the GPU
     bool sceneLoaded = false;
 
+    // Scenes load in the background, and edits to the loaded scenefile are patched in
+    SceneLoader m_sceneLoader;
+    std::string m_loadPath;                             // Of the load in flight, or the last one
+    bool m_loadIsReload = false;
+    QFileSystemWatcher m_sceneWatcher;
+
+    // A loaded scene whose instance buffers are uploaded a slice per frame before it is swapped in
+    static constexpr size_t STAGING_BYTES_PER_FRAME = 8 * 1024 * 1024;
+    std::unique_ptr<RenderData> m_stagedScene;
+    std::vector<std::vector<glm::mat4>> m_stagedInstances;
+    std::vector<GLuint> m_stagedBuffers;
+    size_t m_stagedTemplate = 0;                        // Next template to upload
+    size_t m_stagedOffset = 0;                          // Bytes of it uploaded so far
+
     bool initialized = false;
 
-    void draw(RenderShapeData shape);
+    void draw(const DrawItem &item, int shapeID);
+    void drawDepth(size_t i, GLuint program, bool culled);
+    void drawMesh(size_t i, int mesh, int instances, bool culled);
+    void cullMeshlets(int viewportHeight);
+    int bindInstances(int templateIndex);
+    void uploadInstances();
     void setUpShapes();
-    void setUpLights(std::string filepath, RenderData &renderData);
+    void setUpPatches();
+    bool isPatched(int index) const;
+    void setUpLightArrays();
+    void setUpInstances();
+    void requestSceneShader();
+    void selectShapeLights();
+    void refreshItem(size_t i);
+    void updateTransforms();
+    void loadScene(const std::string &filepath, bool reload = false);
+    void watchScene(const std::string &filepath);
+    void reloadScene(const QString &path);
+    void updateSceneLoad();
+    void applyReload(RenderData &next);
+    void stageScene(std::unique_ptr<RenderData> scene);
+    void uploadStagedScene();
+    void setUpTextures();
+    void setUpMeshes();
+    AABB localBounds(const DrawItem &item) const;
+    int meshHandle(const DrawItem &item) const;
+    void setUpShadowUniforms(GLuint program);
+    void setUpTessellationUniforms(int viewportHeight);
+    void setUpShadowTessellationUniforms();
 };
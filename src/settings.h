@@ -11,6 +11,14 @@ struct Settings {
     float farPlane = 1;
     bool perPixelFilter = false;
     bool kernelBasedFilter = false;
+    bool depthPrepass = false;
+    bool shadows = false;
+    bool dynamicResolution = false;
+    bool adaptiveQuality = false;          // Lower tessellation below the sliders when over budget
+    bool hardwareTessellation = false;     // Refine spheres, cylinders and cones in tessellation shaders
+    float frameBudgetMs = 1000.f / 60.f;   // GPU time per frame the adaptive modes aim to stay under
+    bool gpuProfiler = false;
+    int textureBudgetMB = 256;
     bool extraCredit1 = false;
     bool extraCredit2 = false;
     bool extraCredit3 = false;
@@ -0,0 +1,276 @@
+#include "shadowatlas.h"
+#include "utils/lightselection.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+// FNV-1a over raw bytes, good enough to notice any change in a tile's inputs
+static void hashBytes(uint64_t &hash, const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+static glm::vec3 lightUp(const glm::vec3 &dir) {
+    return std::abs(dir.y) > 0.99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+}
+
+void ShadowAtlas::initialize() {
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, ATLAS_SIZE, ATLAS_SIZE, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Hardware depth comparison gives 2x2 PCF per tap through sampler2DShadow
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Error: shadow atlas framebuffer is not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    invalidate();
+}
+
+void ShadowAtlas::finish() {
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteTextures(1, &m_texture);
+    m_fbo = 0;
+    m_texture = 0;
+}
+
+void ShadowAtlas::invalidate() {
+    for (Tile &tile : m_tiles) {
+        tile.valid = false;
+    }
+}
+
+int ShadowAtlas::lightTile(int light) const {
+    return light >= 0 && light < static_cast<int>(m_lightTiles.size()) ? m_lightTiles[light] : -1;
+}
+
+glm::vec4 ShadowAtlas::tileRect(int tile) const {
+    int tilesPerRow = ATLAS_SIZE / TILE_SIZE;
+    float scale = float(TILE_SIZE) / ATLAS_SIZE;
+    return glm::vec4((tile % tilesPerRow) * scale, (tile / tilesPerRow) * scale, scale, scale);
+}
+
+// Fits one orthographic map per slice of the camera frustum. The light view is anchored at
+// the world origin and each slice's bounds are snapped to whole texels, so the matrices (and
+// with them the tile hashes) only change when the camera moves by more than a texel.
+void ShadowAtlas::fitCascades(const SceneLightData &light, const AABB &sceneBounds,
+                              const SceneCameraData &cameraData, float aspect,
+                              float nearPlane, float farPlane, glm::mat4 *viewProjs) {
+    glm::vec3 dir = glm::normalize(glm::vec3(light.dir));
+    glm::mat4 view = glm::lookAt(-dir, glm::vec3(0.f), lightUp(dir));
+
+    // Depth range covers the whole scene so casters outside the camera frustum still cast
+    float minZ = std::numeric_limits<float>::max();
+    float maxZ = -std::numeric_limits<float>::max();
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 p((corner & 1) ? sceneBounds.max.x : sceneBounds.min.x,
+                    (corner & 2) ? sceneBounds.max.y : sceneBounds.min.y,
+                    (corner & 4) ? sceneBounds.max.z : sceneBounds.min.z);
+        float z = (view * glm::vec4(p, 1.f)).z;
+        minZ = std::min(minZ, z);
+        maxZ = std::max(maxZ, z);
+    }
+
+    // Camera basis, matching Camera::getViewMatrix()
+    glm::vec3 w = -glm::normalize(glm::vec3(cameraData.look));
+    glm::vec3 v = glm::normalize(glm::vec3(cameraData.up) - glm::dot(glm::vec3(cameraData.up), w) * w);
+    glm::vec3 u = glm::cross(v, w);
+    glm::vec3 eye = glm::vec3(cameraData.pos);
+    float tanHalfHeight = std::tan(cameraData.heightAngle / 2.f);
+
+    // Practical split scheme: blend of logarithmic and uniform splits
+    const float lambda = 0.75f;
+    float splits[SHADOW_CASCADES + 1];
+    for (int i = 0; i <= SHADOW_CASCADES; i++) {
+        float t = float(i) / SHADOW_CASCADES;
+        float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+        float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+        splits[i] = lambda * logSplit + (1.f - lambda) * uniformSplit;
+    }
+
+    for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++) {
+        m_cascadeEnds[cascade] = splits[cascade + 1];
+
+        glm::vec3 corners[8];
+        glm::vec3 center(0.f);
+        for (int i = 0; i < 8; i++) {
+            float d = splits[cascade + (i & 1)];
+            float halfHeight = d * tanHalfHeight;
+            float halfWidth = halfHeight * aspect;
+            corners[i] = eye - w * d
+                         + u * ((i & 2) ? halfWidth : -halfWidth)
+                         + v * ((i & 4) ? halfHeight : -halfHeight);
+            center += corners[i] / 8.f;
+        }
+
+        // Bounding sphere keeps the footprint constant under camera rotation
+        float radius = 0.f;
+        for (const glm::vec3 &corner : corners) {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+        radius = std::ceil(radius * 16.f) / 16.f;
+
+        float texel = 2.f * radius / TILE_SIZE;
+        glm::vec3 lightCenter = glm::vec3(view * glm::vec4(center, 1.f));
+        lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+        lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+
+        glm::mat4 proj = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+                                    lightCenter.y - radius, lightCenter.y + radius,
+                                    -maxZ, -minZ);
+        viewProjs[cascade] = proj * view;
+    }
+}
+
+glm::mat4 ShadowAtlas::fitSpot(const SceneLightData &light, float radius, const AABB &sceneBounds) {
+    glm::vec3 pos = glm::vec3(light.pos);
+    glm::vec3 dir = glm::normalize(glm::vec3(light.dir));
+    glm::mat4 view = glm::lookAt(pos, pos + dir, lightUp(dir));
+
+    // Far plane: the light's reach, but no further than the scene extends
+    float sceneReach = 0.f;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 p((corner & 1) ? sceneBounds.max.x : sceneBounds.min.x,
+                    (corner & 2) ? sceneBounds.max.y : sceneBounds.min.y,
+                    (corner & 4) ? sceneBounds.max.z : sceneBounds.min.z);
+        sceneReach = std::max(sceneReach, glm::length(p - pos));
+    }
+    float farPlane = std::max(std::min(radius, sceneReach), 0.1f);
+    float nearPlane = std::max(0.05f, farPlane * 0.001f);
+
+    float fov = std::min(2.f * light.angle, glm::radians(170.f));
+    return glm::perspective(fov, 1.f, nearPlane, farPlane) * view;
+}
+
+int ShadowAtlas::update(const std::vector<SceneLightData> &lights, const std::vector<AABB> &shapeBounds,
+                        const std::vector<uint64_t> &shapeKeys,
+                        const SceneCameraData &cameraData, float aspect, float nearPlane, float farPlane,
+                        const std::vector<GLuint> &depthPrograms, const DrawShape &drawShape) {
+    AABB sceneBounds;
+    for (const AABB &bounds : shapeBounds) {
+        sceneBounds.expand(bounds);
+    }
+    if (sceneBounds.isEmpty()) {
+        sceneBounds = unitPrimitiveBounds();
+    }
+
+    // Assign tiles in scene order until the atlas is full
+    glm::mat4 viewProjs[SHADOW_MAX_TILES];
+    int usedTiles = 0;
+    m_lightTiles.assign(lights.size(), -1);
+    for (size_t i = 0; i < lights.size(); i++) {
+        const SceneLightData &light = lights[i];
+        if (light.type == LightType::LIGHT_DIRECTIONAL && usedTiles + SHADOW_CASCADES <= SHADOW_MAX_TILES) {
+            m_lightTiles[i] = usedTiles;
+            fitCascades(light, sceneBounds, cameraData, aspect, nearPlane, farPlane, &viewProjs[usedTiles]);
+            usedTiles += SHADOW_CASCADES;
+        } else if (light.type == LightType::LIGHT_SPOT && usedTiles < SHADOW_MAX_TILES) {
+            m_lightTiles[i] = usedTiles;
+            viewProjs[usedTiles] = fitSpot(light, LightSelection::attenuationRadius(light), sceneBounds);
+            usedTiles += 1;
+        }
+    }
+
+    // Bias maps clip space [-1,1] to tile-local [0,1]
+    glm::mat4 bias = glm::translate(glm::mat4(1.f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.f), glm::vec3(0.5f));
+    m_tileMatrices.resize(usedTiles);
+    m_tileRects.resize(usedTiles);
+
+    GLint previousFbo = 0;
+    GLint previousViewport[4];
+    bool bound = false;
+    int rendered = 0;
+    std::vector<int> visible;
+
+    for (int t = 0; t < usedTiles; t++) {
+        m_tileMatrices[t] = bias * viewProjs[t];
+        m_tileRects[t] = tileRect(t);
+
+        // The tile's contents depend on its matrix and on every shape its frustum touches
+        Frustum frustum = frustumFromMatrix(viewProjs[t]);
+        visible.clear();
+        uint64_t hash = 14695981039346656037ull;
+        hashBytes(hash, &t, sizeof(t));
+        hashBytes(hash, &viewProjs[t][0][0], sizeof(glm::mat4));
+        for (size_t s = 0; s < shapeBounds.size(); s++) {
+            if (!intersects(frustum, shapeBounds[s])) {
+                continue;
+            }
+            visible.push_back(s);
+            hashBytes(hash, &s, sizeof(s));
+            hashBytes(hash, &shapeKeys[s], sizeof(shapeKeys[s]));
+        }
+
+        Tile &tile = m_tiles[t];
+        if (tile.valid && tile.hash == hash) {
+            continue;
+        }
+        tile.valid = true;
+        tile.hash = hash;
+        tile.viewProj = viewProjs[t];
+
+        if (!bound) {
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+            glGetIntegerv(GL_VIEWPORT, previousViewport);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+            glEnable(GL_SCISSOR_TEST);
+            // Slope-scaled bias against shadow acne
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(2.f, 4.f);
+            glm::mat4 identity(1.f);
+            for (GLuint program : depthPrograms) {
+                glUseProgram(program);
+                glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, &identity[0][0]);
+            }
+            bound = true;
+        }
+
+        glm::vec4 rect = m_tileRects[t] * float(ATLAS_SIZE);
+        glViewport(rect.x, rect.y, TILE_SIZE, TILE_SIZE);
+        glScissor(rect.x, rect.y, TILE_SIZE, TILE_SIZE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        for (GLuint program : depthPrograms) {
+            glUseProgram(program);
+            glUniformMatrix4fv(glGetUniformLocation(program, "proj"), 1, GL_FALSE, &viewProjs[t][0][0]);
+        }
+        glUseProgram(depthPrograms.front());
+        for (int s : visible) {
+            drawShape(s);
+        }
+        rendered++;
+    }
+
+    if (bound) {
+        glBindVertexArray(0);
+        glUseProgram(0);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+
+    return rendered;
+}
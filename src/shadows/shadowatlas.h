@@ -0,0 +1,84 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "utils/bounds.h"
+#include "utils/sceneparser.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Must match the sizes of the shadow arrays in default.frag
+constexpr int SHADOW_CASCADES = 3;
+constexpr int SHADOW_MAX_TILES = 16;
+
+// Depth atlas holding the shadow maps of every directional light (as SHADOW_CASCADES cascades
+// fit to slices of the camera frustum) and spot light (one perspective map). Each tile keeps a
+// hash of its light matrix and of the shapes inside its frustum, and is only re-rendered when
+// that hash changes, so a static scene seen from a static camera renders no shadow maps at all
+// after the first frame.
+class ShadowAtlas
+{
+public:
+    // Called to draw item i depth-only; the atlas has already set view/proj on the programs
+    using DrawShape = std::function<void(int)>;
+
+    void initialize();
+    void finish();
+
+    // Forces every tile to re-render on the next update (geometry or scene changed)
+    void invalidate();
+
+    // Assigns tiles to lights and re-renders the tiles whose contents changed. Draw item i
+    // covers shapeBounds[i] in world space, and shapeKeys[i] changes whenever what it draws
+    // does (its primitive or any of its transforms). Every program of depthPrograms gets each
+    // tile's view/proj before its shapes are drawn, and the first is bound when drawShape is
+    // called. Returns the number of tiles drawn.
+    int update(const std::vector<SceneLightData> &lights, const std::vector<AABB> &shapeBounds,
+               const std::vector<uint64_t> &shapeKeys,
+               const SceneCameraData &cameraData, float aspect, float nearPlane, float farPlane,
+               const std::vector<GLuint> &depthPrograms, const DrawShape &drawShape);
+
+    // First tile of light i (SHADOW_CASCADES consecutive tiles for directional lights), or -1
+    int lightTile(int light) const;
+
+    GLuint texture() const { return m_texture; }
+
+    // World to tile-local [0,1]^3 matrices, and the atlas rect (offset.xy, scale.zw) of each tile
+    const std::vector<glm::mat4> &tileMatrices() const { return m_tileMatrices; }
+    const std::vector<glm::vec4> &tileRects() const { return m_tileRects; }
+
+    // Camera-space depth where each cascade ends
+    glm::vec4 cascadeEnds() const { return m_cascadeEnds; }
+
+private:
+    struct Tile {
+        glm::mat4 viewProj;
+        uint64_t hash = 0;
+        bool valid = false;
+    };
+
+    void fitCascades(const SceneLightData &light, const AABB &sceneBounds,
+                     const SceneCameraData &cameraData, float aspect,
+                     float nearPlane, float farPlane, glm::mat4 *viewProjs);
+    glm::mat4 fitSpot(const SceneLightData &light, float radius, const AABB &sceneBounds);
+    glm::vec4 tileRect(int tile) const;
+
+    static constexpr int ATLAS_SIZE = 4096;
+    static constexpr int TILE_SIZE = 1024;
+
+    GLuint m_texture = 0;
+    GLuint m_fbo = 0;
+
+    Tile m_tiles[SHADOW_MAX_TILES];
+    std::vector<int> m_lightTiles;
+    std::vector<glm::mat4> m_tileMatrices;
+    std::vector<glm::vec4> m_tileRects;
+    glm::vec4 m_cascadeEnds = glm::vec4(0.f);
+};
@@ -0,0 +1,145 @@
+#include "angletable.h"
+
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Cephes-style reduction: angles are taken modulo pi/4 in three steps so the remainder keeps
+// full precision, then evaluated with minimax polynomials on [-pi/4, pi/4]
+constexpr float FOUR_OVER_PI = 1.27323954473516f;
+constexpr float REDUCE_1 = 0.78515625f;
+constexpr float REDUCE_2 = 2.4187564849853515625e-4f;
+constexpr float REDUCE_3 = 3.77489497744594108e-8f;
+
+constexpr float SIN_0 = -1.9515295891e-4f;
+constexpr float SIN_1 = 8.3321608736e-3f;
+constexpr float SIN_2 = -1.6666654611e-1f;
+constexpr float COS_0 = 2.443315711809948e-5f;
+constexpr float COS_1 = -1.388731625493765e-3f;
+constexpr float COS_2 = 4.166664568298827e-2f;
+
+#if defined(__AVX2__)
+
+constexpr size_t LANES = 8;
+
+void sincosBatch(const float *angles, float *sines, float *cosines) {
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+    __m256 x = _mm256_loadu_ps(angles);
+    __m256 sinSign = _mm256_and_ps(x, signMask);
+    x = _mm256_andnot_ps(signMask, x);
+
+    // Octant, rounded up to even so the remainder lands in [-pi/4, pi/4]
+    __m256i octant = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(FOUR_OVER_PI)));
+    octant = _mm256_and_si256(_mm256_add_epi32(octant, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+    __m256 y = _mm256_cvtepi32_ps(octant);
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(REDUCE_1)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(REDUCE_2)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(REDUCE_3)));
+
+    // Octants 2 and 6 swap the polynomials; 4 to 7 negate sine, 2 to 5 negate cosine
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+        _mm256_and_si256(octant, _mm256_set1_epi32(2)), _mm256_set1_epi32(2)));
+    sinSign = _mm256_xor_ps(sinSign, _mm256_castsi256_ps(
+        _mm256_slli_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(4)), 29)));
+    __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_andnot_si256(_mm256_sub_epi32(octant, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COS_0), z), _mm256_set1_ps(COS_1));
+    c = _mm256_add_ps(_mm256_mul_ps(c, z), _mm256_set1_ps(COS_2));
+    c = _mm256_mul_ps(_mm256_mul_ps(c, z), z);
+    c = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(z, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.f));
+    __m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN_0), z), _mm256_set1_ps(SIN_1));
+    s = _mm256_add_ps(_mm256_mul_ps(s, z), _mm256_set1_ps(SIN_2));
+    s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, z), x), x);
+
+    __m256 sine = _mm256_blendv_ps(s, c, swap);
+    __m256 cosine = _mm256_blendv_ps(c, s, swap);
+    _mm256_storeu_ps(sines, _mm256_xor_ps(sine, sinSign));
+    _mm256_storeu_ps(cosines, _mm256_xor_ps(cosine, cosSign));
+}
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+constexpr size_t LANES = 4;
+
+void sincosBatch(const float *angles, float *sines, float *cosines) {
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    __m128 x = _mm_loadu_ps(angles);
+    __m128 sinSign = _mm_and_ps(x, signMask);
+    x = _mm_andnot_ps(signMask, x);
+
+    // Octant, rounded up to even so the remainder lands in [-pi/4, pi/4]
+    __m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FOUR_OVER_PI)));
+    octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(octant);
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(REDUCE_1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(REDUCE_2)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(REDUCE_3)));
+
+    // Octants 2 and 6 swap the polynomials; 4 to 7 negate sine, 2 to 5 negate cosine
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+    sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29)));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(
+        _mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_0), z), _mm_set1_ps(COS_1));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(COS_2));
+    c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+    c = _mm_add_ps(_mm_sub_ps(c, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.f));
+    __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_0), z), _mm_set1_ps(SIN_1));
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(SIN_2));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+
+    // SSE2 has no blend, so the swap selects with masks
+    __m128 sine = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    __m128 cosine = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    _mm_storeu_ps(sines, _mm_xor_ps(sine, sinSign));
+    _mm_storeu_ps(cosines, _mm_xor_ps(cosine, cosSign));
+}
+
+#else
+
+constexpr size_t LANES = 1;
+
+void sincosBatch(const float *angles, float *sines, float *cosines) {
+    *sines = std::sin(*angles);
+    *cosines = std::cos(*angles);
+}
+
+#endif
+
+}
+
+void AngleTable::sincos(const float *angles, size_t count, float *sines, float *cosines) {
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        sincosBatch(angles + i, sines + i, cosines + i);
+    }
+
+    // The tail goes through a padded batch so every angle takes the same path
+    if (i < count) {
+        float in[LANES] = {}, outSin[LANES], outCos[LANES];
+        for (size_t j = i; j < count; j++) {
+            in[j - i] = angles[j];
+        }
+        sincosBatch(in, outSin, outCos);
+        for (size_t j = i; j < count; j++) {
+            sines[j] = outSin[j - i];
+            cosines[j] = outCos[j - i];
+        }
+    }
+}
+
+AngleTable::AngleTable(int steps, float range)
+    : angles(steps + 1), sines(steps + 1), cosines(steps + 1) {
+    for (int i = 1; i <= steps; i++) {
+        angles[i] = range * i / steps;
+    }
+    sincos(angles.data(), angles.size(), sines.data(), cosines.data());
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Sines and cosines of steps + 1 evenly spaced angles from 0 to range inclusive. The shape
+// generators build these once per parameter set and read every vertex's trigonometry from
+// them, instead of calling sin and cos again for each tile that shares an angle.
+struct AngleTable
+{
+    AngleTable() = default;
+    AngleTable(int steps, float range);
+
+    std::vector<float> angles;
+    std::vector<float> sines;
+    std::vector<float> cosines;
+
+    // Writes the sine and cosine of each of count angles. Vectorized with AVX2 or SSE2 when the
+    // compiler targets them, with a scalar fallback elsewhere; accurate to a few ulps for the
+    // angles tessellation uses.
+    static void sincos(const float *angles, size_t count, float *sines, float *cosines);
+};
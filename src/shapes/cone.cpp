@@ -1,21 +1,31 @@
 #include "Cone.h"
 
+#include "glm/ext/scalar_constants.hpp"
+
+#include <algorithm>
+#include <vector>
+
 void Cone::updateParams(int param1, int param2) {
-    m_vertexData = std::vector<float>();
-    m_param1 = param1;
-    m_param2 = param2;
-    setVertexData();
+    m_param1 = std::max(param1, 1);
+    m_param2 = std::max(param2, 3);
+    m_circle = AngleTable(m_param2, 2.f * glm::pi<float>());
 }
 
-void Cone::setVertexData() {
-    m_param1 = std::max(m_param1, 1);
-    m_param2 = std::max(m_param2, 3);
+// The surface is m_param1 quads per segment plus a tip triangle; the base is a fan of
+// m_param2 triangles in the middle and m_param1 - 1 rings of quads around it
+size_t Cone::vertexCount() const {
+    size_t surface = size_t(m_param2) * (m_param1 * 6 + 3);
+    size_t base = size_t(m_param2) * (3 + (m_param1 - 1) * 6);
+    return surface + base;
+}
 
-    makeConeSurface();
-    makeConeBase();
+void Cone::generateShape(std::span<float> out) const {
+    VertexWriter writer(out);
+    makeConeSurface(writer);
+    makeConeBase(writer);
 }
 
-void Cone::makeConeSurface() {
+void Cone::makeConeSurface(VertexWriter &out) const {
     glm::vec3 apex(0.0f, 0.5f, 0.0f); // Apex of the cone
     float radius = 0.5f;              // Base radius
     float height = 1.0f;              // Height of the cone
@@ -23,24 +33,31 @@ void Cone::makeConeSurface() {
     // Slope vector for the implicit cone
     float slope = radius / height;
 
-    // Precompute base vertices and normals for all segments
-    std::vector<glm::vec3> baseVertices(m_param2);
-    std::vector<glm::vec3> baseNormals(m_param2);
-
+    // Base vertex and packed frame of each segment boundary, read from the shared angle table.
+    // The tangent is the direction of increasing u around the cone; it is perpendicular to the
+    // slanted normal.
+    std::vector<glm::vec3> bases(m_param2);
+    std::vector<glm::vec4> frames(m_param2);
     for (int i = 0; i < m_param2; ++i) {
-        float angle = 2.0f * M_PI * i / m_param2;
-        baseVertices[i] = glm::vec3(radius * cos(angle), -0.5f, radius * sin(angle));
-        baseNormals[i] = glm::normalize(glm::vec3(baseVertices[i].x, slope, baseVertices[i].z));
+        float cosAngle = m_circle.cosines[i];
+        float sinAngle = m_circle.sines[i];
+        bases[i] = glm::vec3(radius * cosAngle, -0.5f, radius * sinAngle);
+        glm::vec3 normal = glm::normalize(glm::vec3(bases[i].x, slope, bases[i].z));
+        frames[i] = packTangentFrame(normal, glm::vec3(sinAngle, 0.0f, -cosAngle));
     }
 
     // Loop over the circular base subdivisions
     for (int i = 0; i < m_param2; ++i) {
         int nextIndex = (i + 1) % m_param2; // Wrap around at the end
 
-        glm::vec3 base1 = baseVertices[i];
-        glm::vec3 base2 = baseVertices[nextIndex];
-        glm::vec3 normal1 = baseNormals[i];
-        glm::vec3 normal2 = baseNormals[nextIndex];
+        glm::vec3 base1 = bases[i];
+        glm::vec3 base2 = bases[nextIndex];
+        glm::vec4 frame1 = frames[i];
+        glm::vec4 frame2 = frames[nextIndex];
+
+        // u is not wrapped, so the last segment runs to u = 0 instead of jumping back to 1
+        float u1 = 1.0f - static_cast<float>(i) / m_param2;
+        float u2 = 1.0f - static_cast<float>(i + 1) / m_param2;
 
         // Loop over vertical subdivisions (latitude tessellation)
         for (int j = 0; j < m_param1; ++j) {
@@ -53,27 +70,16 @@ void Cone::makeConeSurface() {
             glm::vec3 interp3 = glm::mix(base1, apex, t2);
             glm::vec3 interp4 = glm::mix(base2, apex, t2);
 
-            // Use the same normals as the base for the entire vertical subdivision
-            glm::vec3 normalInterp1 = glm::normalize(glm::mix(normal1, normal1, t1));
-            glm::vec3 normalInterp2 = glm::normalize(glm::mix(normal2, normal2, t1));
-            glm::vec3 normalInterp3 = glm::normalize(glm::mix(normal1, normal1, t2));
-            glm::vec3 normalInterp4 = glm::normalize(glm::mix(normal2, normal2, t2));
-
+            // The same frame as the base is used for the entire vertical subdivision
             // First triangle (interp1 -> interp2 -> interp3)
-            insertVec3(m_vertexData, interp1);
-            insertVec3(m_vertexData, normalInterp1);
-            insertVec3(m_vertexData, interp3);
-            insertVec3(m_vertexData, normalInterp3);
-            insertVec3(m_vertexData, interp2);
-            insertVec3(m_vertexData, normalInterp2);
+            out.vertex(interp1, frame1, glm::vec2(u1, t1));
+            out.vertex(interp3, frame1, glm::vec2(u1, t2));
+            out.vertex(interp2, frame2, glm::vec2(u2, t1));
 
             // Second triangle (interp3 -> interp4 -> interp2)
-            insertVec3(m_vertexData, interp3);
-            insertVec3(m_vertexData, normalInterp3);
-            insertVec3(m_vertexData, interp4);
-            insertVec3(m_vertexData, normalInterp4);
-            insertVec3(m_vertexData, interp2);
-            insertVec3(m_vertexData, normalInterp2);
+            out.vertex(interp3, frame1, glm::vec2(u1, t2));
+            out.vertex(interp4, frame2, glm::vec2(u2, t2));
+            out.vertex(interp2, frame2, glm::vec2(u2, t1));
         }
     }
 
@@ -81,25 +87,29 @@ void Cone::makeConeSurface() {
     for (int i = 0; i < m_param2; ++i) {
         int nextIndex = (i + 1) % m_param2;
 
-        glm::vec3 base1 = baseVertices[i];
-        glm::vec3 base2 = baseVertices[nextIndex];
-        glm::vec3 normal1 = baseNormals[i];
-        glm::vec3 normal2 = baseNormals[nextIndex];
+        float u1 = 1.0f - static_cast<float>(i) / m_param2;
+        float u2 = 1.0f - static_cast<float>(i + 1) / m_param2;
 
         // Tip triangle (apex -> base2 -> base1)
-        insertVec3(m_vertexData, apex);
-        insertVec3(m_vertexData, normal1); // Use the same normal as base1
-        insertVec3(m_vertexData, base2);
-        insertVec3(m_vertexData, normal2);
-        insertVec3(m_vertexData, base1);
-        insertVec3(m_vertexData, normal1);
+        out.vertex(apex, frames[i], glm::vec2(u1, 1.0f)); // Use the same frame as base1
+        out.vertex(bases[nextIndex], frames[nextIndex], glm::vec2(u2, 0.0f));
+        out.vertex(bases[i], frames[i], glm::vec2(u1, 0.0f));
     }
 }
 
-void Cone::makeConeBase() {
+void Cone::makeConeBase(VertexWriter &out) const {
     glm::vec3 center(0.0f, -0.5f, 0.0f); // Center of the base
     float radius = 0.5f;                 // Base radius
     glm::vec3 normal(0.0f, -1.0f, 0.0f); // Normal of the base
+    glm::vec4 frame = packTangentFrame(normal, glm::vec3(1.0f, 0.0f, 0.0f));
+
+    // Planar mapping as seen from below: u along +x, v along +z
+    auto baseVertex = [&](glm::vec3 v) {
+        out.vertex(v, frame, glm::vec2(v.x + 0.5f, v.z + 0.5f));
+    };
+    auto rim = [&](float ringRadius, int i) {
+        return glm::vec3(ringRadius * m_circle.cosines[i], -0.5f, ringRadius * m_circle.sines[i]);
+    };
 
     // Loop over the concentric rings defined by param1
     for (int ring = 0; ring < m_param1; ++ring) {
@@ -108,47 +118,29 @@ void Cone::makeConeBase() {
 
         // Loop to create quads or triangles between the rings
         for (int i = 0; i < m_param2; ++i) {
-            float angle = 2.0f * M_PI * i / m_param2;
-            float nextAngle = 2.0f * M_PI * (i + 1) / m_param2;
-
             // Define vertices on the current and next rings
-            glm::vec3 v1(currentRadius * cos(angle), -0.5f, currentRadius * sin(angle));
-            glm::vec3 v2(nextRadius * cos(angle), -0.5f, nextRadius * sin(angle));
-            glm::vec3 v3(currentRadius * cos(nextAngle), -0.5f, currentRadius * sin(nextAngle));
-            glm::vec3 v4(nextRadius * cos(nextAngle), -0.5f, nextRadius * sin(nextAngle));
+            glm::vec3 v1 = rim(currentRadius, i);
+            glm::vec3 v2 = rim(nextRadius, i);
+            glm::vec3 v3 = rim(currentRadius, i + 1);
+            glm::vec3 v4 = rim(nextRadius, i + 1);
 
             if (ring == 0) {
                 // Centermost triangle fan
-                insertVec3(m_vertexData, center);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v2);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v4);
-                insertVec3(m_vertexData, normal);
+                baseVertex(center);
+                baseVertex(v2);
+                baseVertex(v4);
             } else {
                 // Outer quads split into two triangles
                 // Triangle 1: v1 -> v2 -> v3
-                insertVec3(m_vertexData, v1);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v2);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v3);
-                insertVec3(m_vertexData, normal);
+                baseVertex(v1);
+                baseVertex(v2);
+                baseVertex(v3);
 
                 // Triangle 2: v3 -> v2 -> v4
-                insertVec3(m_vertexData, v3);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v2);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v4);
-                insertVec3(m_vertexData, normal);
+                baseVertex(v3);
+                baseVertex(v2);
+                baseVertex(v4);
             }
         }
     }
 }
-
-void Cone::insertVec3(std::vector<float> &data, glm::vec3 v) {
-    data.push_back(v.x);
-    data.push_back(v.y);
-    data.push_back(v.z);
-}
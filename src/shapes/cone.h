@@ -1,23 +1,30 @@
 #pragma once
 
-#include <vector>
+#include <span>
 #include <glm/glm.hpp>
 
+#include "angletable.h"
+#include "vertexlayout.h"
+
 class Cone
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
 
-private:
-    void insertVec3(std::vector<float> &data, glm::vec3 v);
-    void setVertexData();
+    // Exact number of vertices generateShape() writes for the current parameters
+    size_t vertexCount() const;
+
+    // Writes the tessellation into out, which must hold vertexCount() * VERTEX_FLOATS floats
+    void generateShape(std::span<float> out) const;
 
-    std::vector<float> m_vertexData;
+private:
     int m_param1;
     int m_param2;
     float m_radius = 0.5;
 
-    void makeConeBase();
-    void makeConeSurface();
+    // Segment boundaries around the axis, shared by the surface and the base
+    AngleTable m_circle;
+
+    void makeConeBase(VertexWriter &out) const;
+    void makeConeSurface(VertexWriter &out) const;
 };
@@ -1,35 +1,41 @@
 #include "Cube.h"
 
 void Cube::updateParams(int param1) {
-    m_vertexData = std::vector<float>();
     m_param1 = param1;
-    setVertexData();
 }
 
-void Cube::makeTile(glm::vec3 topLeft,
+// Two triangles per tile, m_param1 by m_param1 tiles per face
+size_t Cube::vertexCount() const {
+    return size_t(m_param1) * m_param1 * 6 * 6;
+}
+
+void Cube::makeTile(VertexWriter &out,
+                    glm::vec3 topLeft,
                     glm::vec3 topRight,
                     glm::vec3 bottomLeft,
-                    glm::vec3 bottomRight) {
+                    glm::vec3 bottomRight,
+                    glm::vec2 uvTopLeft,
+                    glm::vec2 uvBottomRight) const {
     // Task 2: create a tile (i.e. 2 triangles) based on 4 given points.
 
+    // Every face is flat, so the whole tile shares one frame: u runs left to right, v bottom to top
+    glm::vec3 normal = glm::normalize(glm::cross(bottomLeft - topLeft, bottomRight - topLeft));
+    glm::vec3 tangent = glm::normalize(topRight - topLeft);
+    glm::vec2 uvTopRight(uvBottomRight.x, uvTopLeft.y);
+    glm::vec2 uvBottomLeft(uvTopLeft.x, uvBottomRight.y);
+
     // triangle 1
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, glm::normalize(glm::cross(bottomLeft - topLeft, bottomRight - topLeft)));
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, glm::normalize(glm::cross(bottomRight - bottomLeft, topLeft - bottomLeft)));
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, glm::normalize(glm::cross(topLeft - bottomRight, bottomLeft - bottomRight)));
+    out.vertex(topLeft, normal, tangent, uvTopLeft);
+    out.vertex(bottomLeft, normal, tangent, uvBottomLeft);
+    out.vertex(bottomRight, normal, tangent, uvBottomRight);
 
     // triangle 2
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, glm::normalize(glm::cross(topRight - bottomRight, topLeft - bottomRight)));
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, glm::normalize(glm::cross(topLeft - topRight, bottomRight - topRight)));
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, glm::normalize(glm::cross(bottomRight - topLeft, topRight - topLeft)));
+    out.vertex(bottomRight, normal, tangent, uvBottomRight);
+    out.vertex(topRight, normal, tangent, uvTopRight);
+    out.vertex(topLeft, normal, tangent, uvTopLeft);
 }
 
-void Cube::makeFace(glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft, glm::vec3 bottomRight) {
+void Cube::makeFace(VertexWriter &out, glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft) const {
     float tileSize = 1.0f / m_param1;
 
     // Calculate direction vectors for rows and columns, adjust these to correct the face orientation
@@ -43,17 +49,22 @@ void Cube::makeFace(glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft,
             glm::vec3 tileBottomLeft = topLeft + colDir * static_cast<float>(row + 1) + rowDir * static_cast<float>(col);
             glm::vec3 tileBottomRight = topLeft + colDir * static_cast<float>(row + 1) + rowDir * static_cast<float>(col + 1);
 
+            glm::vec2 uvTopLeft(col * tileSize, 1.f - row * tileSize);
+            glm::vec2 uvBottomRight((col + 1) * tileSize, 1.f - (row + 1) * tileSize);
+
             // Switch the order of vertices in makeTile to reverse the face orientation
-            makeTile(tileTopLeft, tileTopRight, tileBottomLeft, tileBottomRight);
+            makeTile(out, tileTopLeft, tileTopRight, tileBottomLeft, tileBottomRight, uvTopLeft, uvBottomRight);
         }
     }
 }
 
 
 
-void Cube::setVertexData() {
+void Cube::generateShape(std::span<float> out) const {
     // Task 4: Use the makeFace() function to make all 6 sides of the cube
 
+    VertexWriter writer(out);
+
     glm::vec3 ooo = glm::vec3(-0.5f, -0.5f, -0.5f);
     glm::vec3 ooi = glm::vec3(-0.5f, -0.5f, 0.5f);
     glm::vec3 oio = glm::vec3(-0.5f, 0.5f, -0.5f);
@@ -64,23 +75,15 @@ void Cube::setVertexData() {
     glm::vec3 iii = glm::vec3( 0.5f, 0.5f, 0.5f);
 
     // front face
-    makeFace(oii, iii, ooi, ioi);
+    makeFace(writer, oii, iii, ooi);
     // right face
-    makeFace(iii, iio, ioi, ioo);
+    makeFace(writer, iii, iio, ioi);
     // back face
-    makeFace(iio, oio, ioo, ooo);
+    makeFace(writer, iio, oio, ioo);
     // left face
-    makeFace(oio, oii, ooo, ooi);
+    makeFace(writer, oio, oii, ooo);
     // top face
-    makeFace(oio, iio, oii, iii);
+    makeFace(writer, oio, iio, oii);
     // back face
-    makeFace(ooi, ioi, ooo, ioo);
-}
-
-// Inserts a glm::vec3 into a vector of floats.
-// This will come in handy if you want to take advantage of vectors to build your shape!
-void Cube::insertVec3(std::vector<float> &data, glm::vec3 v) {
-    data.push_back(v.x);
-    data.push_back(v.y);
-    data.push_back(v.z);
+    makeFace(writer, ooi, ioi, ooo);
 }
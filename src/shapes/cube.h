@@ -1,26 +1,33 @@
 #pragma once
 
-#include <vector>
+#include <span>
 #include <glm/glm.hpp>
 
+#include "vertexlayout.h"
+
 class Cube
 {
 public:
     void updateParams(int param1);
-    std::vector<float> generateShape() { return m_vertexData; }
+
+    // Exact number of vertices generateShape() writes for the current parameters
+    size_t vertexCount() const;
+
+    // Writes the tessellation into out, which must hold vertexCount() * VERTEX_FLOATS floats
+    void generateShape(std::span<float> out) const;
 
 private:
-    void insertVec3(std::vector<float> &data, glm::vec3 v);
-    void setVertexData();
-    void makeTile(glm::vec3 topLeft,
+    void makeTile(VertexWriter &out,
+                  glm::vec3 topLeft,
                   glm::vec3 topRight,
                   glm::vec3 bottomLeft,
-                  glm::vec3 bottomRight);
-    void makeFace(glm::vec3 topLeft,
+                  glm::vec3 bottomRight,
+                  glm::vec2 uvTopLeft,
+                  glm::vec2 uvBottomRight) const;
+    void makeFace(VertexWriter &out,
+                  glm::vec3 topLeft,
                   glm::vec3 topRight,
-                  glm::vec3 bottomLeft,
-                  glm::vec3 bottomRight);
+                  glm::vec3 bottomLeft) const;
 
-    std::vector<float> m_vertexData;
     int m_param1;
 };
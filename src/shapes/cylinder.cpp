@@ -1,104 +1,107 @@
 #include "Cylinder.h"
 
+#include "glm/ext/scalar_constants.hpp"
+
+#include <algorithm>
+
 void Cylinder::updateParams(int param1, int param2) {
-    m_vertexData = std::vector<float>();
-    m_param1 = param1;
-    m_param2 = param2;
-    setVertexData();
+    // ensure that the tessellation parameters are not too low
+    m_param1 = std::max(param1, 1);
+    m_param2 = std::max(param2, 3);
+    m_circle = AngleTable(m_param2, 2.f * glm::pi<float>());
 }
 
-void Cylinder::setVertexData() {
-    // TODO for Project 5: Lights, Camera
-    // ensure that the tessellation parameters are not too low
-    m_param1 = std::max(m_param1, 1);
-    m_param2 = std::max(m_param2, 3);
+// The sides are m_param1 quads per segment; each cap is a fan of m_param2 triangles in the
+// middle and m_param1 - 1 rings of quads around it
+size_t Cylinder::vertexCount() const {
+    size_t sides = size_t(m_param2) * m_param1 * 6;
+    size_t cap = size_t(m_param2) * (3 + (m_param1 - 1) * 6);
+    return sides + 2 * cap;
+}
+
+void Cylinder::generateShape(std::span<float> out) const {
+    VertexWriter writer(out);
 
     // generate the sides
-    makeSides();
+    makeSides(writer);
 
     // generate the top and bottom caps
-    makeCap(glm::vec3(0.0f, 0.5f, 0.0f), true);  // Top cap
-    makeCap(glm::vec3(0.0f, -0.5f, 0.0f), false); // Bottom cap
-}
-
-// Inserts a glm::vec3 into a vector of floats.
-// This will come in handy if you want to take advantage of vectors to build your shape!
-void Cylinder::insertVec3(std::vector<float> &data, glm::vec3 v) {
-    data.push_back(v.x);
-    data.push_back(v.y);
-    data.push_back(v.z);
+    makeCap(writer, glm::vec3(0.0f, 0.5f, 0.0f), true);  // Top cap
+    makeCap(writer, glm::vec3(0.0f, -0.5f, 0.0f), false); // Bottom cap
 }
 
-void Cylinder::makeSides() {
+void Cylinder::makeSides(VertexWriter &out) const {
     float radius = 0.5f;
     float height = 1.0f;
 
     for (int i = 0; i < m_param2; ++i) {
-        float angle = 2.0f * M_PI * i / m_param2;
-        float nextAngle = 2.0f * M_PI * (i + 1) / m_param2;
+        float cos1 = m_circle.cosines[i];
+        float sin1 = m_circle.sines[i];
+        float cos2 = m_circle.cosines[i + 1];
+        float sin2 = m_circle.sines[i + 1];
+
+        // u wraps once around the side (decreasing with angle so the texture reads left to right
+        // from outside), v runs from the bottom edge to the top edge
+        float u = 1.0f - static_cast<float>(i) / m_param2;
+        float nextU = 1.0f - static_cast<float>(i + 1) / m_param2;
+
+        // The frames only change between segments, so each edge's is packed once for its column
+        glm::vec4 frame1 = packTangentFrame(glm::vec3(cos1, 0, sin1), glm::vec3(sin1, 0, -cos1));
+        glm::vec4 frame2 = packTangentFrame(glm::vec3(cos2, 0, sin2), glm::vec3(sin2, 0, -cos2));
 
         for (int j = 0; j < m_param1; ++j) {
             float y = -0.5f + height * j / m_param1;
             float nextY = -0.5f + height * (j + 1) / m_param1;
 
             // vertices
-            glm::vec3 v1(radius * cos(angle), y, radius * sin(angle));
-            glm::vec3 v2(radius * cos(nextAngle), y, radius * sin(nextAngle));
-            glm::vec3 v3(radius * cos(angle), nextY, radius * sin(angle));
-            glm::vec3 v4(radius * cos(nextAngle), nextY, radius * sin(nextAngle));
-
-            // calculate normals
-            glm::vec3 normal1 = glm::normalize(glm::vec3(cos(angle), 0, sin(angle)));
-            glm::vec3 normal2 = glm::normalize(glm::vec3(cos(nextAngle), 0, sin(nextAngle)));
+            glm::vec3 v1(radius * cos1, y, radius * sin1);
+            glm::vec3 v2(radius * cos2, y, radius * sin2);
+            glm::vec3 v3(radius * cos1, nextY, radius * sin1);
+            glm::vec3 v4(radius * cos2, nextY, radius * sin2);
 
             // first triangle
-            insertVec3(m_vertexData, v1);
-            insertVec3(m_vertexData, normal1);
-            insertVec3(m_vertexData, v3);
-            insertVec3(m_vertexData, normal1);
-            insertVec3(m_vertexData, v2);
-            insertVec3(m_vertexData, normal2);
+            out.vertex(v1, frame1, glm::vec2(u, y + 0.5f));
+            out.vertex(v3, frame1, glm::vec2(u, nextY + 0.5f));
+            out.vertex(v2, frame2, glm::vec2(nextU, y + 0.5f));
 
             // second triangle
-            insertVec3(m_vertexData, v3);
-            insertVec3(m_vertexData, normal1);
-            insertVec3(m_vertexData, v4);
-            insertVec3(m_vertexData, normal2);
-            insertVec3(m_vertexData, v2);
-            insertVec3(m_vertexData, normal2);
+            out.vertex(v3, frame1, glm::vec2(u, nextY + 0.5f));
+            out.vertex(v4, frame2, glm::vec2(nextU, nextY + 0.5f));
+            out.vertex(v2, frame2, glm::vec2(nextU, y + 0.5f));
         }
     }
 }
 
-void Cylinder::makeCap(const glm::vec3& center, bool isTopCap) {
+void Cylinder::makeCap(VertexWriter &out, const glm::vec3& center, bool isTopCap) const {
     float radius = 0.5f;
     glm::vec3 normal = isTopCap ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec4 frame = packTangentFrame(normal, glm::vec3(1.0f, 0.0f, 0.0f));
+
+    // Planar mapping as seen from outside the cap: u along +x, v along -z on top and +z below
+    auto capVertex = [&](glm::vec3 v) {
+        glm::vec2 uv(v.x + 0.5f, isTopCap ? 0.5f - v.z : v.z + 0.5f);
+        out.vertex(v, frame, uv);
+    };
+    auto rim = [&](float ringRadius, int i) {
+        return glm::vec3(ringRadius * m_circle.cosines[i], 0, ringRadius * m_circle.sines[i]);
+    };
 
     // For param1 = 1, create a single triangle fan from the center
     if (m_param1 == 1) {
         for (int i = 0; i < m_param2; ++i) {
-            float angle = 2.0f * M_PI * i / m_param2;
-            float nextAngle = 2.0f * M_PI * (i + 1) / m_param2;
-
-            glm::vec3 v1 = center + glm::vec3(radius * cos(angle), 0, radius * sin(angle));
-            glm::vec3 v2 = center + glm::vec3(radius * cos(nextAngle), 0, radius * sin(nextAngle));
+            glm::vec3 v1 = center + rim(radius, i);
+            glm::vec3 v2 = center + rim(radius, i + 1);
 
             if (isTopCap) {
                 // Top center triangle
-                insertVec3(m_vertexData, center);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v2);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v1);
-                insertVec3(m_vertexData, normal);
+                capVertex(center);
+                capVertex(v2);
+                capVertex(v1);
             } else {
                 // Bottom center triangle
-                insertVec3(m_vertexData, center);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v1);
-                insertVec3(m_vertexData, normal);
-                insertVec3(m_vertexData, v2);
-                insertVec3(m_vertexData, normal);
+                capVertex(center);
+                capVertex(v1);
+                capVertex(v2);
             }
         }
     } else {
@@ -107,71 +110,50 @@ void Cylinder::makeCap(const glm::vec3& center, bool isTopCap) {
             float nextRadius = radius * (ring + 1) / m_param1;
 
             for (int i = 0; i < m_param2; ++i) {
-                float angle = 2.0f * M_PI * i / m_param2;
-                float nextAngle = 2.0f * M_PI * (i + 1) / m_param2;
-
                 // Define vertices of the quad on the cap
-                glm::vec3 v1 = center + glm::vec3(currentRadius * cos(angle), 0, currentRadius * sin(angle));
-                glm::vec3 v2 = center + glm::vec3(nextRadius * cos(angle), 0, nextRadius * sin(angle));
-                glm::vec3 v3 = center + glm::vec3(currentRadius * cos(nextAngle), 0, currentRadius * sin(nextAngle));
-                glm::vec3 v4 = center + glm::vec3(nextRadius * cos(nextAngle), 0, nextRadius * sin(nextAngle));
+                glm::vec3 v1 = center + rim(currentRadius, i);
+                glm::vec3 v2 = center + rim(nextRadius, i);
+                glm::vec3 v3 = center + rim(currentRadius, i + 1);
+                glm::vec3 v4 = center + rim(nextRadius, i + 1);
 
                 if (isTopCap) {
                     // Top cap triangles (counter-clockwise from above)
                     if (ring == 0) {
-                        glm::vec3 v1 = center + glm::vec3(nextRadius * cos(angle), 0, nextRadius * sin(angle));
-                        glm::vec3 v2 = center + glm::vec3(nextRadius * cos(nextAngle), 0, nextRadius * sin(nextAngle));
-
-                        insertVec3(m_vertexData, center);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v2);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v1);
-                        insertVec3(m_vertexData, normal);
+                        glm::vec3 v1 = center + rim(nextRadius, i);
+                        glm::vec3 v2 = center + rim(nextRadius, i + 1);
+
+                        capVertex(center);
+                        capVertex(v2);
+                        capVertex(v1);
                     } else {
                         // Outer triangles
-                        insertVec3(m_vertexData, v2);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v1);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v4);
-                        insertVec3(m_vertexData, normal);
-
-                        insertVec3(m_vertexData, v4);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v1);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v3);
-                        insertVec3(m_vertexData, normal);
+                        capVertex(v2);
+                        capVertex(v1);
+                        capVertex(v4);
+
+                        capVertex(v4);
+                        capVertex(v1);
+                        capVertex(v3);
                     }
                 } else {
                     // Bottom cap triangles (counter-clockwise from below)
                     if (ring == 0) {
                         // Centermost triangle
-                        glm::vec3 v1 = center + glm::vec3(nextRadius * cos(angle), 0, nextRadius * sin(angle));
-                        glm::vec3 v2 = center + glm::vec3(nextRadius * cos(nextAngle), 0, nextRadius * sin(nextAngle));
-
-                        insertVec3(m_vertexData, center);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v1);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v2);
-                        insertVec3(m_vertexData, normal);
+                        glm::vec3 v1 = center + rim(nextRadius, i);
+                        glm::vec3 v2 = center + rim(nextRadius, i + 1);
+
+                        capVertex(center);
+                        capVertex(v1);
+                        capVertex(v2);
                     } else {
                         // Outer triangles
-                        insertVec3(m_vertexData, v1);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v2);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v4);
-                        insertVec3(m_vertexData, normal);
-
-                        insertVec3(m_vertexData, v1);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v4);
-                        insertVec3(m_vertexData, normal);
-                        insertVec3(m_vertexData, v3);
-                        insertVec3(m_vertexData, normal);
+                        capVertex(v1);
+                        capVertex(v2);
+                        capVertex(v4);
+
+                        capVertex(v1);
+                        capVertex(v4);
+                        capVertex(v3);
                     }
                 }
             }
@@ -0,0 +1,97 @@
+#include "patches.h"
+#include "angletable.h"
+
+#include <glm/glm.hpp>
+#include "glm/ext/scalar_constants.hpp"
+
+namespace {
+
+struct Corner {
+    glm::vec3 position;
+    float angle;
+    float along;
+};
+
+// Appends the patch spanning corners low and high in angle (first index) and along the surface
+// (second). The patch's u runs against the angle, as texture u does around the curved surfaces,
+// and its v with along, except where either would leave the domain with the wrong handedness
+// for a surface's outward normal: on the top cap u runs with the angle, and on the sphere v
+// runs against phi, which grows southward.
+void addPatch(std::vector<float> &out, Patches::Surface surface, const Corner corners[2][2]) {
+    bool uWithAngle = surface == Patches::SURFACE_CYLINDER_TOP;
+    bool vWithAlong = surface != Patches::SURFACE_SPHERE;
+    int a0 = uWithAngle ? 0 : 1;
+    int b0 = vWithAlong ? 0 : 1;
+    const Corner *ordered[Patches::PATCH_VERTICES] = {&corners[a0][b0], &corners[1 - a0][b0],
+                                                      &corners[1 - a0][1 - b0], &corners[a0][1 - b0]};
+    for (const Corner *corner : ordered) {
+        out.insert(out.end(), {corner->position.x, corner->position.y, corner->position.z,
+                               corner->angle, corner->along, float(surface)});
+    }
+}
+
+// A ring of patches around the y axis, from along = 0 to along = 1, with position(i, along)
+// placing the corner at segment boundary i
+template <typename Position>
+void addRing(std::vector<float> &out, Patches::Surface surface, const AngleTable &circle, Position position) {
+    for (int i = 0; i < Patches::SEGMENTS; i++) {
+        const Corner corners[2][2] = {
+            {{position(i, 0.f), circle.angles[i], 0.f}, {position(i, 1.f), circle.angles[i], 1.f}},
+            {{position(i + 1, 0.f), circle.angles[i + 1], 0.f}, {position(i + 1, 1.f), circle.angles[i + 1], 1.f}}};
+        addPatch(out, surface, corners);
+    }
+}
+
+AngleTable circleTable() {
+    return AngleTable(Patches::SEGMENTS, 2.f * glm::pi<float>());
+}
+
+}
+
+std::vector<float> Patches::sphere() {
+    AngleTable theta = circleTable();
+    AngleTable phi(SPHERE_ROWS, glm::pi<float>());
+    auto position = [&](int i, int j) {
+        return 0.5f * glm::vec3(phi.sines[j] * theta.cosines[i], phi.cosines[j], phi.sines[j] * theta.sines[i]);
+    };
+
+    std::vector<float> out;
+    for (int j = 0; j < SPHERE_ROWS; j++) {
+        for (int i = 0; i < SEGMENTS; i++) {
+            const Corner corners[2][2] = {
+                {{position(i, j), theta.angles[i], phi.angles[j]}, {position(i, j + 1), theta.angles[i], phi.angles[j + 1]}},
+                {{position(i + 1, j), theta.angles[i + 1], phi.angles[j]},
+                 {position(i + 1, j + 1), theta.angles[i + 1], phi.angles[j + 1]}}};
+            addPatch(out, SURFACE_SPHERE, corners);
+        }
+    }
+    return out;
+}
+
+// The side's bottom and top edges and the caps' rims are computed the same way, so the levels
+// the control shader picks for them, and with them the vertices along them, agree
+std::vector<float> Patches::cylinder() {
+    AngleTable circle = circleTable();
+    auto rim = [&](int i, float radius, float y) {
+        return glm::vec3(0.5f * radius * circle.cosines[i], y, 0.5f * radius * circle.sines[i]);
+    };
+
+    std::vector<float> out;
+    addRing(out, SURFACE_CYLINDER_SIDE, circle, [&](int i, float along) { return rim(i, 1.f, along - 0.5f); });
+    addRing(out, SURFACE_CYLINDER_TOP, circle, [&](int i, float along) { return rim(i, along, 0.5f); });
+    addRing(out, SURFACE_CYLINDER_BOTTOM, circle, [&](int i, float along) { return rim(i, along, -0.5f); });
+    return out;
+}
+
+std::vector<float> Patches::cone() {
+    AngleTable circle = circleTable();
+    auto rim = [&](int i, float radius) {
+        return glm::vec3(0.5f * radius * circle.cosines[i], -0.5f, 0.5f * radius * circle.sines[i]);
+    };
+
+    std::vector<float> out;
+    addRing(out, SURFACE_CONE_SIDE, circle,
+            [&](int i, float along) { return along == 0.f ? rim(i, 1.f) : glm::vec3(0.f, 0.5f, 0.f); });
+    addRing(out, SURFACE_CONE_BASE, circle, [&](int i, float along) { return rim(i, along); });
+    return out;
+}
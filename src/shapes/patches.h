@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+// Coarse quad patches over the curved primitives, for the hardware tessellation path. Each
+// corner carries its exact object-space position, which the control shader measures on screen
+// to pick the edge levels, and the surface coordinates the evaluation shader interpolates and
+// evaluates exactly (resources/shaders/tessellation.tese). Patches never change, so detail is
+// adapted per draw on the GPU without re-tessellating on the CPU.
+namespace Patches {
+
+// Per corner: position (3), angle around the y axis, coordinate along the surface, surface id
+constexpr int PATCH_FLOATS = 6;
+constexpr int PATCH_VERTICES = 4;
+
+// Patches around the axis and, for the sphere, from pole to pole. Each edge can be split into
+// at most GL_MAX_TESS_GEN_LEVEL (64 or more) segments, which bounds the finest detail.
+constexpr int SEGMENTS = 8;
+constexpr int SPHERE_ROWS = 4;
+
+// Surfaces the evaluation shader knows, numbered as it expects. Along the surface is phi for
+// the sphere, y + 0.5 for the cylinder side, the fraction of the way to the apex for the cone
+// side, and the fraction of the radius for caps.
+enum Surface {
+    SURFACE_SPHERE,
+    SURFACE_CYLINDER_SIDE,
+    SURFACE_CYLINDER_TOP,
+    SURFACE_CYLINDER_BOTTOM,
+    SURFACE_CONE_SIDE,
+    SURFACE_CONE_BASE
+};
+
+// Patches of each primitive, PATCH_VERTICES corners of PATCH_FLOATS each, wound so that the
+// evaluation shader's counter-clockwise triangles face outward
+std::vector<float> sphere();
+std::vector<float> cylinder();
+std::vector<float> cone();
+
+}
@@ -1,78 +1,113 @@
 #include "Sphere.h"
 #include "glm/ext/scalar_constants.hpp"
 
+#include <utility>
+#include <vector>
+
 void Sphere::updateParams(int param1, int param2) {
-    m_vertexData = std::vector<float>();
     m_param1 = param1;
     m_param2 = param2;
-    setVertexData();
+
+    // Every vertex sits on one of these angles, so their trigonometry is done once here
+    m_theta = AngleTable(m_param2, 2.f * glm::pi<float>());
+    m_phi = AngleTable(m_param1, glm::pi<float>());
+    m_halfTheta = AngleTable(m_param2, glm::pi<float>());
+    m_halfPhi = AngleTable(m_param1, glm::half_pi<float>());
+}
+
+// Two triangles per tile, m_param1 tiles per wedge and m_param2 wedges
+size_t Sphere::vertexCount() const {
+    return size_t(m_param1) * m_param2 * 6;
 }
 
-void Sphere::makeTile(glm::vec3 topLeft,
-                      glm::vec3 topRight,
-                      glm::vec3 bottomLeft,
-                      glm::vec3 bottomRight) {
-    // Task 5: Implement the makeTile() function for a Sphere
-    // Note: this function is very similar to the makeTile() function for Cube,
-    //       but the normals are calculated in a different way!
+void Sphere::makeTile(VertexWriter &out,
+                      const float *topLeft,
+                      const float *topRight,
+                      const float *bottomLeft,
+                      const float *bottomRight) const {
     // Triangle 1
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, glm::normalize(topLeft));
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, glm::normalize(bottomLeft));
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, glm::normalize(bottomRight));
+    out.vertex(topLeft);
+    out.vertex(bottomLeft);
+    out.vertex(bottomRight);
 
     // Triangle 2
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, glm::normalize(bottomRight));
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, glm::normalize(topRight));
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, glm::normalize(topLeft));
+    out.vertex(bottomRight);
+    out.vertex(topRight);
+    out.vertex(topLeft);
 }
 
-void Sphere::makeWedge(float currentTheta, float nextTheta) {
-    float phiStep = glm::pi<float>() / m_param1;
-    for (int segment = 0; segment < m_param1; ++segment) {
-        float currentPhi = segment * phiStep;
-        float nextPhi = (segment + 1) * phiStep;
+// Lays out the m_param1 + 1 vertices at theta index column, from the north pole down. The
+// frame is analytic: the normal is the radial direction and the tangent follows increasing u,
+// i.e. decreasing theta. u wraps once around the equator and v runs from the south pole (0) to
+// the north pole (1).
+//
+// That frame is a rotation by -theta about y of the frame at theta = 0, which is itself the
+// fixed frame q0 = (-1, 1, 1, 1) / 2 turned by phi about its own x axis, so its quaternion is
+// qy(-theta) * q0 * qx(phi) and comes straight from the half-angle tables without quat_cast.
+void Sphere::makeColumn(float *out, int column) const {
+    float sinTheta = m_theta.sines[column];
+    float cosTheta = m_theta.cosines[column];
+    float sinHalfTheta = m_halfTheta.sines[column];
+    float cosHalfTheta = m_halfTheta.cosines[column];
+    float u = 1.f - m_theta.angles[column] / (2.f * glm::pi<float>());
 
-        glm::vec3 topRight = glm::vec3(0.5f * sin(currentPhi) * cos(currentTheta), 0.5f * cos(currentPhi), 0.5f * sin(currentPhi) * sin(currentTheta));
-        glm::vec3 topLeft = glm::vec3(0.5f * sin(currentPhi) * cos(nextTheta), 0.5f * cos(currentPhi), 0.5f * sin(currentPhi) * sin(nextTheta));
-        glm::vec3 bottomRight = glm::vec3(0.5f * sin(nextPhi) * cos(currentTheta), 0.5f * cos(nextPhi), 0.5f * sin(nextPhi) * sin(currentTheta));
-        glm::vec3 bottomLeft = glm::vec3(0.5f * sin(nextPhi) * cos(nextTheta), 0.5f * cos(nextPhi), 0.5f * sin(nextPhi) * sin(nextTheta));
+    for (int row = 0; row <= m_param1; ++row, out += VERTEX_FLOATS) {
+        float sinPhi = m_phi.sines[row];
+        float cosPhi = m_phi.cosines[row];
 
-        makeTile(topLeft, topRight, bottomLeft, bottomRight);
-    }
-}
+        glm::vec3 normal(sinPhi * cosTheta, cosPhi, sinPhi * sinTheta);
+        out[0] = m_radius * normal.x;
+        out[1] = m_radius * normal.y;
+        out[2] = m_radius * normal.z;
 
-void Sphere::makeSphere() {
-    float thetaStep = 2 * glm::pi<float>() / m_param2;
-    for (int wedge = 0; wedge < m_param2; ++wedge) {
-        float currentTheta = wedge * thetaStep;
-        float nextTheta = (wedge + 1) * thetaStep;
-        makeWedge(currentTheta, nextTheta);
+        // q0 * qx(phi) is (sum, -difference, sum, difference) in (w, x, y, z); qy(-theta) times
+        // that, kept with w non-negative like packTangentFrame
+        float sum = 0.5f * (m_halfPhi.cosines[row] + m_halfPhi.sines[row]);
+        float difference = 0.5f * (m_halfPhi.cosines[row] - m_halfPhi.sines[row]);
+        float plus = cosHalfTheta + sinHalfTheta;
+        float minus = cosHalfTheta - sinHalfTheta;
+        glm::vec4 frame(-plus * difference, minus * sum, minus * difference, plus * sum);
+        if (frame.w < 0.f) {
+            frame = -frame;
+        }
+        out[VERTEX_FRAME_OFFSET] = frame.x;
+        out[VERTEX_FRAME_OFFSET + 1] = frame.y;
+        out[VERTEX_FRAME_OFFSET + 2] = frame.z;
+        out[VERTEX_FRAME_OFFSET + 3] = frame.w;
+
+        out[VERTEX_UV_OFFSET] = u;
+        out[VERTEX_UV_OFFSET + 1] = 1.f - m_phi.angles[row] / glm::pi<float>();
     }
 }
 
-void Sphere::setVertexData() {
-    // Uncomment these lines to make a wedge for Task 6, then comment them out for Task 7:
+void Sphere::makeWedge(VertexWriter &out, const float *currentColumn, const float *nextColumn) const {
+    for (int segment = 0; segment < m_param1; ++segment) {
+        const float *topRight = currentColumn + segment * VERTEX_FLOATS;
+        const float *topLeft = nextColumn + segment * VERTEX_FLOATS;
+        const float *bottomRight = topRight + VERTEX_FLOATS;
+        const float *bottomLeft = topLeft + VERTEX_FLOATS;
 
-    //     float thetaStep = glm::radians(360.f / m_param2);
-    //     float currentTheta = 0 * thetaStep;
-    //     float nextTheta = 1 * thetaStep;
-    //     makeWedge(currentTheta, nextTheta);
+        makeTile(out, topLeft, topRight, bottomLeft, bottomRight);
+    }
+}
 
-    // Uncomment these lines to make sphere for Task 7:
+// Each grid column is laid out once and shared by the two wedges either side of it, so the
+// wedges themselves only copy vertices
+void Sphere::makeSphere(VertexWriter &out) const {
+    size_t columnFloats = size_t(m_param1 + 1) * VERTEX_FLOATS;
+    std::vector<float> columns(2 * columnFloats);
+    float *currentColumn = columns.data();
+    float *nextColumn = currentColumn + columnFloats;
 
-    makeSphere();
+    makeColumn(currentColumn, 0);
+    for (int wedge = 0; wedge < m_param2; ++wedge) {
+        makeColumn(nextColumn, wedge + 1);
+        makeWedge(out, currentColumn, nextColumn);
+        std::swap(currentColumn, nextColumn);
+    }
 }
 
-// Inserts a glm::vec3 into a vector of floats.
-// This will come in handy if you want to take advantage of vectors to build your shape!
-void Sphere::insertVec3(std::vector<float> &data, glm::vec3 v) {
-    data.push_back(v.x);
-    data.push_back(v.y);
-    data.push_back(v.z);
+void Sphere::generateShape(std::span<float> out) const {
+    VertexWriter writer(out);
+    makeSphere(writer);
 }
@@ -1,26 +1,41 @@
 #pragma once
 
-#include <vector>
+#include <span>
 #include <glm/glm.hpp>
 
+#include "angletable.h"
+#include "vertexlayout.h"
+
 class Sphere
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
+
+    // Exact number of vertices generateShape() writes for the current parameters
+    size_t vertexCount() const;
+
+    // Writes the tessellation into out, which must hold vertexCount() * VERTEX_FLOATS floats
+    void generateShape(std::span<float> out) const;
 
 private:
-    void insertVec3(std::vector<float> &data, glm::vec3 v);
-    void setVertexData();
-    void makeTile(glm::vec3 topLeft,
-                  glm::vec3 topRight,
-                  glm::vec3 bottomLeft,
-                  glm::vec3 bottomRight);
-    void makeWedge(float currTheta, float nextTheta);
-    void makeSphere();
-
-    std::vector<float> m_vertexData;
+    // Tiles copy their corners from the laid-out grid columns either side of the wedge, so
+    // texture coordinates stay continuous across the seam
+    void makeTile(VertexWriter &out,
+                  const float *topLeft,
+                  const float *topRight,
+                  const float *bottomLeft,
+                  const float *bottomRight) const;
+    void makeColumn(float *out, int column) const;
+    void makeWedge(VertexWriter &out, const float *currentColumn, const float *nextColumn) const;
+    void makeSphere(VertexWriter &out) const;
+
     float m_radius = 0.5;
     int m_param1;
     int m_param2;
+
+    // Theta around the equator and phi from pole to pole, and their halves for the frames
+    AngleTable m_theta;
+    AngleTable m_phi;
+    AngleTable m_halfTheta;
+    AngleTable m_halfPhi;
 };
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Interleaved vertex layout written by the shape generators:
+// position (3 floats), tangent frame as a unit quaternion (4), texture coordinate (2).
+// The quaternion rotates +x to the tangent (direction of increasing u) and +z to the normal;
+// the bitangent is cross(normal, tangent), which the generators keep pointing along +v.
+constexpr int VERTEX_FLOATS = 9;
+constexpr int VERTEX_FRAME_OFFSET = 3;
+constexpr int VERTEX_UV_OFFSET = 7;
+
+// Packs an orthonormal normal/tangent pair. q and -q encode the same frame, so w is kept
+// non-negative to stop neighbouring vertices from interpolating through the opposite sign.
+inline glm::vec4 packTangentFrame(glm::vec3 normal, glm::vec3 tangent) {
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+    glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(tangent, bitangent, normal)));
+    if (q.w < 0.f) {
+        q = -q;
+    }
+    return glm::vec4(q.x, q.y, q.z, q.w);
+}
+
+// Writes vertices in this layout one after another into storage the caller owns, such as a
+// mapped GL buffer. The generators size that storage exactly from their vertexCount(), so
+// nothing is allocated or copied on the way.
+class VertexWriter
+{
+public:
+    explicit VertexWriter(std::span<float> out) : m_out(out) {}
+
+    void vertex(glm::vec3 pos, glm::vec3 normal, glm::vec3 tangent, glm::vec2 uv) {
+        vertex(pos, packTangentFrame(normal, tangent), uv);
+    }
+
+    // A vertex whose frame was packed once up front, for generators that share it along a column
+    void vertex(glm::vec3 pos, glm::vec4 frame, glm::vec2 uv) {
+        float *out = m_out.data() + m_written;
+        out[0] = pos.x;
+        out[1] = pos.y;
+        out[2] = pos.z;
+        out[VERTEX_FRAME_OFFSET] = frame.x;
+        out[VERTEX_FRAME_OFFSET + 1] = frame.y;
+        out[VERTEX_FRAME_OFFSET + 2] = frame.z;
+        out[VERTEX_FRAME_OFFSET + 3] = frame.w;
+        out[VERTEX_UV_OFFSET] = uv.x;
+        out[VERTEX_UV_OFFSET + 1] = uv.y;
+        m_written += VERTEX_FLOATS;
+    }
+
+    // A vertex already laid out, copied as is
+    void vertex(const float *laidOut) {
+        std::copy_n(laidOut, VERTEX_FLOATS, m_out.data() + m_written);
+        m_written += VERTEX_FLOATS;
+    }
+
+    // Floats written so far
+    size_t written() const { return m_written; }
+
+private:
+    std::span<float> m_out;
+    size_t m_written = 0;
+};
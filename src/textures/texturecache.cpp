@@ -0,0 +1,240 @@
+#include "texturecache.h"
+
+#include <QImage>
+#include <QString>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// Bytes of decoded pixels copied to the GPU per frame. One image is always uploaded even if it
+// is larger, so a single big texture cannot stall the queue forever.
+static constexpr size_t UPLOAD_BYTES_PER_FRAME = 8 * 1024 * 1024;
+
+void TextureCache::initialize() {
+    unsigned char white[4] = {255, 255, 255, 255};
+    glGenTextures(1, &m_placeholder);
+    glBindTexture(GL_TEXTURE_2D, m_placeholder);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &m_unpackBuffer);
+    m_unpackBufferSize = 0;
+}
+
+void TextureCache::finish() {
+    // Join the workers first so none of them touches m_decoded after it is cleared
+    m_pool.reset();
+    m_decoded.clear();
+
+    for (Entry &entry : m_entries) {
+        if (entry.state == TextureState::TEXTURE_RESIDENT) {
+            glDeleteTextures(1, &entry.texture);
+        }
+    }
+    m_entries.clear();
+    m_handles.clear();
+    m_residentBytes = 0;
+
+    glDeleteTextures(1, &m_placeholder);
+    glDeleteBuffers(1, &m_unpackBuffer);
+    m_placeholder = 0;
+    m_unpackBuffer = 0;
+    m_unpackBufferSize = 0;
+}
+
+int TextureCache::acquire(const std::string &path) {
+    auto found = m_handles.find(path);
+    if (found != m_handles.end()) {
+        return found->second;
+    }
+
+    int handle = m_entries.size();
+    m_entries.push_back({path, TextureState::TEXTURE_LOADING, 0, 0, m_frame});
+    m_handles[path] = handle;
+    startDecode(handle);
+    return handle;
+}
+
+void TextureCache::startDecode(int handle) {
+    if (!m_pool) {
+        m_pool = std::make_unique<ThreadPool>();
+    }
+
+    m_entries[handle].state = TextureState::TEXTURE_LOADING;
+    std::string path = m_entries[handle].path;
+    m_pool->submit([this, handle, path] {
+        DecodedImage image = decode(handle, path);
+        std::lock_guard<std::mutex> lock(m_decodedMutex);
+        m_decoded.push_back(std::move(image));
+    });
+}
+
+// Runs on a worker thread: loads the file, converts it to bottom-up RGBA8 as GL expects,
+// and box-filters it down to 1x1
+TextureCache::DecodedImage TextureCache::decode(int handle, const std::string &path) {
+    DecodedImage image;
+    image.handle = handle;
+    image.ok = false;
+
+    QImage source(QString::fromStdString(path));
+    if (source.isNull()) {
+        return image;
+    }
+    source = source.convertToFormat(QImage::Format_RGBA8888).mirrored();
+
+    int width = source.width();
+    int height = source.height();
+
+    size_t total = 0;
+    for (int w = width, h = height; ; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+        image.levels.push_back({w, h, total});
+        total += size_t(w) * h * 4;
+        if (w == 1 && h == 1) {
+            break;
+        }
+    }
+    image.pixels.resize(total);
+
+    for (int y = 0; y < height; y++) {
+        std::memcpy(&image.pixels[size_t(y) * width * 4], source.constScanLine(y), size_t(width) * 4);
+    }
+
+    for (size_t level = 1; level < image.levels.size(); level++) {
+        const MipLevel &src = image.levels[level - 1];
+        const MipLevel &dst = image.levels[level];
+        const unsigned char *in = &image.pixels[src.offset];
+        unsigned char *out = &image.pixels[dst.offset];
+
+        for (int y = 0; y < dst.height; y++) {
+            int y0 = std::min(2 * y, src.height - 1);
+            int y1 = std::min(2 * y + 1, src.height - 1);
+            for (int x = 0; x < dst.width; x++) {
+                int x0 = std::min(2 * x, src.width - 1);
+                int x1 = std::min(2 * x + 1, src.width - 1);
+                for (int c = 0; c < 4; c++) {
+                    int sum = in[(size_t(y0) * src.width + x0) * 4 + c]
+                            + in[(size_t(y0) * src.width + x1) * 4 + c]
+                            + in[(size_t(y1) * src.width + x0) * 4 + c]
+                            + in[(size_t(y1) * src.width + x1) * 4 + c];
+                    out[(size_t(y) * dst.width + x) * 4 + c] = (sum + 2) / 4;
+                }
+            }
+        }
+    }
+
+    image.ok = true;
+    return image;
+}
+
+// Copies the whole mip chain into the unpack buffer and points each glTexImage2D at its offset,
+// so the driver can DMA from the buffer instead of blocking on client memory
+void TextureCache::upload(DecodedImage &image) {
+    Entry &entry = m_entries[image.handle];
+    if (!image.ok) {
+        std::cerr << "Failed to load texture " << entry.path << std::endl;
+        entry.state = TextureState::TEXTURE_FAILED;
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_unpackBuffer);
+    if (image.pixels.size() > m_unpackBufferSize) {
+        m_unpackBufferSize = image.pixels.size();
+    }
+    // Orphan the previous storage so we never wait on an upload still reading from it
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, m_unpackBufferSize, nullptr, GL_STREAM_DRAW);
+    void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image.pixels.size(),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped == nullptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        entry.state = TextureState::TEXTURE_FAILED;
+        return;
+    }
+    std::memcpy(mapped, image.pixels.data(), image.pixels.size());
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glGenTextures(1, &entry.texture);
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    for (size_t level = 0; level < image.levels.size(); level++) {
+        const MipLevel &mip = image.levels[level];
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, mip.width, mip.height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, reinterpret_cast<void*>(mip.offset));
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    entry.state = TextureState::TEXTURE_RESIDENT;
+    entry.bytes = image.pixels.size();
+    m_residentBytes += entry.bytes;
+}
+
+void TextureCache::update(size_t budgetBytes) {
+    m_frame++;
+
+    std::vector<DecodedImage> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_decodedMutex);
+        size_t bytes = 0;
+        size_t count = 0;
+        while (count < m_decoded.size() && (count == 0 || bytes + m_decoded[count].pixels.size() <= UPLOAD_BYTES_PER_FRAME)) {
+            bytes += m_decoded[count].pixels.size();
+            count++;
+        }
+        ready.assign(std::make_move_iterator(m_decoded.begin()),
+                     std::make_move_iterator(m_decoded.begin() + count));
+        m_decoded.erase(m_decoded.begin(), m_decoded.begin() + count);
+    }
+
+    for (DecodedImage &image : ready) {
+        upload(image);
+    }
+
+    evict(budgetBytes);
+}
+
+// Drops least-recently-used textures until the resident set fits. Textures used this frame
+// are kept even over budget, since evicting them would only reload them next frame.
+void TextureCache::evict(size_t budgetBytes) {
+    while (m_residentBytes > budgetBytes) {
+        Entry *oldest = nullptr;
+        for (Entry &entry : m_entries) {
+            if (entry.state == TextureState::TEXTURE_RESIDENT && entry.lastUsed + 1 < m_frame &&
+                (oldest == nullptr || entry.lastUsed < oldest->lastUsed)) {
+                oldest = &entry;
+            }
+        }
+        if (oldest == nullptr) {
+            return;
+        }
+        glDeleteTextures(1, &oldest->texture);
+        oldest->texture = 0;
+        oldest->state = TextureState::TEXTURE_EVICTED;
+        m_residentBytes -= oldest->bytes;
+        oldest->bytes = 0;
+    }
+}
+
+GLuint TextureCache::texture(int handle) {
+    if (handle < 0 || size_t(handle) >= m_entries.size()) {
+        return m_placeholder;
+    }
+
+    Entry &entry = m_entries[handle];
+    entry.lastUsed = m_frame;
+    if (entry.state == TextureState::TEXTURE_EVICTED) {
+        startDecode(handle);
+    }
+    return entry.state == TextureState::TEXTURE_RESIDENT ? entry.texture : m_placeholder;
+}
+
+bool TextureCache::isResident(int handle) const {
+    return handle >= 0 && size_t(handle) < m_entries.size() &&
+           m_entries[handle].state == TextureState::TEXTURE_RESIDENT;
+}
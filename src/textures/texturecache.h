@@ -0,0 +1,92 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include "utils/threadpool.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Streams material textures in the background. Images are decoded and their mip chains built
+// on worker threads; the GL thread only copies finished chains into a pixel-unpack buffer and
+// issues the uploads, a few megabytes per frame. Textures are shared by path, and resident
+// ones are evicted least-recently-used first once they exceed the VRAM budget. Until a texture
+// is resident, texture() returns a 1x1 white placeholder so draws never wait on a load.
+class TextureCache
+{
+public:
+    // Must be called with a current context
+    void initialize();
+    void finish();
+
+    // Returns a handle for the texture at path, starting its decode if this is the first request
+    int acquire(const std::string &path);
+
+    // Uploads finished decodes and enforces the budget; call once per frame with the context current
+    void update(size_t budgetBytes);
+
+    // Texture to bind for handle: the real one if resident, otherwise the placeholder.
+    // Marks the texture as used this frame and reloads it if it had been evicted.
+    GLuint texture(int handle);
+
+    bool isResident(int handle) const;
+    size_t residentBytes() const { return m_residentBytes; }
+
+private:
+    enum class TextureState {
+        TEXTURE_LOADING,
+        TEXTURE_RESIDENT,
+        TEXTURE_EVICTED,
+        TEXTURE_FAILED
+    };
+
+    struct MipLevel {
+        int width;
+        int height;
+        size_t offset; // Into DecodedImage::pixels
+    };
+
+    // Output of a worker: tightly packed RGBA8 mip chain, level 0 first
+    struct DecodedImage {
+        int handle;
+        bool ok;
+        std::vector<MipLevel> levels;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct Entry {
+        std::string path;
+        TextureState state;
+        GLuint texture;
+        size_t bytes;
+        uint64_t lastUsed;
+    };
+
+    void startDecode(int handle);
+    static DecodedImage decode(int handle, const std::string &path);
+    void upload(DecodedImage &image);
+    void evict(size_t budgetBytes);
+
+    std::vector<Entry> m_entries;
+    std::unordered_map<std::string, int> m_handles;
+
+    GLuint m_placeholder = 0;
+    GLuint m_unpackBuffer = 0;
+    size_t m_unpackBufferSize = 0;
+    size_t m_residentBytes = 0;
+    uint64_t m_frame = 0;
+
+    std::mutex m_decodedMutex;
+    std::vector<DecodedImage> m_decoded;       // Guarded by m_decodedMutex
+
+    // Declared last so it is destroyed (and its workers joined) before the state they write to
+    std::unique_ptr<ThreadPool> m_pool;
+};
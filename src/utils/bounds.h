@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Axis-aligned bounding box
+struct AABB {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    bool isEmpty() const { return min.x > max.x; }
+    glm::vec3 center() const { return 0.5f * (min + max); }
+    glm::vec3 extent() const { return 0.5f * (max - min); }
+
+    void expand(const glm::vec3 &p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void expand(const AABB &other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+};
+
+// The implicit primitives (cube, sphere, cylinder, cone) all fit in [-0.5, 0.5]^3
+inline AABB unitPrimitiveBounds() {
+    return AABB{glm::vec3(-0.5f), glm::vec3(0.5f)};
+}
+
+// Bounds of box after transforming it by m (Arvo's method, exact for the transformed box's AABB)
+inline AABB transformBounds(const AABB &box, const glm::mat4 &m) {
+    glm::vec3 center = glm::vec3(m * glm::vec4(box.center(), 1.f));
+    glm::vec3 extent = box.extent();
+    glm::vec3 newExtent(0.f);
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 3; col++) {
+            newExtent[row] += std::abs(m[col][row]) * extent[col];
+        }
+    }
+    return AABB{center - newExtent, center + newExtent};
+}
+
+// Squared distance from p to the closest point of box (0 if p is inside)
+inline float distanceSquared(const AABB &box, const glm::vec3 &p) {
+    glm::vec3 closest = glm::clamp(p, box.min, box.max);
+    glm::vec3 d = p - closest;
+    return glm::dot(d, d);
+}
+
+// View frustum as six inward-facing planes (a, b, c, d) with ax + by + cz + d >= 0 inside
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Extracts the frustum planes of a view-projection matrix (Gribb & Hartmann)
+inline Frustum frustumFromMatrix(const glm::mat4 &viewProj) {
+    glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+    glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+    glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+    glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0; // left
+    frustum.planes[1] = row3 - row0; // right
+    frustum.planes[2] = row3 + row1; // bottom
+    frustum.planes[3] = row3 - row1; // top
+    frustum.planes[4] = row3 + row2; // near
+    frustum.planes[5] = row3 - row2; // far
+    return frustum;
+}
+
+// Conservative test: false only if box is completely outside one of the planes
+inline bool intersects(const Frustum &frustum, const AABB &box) {
+    glm::vec3 center = box.center();
+    glm::vec3 extent = box.extent();
+    for (const glm::vec4 &plane : frustum.planes) {
+        glm::vec3 n = glm::vec3(plane);
+        float r = glm::dot(extent, glm::abs(n));
+        if (glm::dot(n, center) + plane.w < -r) {
+            return false;
+        }
+    }
+    return true;
+}
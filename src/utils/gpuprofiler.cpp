@@ -0,0 +1,139 @@
+#include "gpuprofiler.h"
+
+#include <iomanip>
+#include <iostream>
+
+GpuProfiler::Scope &GpuProfiler::scope(const std::string &name) {
+    for (Scope &scope : m_scopes) {
+        if (scope.name == name) {
+            return scope;
+        }
+    }
+
+    Scope scope;
+    scope.name = name;
+    glGenQueries(kLatency, scope.timeQueries.data());
+    glGenQueries(kLatency, scope.sampleQueries.data());
+    m_scopes.push_back(scope);
+    return m_scopes.back();
+}
+
+bool GpuProfiler::collect(Scope &scope, int slot) {
+    scope.issued[slot] = false;
+
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(scope.timeQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE) {
+        // Still in flight after kLatency frames; drop the sample rather than stall
+        return false;
+    }
+
+    GLuint64 nanoseconds = 0;
+    GLuint64 samples = 0;
+    glGetQueryObjectui64v(scope.timeQueries[slot], GL_QUERY_RESULT, &nanoseconds);
+    glGetQueryObjectui64v(scope.sampleQueries[slot], GL_QUERY_RESULT, &samples);
+
+    scope.latestMs = nanoseconds * 1e-6;
+    scope.totalMs += nanoseconds * 1e-6;
+    scope.totalSamples += samples;
+    scope.resolved++;
+    return true;
+}
+
+void GpuProfiler::begin(const std::string &name) {
+    Scope &current = scope(name);
+    m_active = &current - m_scopes.data();
+
+    int slot = m_frame % kLatency;
+    glBeginQuery(GL_TIME_ELAPSED, current.timeQueries[slot]);
+    glBeginQuery(GL_SAMPLES_PASSED, current.sampleQueries[slot]);
+}
+
+void GpuProfiler::end() {
+    if (m_active < 0) {
+        return;
+    }
+    glEndQuery(GL_SAMPLES_PASSED);
+    glEndQuery(GL_TIME_ELAPSED);
+    m_scopes[m_active].issued[m_frame % kLatency] = true;
+    m_active = -1;
+}
+
+void GpuProfiler::endFrame(bool report) {
+    m_frame++;
+
+    // Read back the frame issued kLatency frames ago, whose slot the next frame reuses. Its time
+    // only counts if every scope it issued resolved; a partial sum would look like a cheap frame.
+    int slot = m_frame % kLatency;
+    bool issued = false;
+    bool complete = true;
+    double frameMs = 0.0;
+    for (Scope &scope : m_scopes) {
+        if (!scope.issued[slot]) {
+            continue;
+        }
+        issued = true;
+        if (collect(scope, slot)) {
+            frameMs += scope.latestMs;
+        } else {
+            complete = false;
+        }
+    }
+    if (issued) {
+        m_latestFrameMs = complete ? frameMs : -1.0;
+    }
+
+    if (m_frame % reportInterval != 0) {
+        return;
+    }
+
+    for (Scope &scope : m_scopes) {
+        if (scope.resolved > 0) {
+            scope.averageMs = scope.totalMs / scope.resolved;
+            scope.averageSamples = scope.totalSamples / scope.resolved;
+        } else {
+            scope.averageMs = -1.0;
+            scope.averageSamples = -1.0;
+        }
+        scope.totalMs = 0.0;
+        scope.totalSamples = 0.0;
+        scope.resolved = 0;
+    }
+
+    if (!report) {
+        return;
+    }
+
+    std::cout << "GPU profile (avg over " << reportInterval << " frames):" << std::endl;
+    for (const Scope &scope : m_scopes) {
+        if (scope.averageMs < 0.0) {
+            continue;
+        }
+        std::cout << "  " << std::left << std::setw(20) << scope.name
+                  << std::fixed << std::setprecision(3) << scope.averageMs << " ms, "
+                  << std::setprecision(0) << scope.averageSamples << " samples passed" << std::endl;
+    }
+}
+
+double GpuProfiler::lastMs(const std::string &name) const {
+    for (const Scope &scope : m_scopes) {
+        if (scope.name == name) {
+            return scope.averageMs;
+        }
+    }
+    return -1.0;
+}
+
+double GpuProfiler::latestFrameMs() const {
+    return m_latestFrameMs;
+}
+
+void GpuProfiler::clear() {
+    for (Scope &scope : m_scopes) {
+        glDeleteQueries(kLatency, scope.timeQueries.data());
+        glDeleteQueries(kLatency, scope.sampleQueries.data());
+    }
+    m_scopes.clear();
+    m_active = -1;
+    m_latestFrameMs = -1.0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+// Measures named GPU scopes with GL_TIME_ELAPSED and GL_SAMPLES_PASSED queries.
+// Results are read back a few frames late from a small ring of queries so the CPU never
+// waits on the GPU. Scopes must not nest, which matches how the render passes are issued.
+class GpuProfiler
+{
+public:
+    void begin(const std::string &name);
+    void end();
+
+    // Call once per frame after all scopes were issued; prints averages every reportInterval frames
+    void endFrame(bool report);
+
+    // Average GPU time in milliseconds of the last completed report window, or -1 if unknown
+    double lastMs(const std::string &name) const;
+
+    // GPU time of the most recent frame read back (kLatency frames behind), summed over its
+    // scopes; -1 if nothing has been resolved yet or any of that frame's scopes was dropped
+    double latestFrameMs() const;
+
+    void clear();
+
+    static constexpr int reportInterval = 120;
+
+private:
+    static constexpr int kLatency = 4;
+
+    struct Scope {
+        std::string name;
+        std::array<GLuint, kLatency> timeQueries{};
+        std::array<GLuint, kLatency> sampleQueries{};
+        std::array<bool, kLatency> issued{};
+
+        double totalMs = 0.0;
+        double totalSamples = 0.0;
+        int resolved = 0;
+
+        double averageMs = -1.0;
+        double averageSamples = -1.0;
+
+        double latestMs = -1.0;
+    };
+
+    Scope &scope(const std::string &name);
+    bool collect(Scope &scope, int slot);
+
+    std::vector<Scope> m_scopes;
+    int m_active = -1;
+    int m_frame = 0;
+    double m_latestFrameMs = -1.0;
+};
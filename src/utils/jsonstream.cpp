@@ -0,0 +1,377 @@
+#include "jsonstream.h"
+
+#include <charconv>
+#include <cstdlib>
+
+JsonStream::JsonStream(const char *data, size_t size) : m_data(data), m_size(size) {}
+
+void JsonStream::skipWhitespace() {
+    while (m_pos < m_size) {
+        char c = m_data[m_pos];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            return;
+        }
+        m_pos++;
+    }
+}
+
+bool JsonStream::fail(const char *error) {
+    if (m_error == nullptr) {
+        m_error = error;
+        m_errorOffset = m_pos;
+    }
+    return false;
+}
+
+JsonStream::Type JsonStream::peek() {
+    if (failed()) {
+        return Type::Invalid;
+    }
+    skipWhitespace();
+    if (m_pos >= m_size) {
+        return Type::Invalid;
+    }
+    switch (m_data[m_pos]) {
+    case '{': return Type::Object;
+    case '[': return Type::Array;
+    case '"': return Type::String;
+    case 't': case 'f': return Type::Bool;
+    case 'n': return Type::Null;
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9': return Type::Number;
+    default: return Type::Invalid;
+    }
+}
+
+bool JsonStream::beginObject() {
+    if (peek() != Type::Object) {
+        return fail("illegal value");
+    }
+    if (m_depth == MAX_DEPTH) {
+        return fail("too deeply nested document");
+    }
+    m_pos++;
+    m_first[++m_depth] = true;
+    return true;
+}
+
+bool JsonStream::beginArray() {
+    if (peek() != Type::Array) {
+        return fail("illegal value");
+    }
+    if (m_depth == MAX_DEPTH) {
+        return fail("too deeply nested document");
+    }
+    m_pos++;
+    m_first[++m_depth] = true;
+    return true;
+}
+
+// Consumes the separator before the next member/element, or the closing bracket. Returns
+// false when the container is done (or on error); first tracks whether anything was read.
+bool JsonStream::closeContainer(char close, bool &first, const char *unterminated) {
+    if (failed()) {
+        return false;
+    }
+    skipWhitespace();
+    if (m_pos >= m_size) {
+        return fail(unterminated);
+    }
+    if (m_data[m_pos] == close) {
+        m_pos++;
+        m_depth--;
+        return false;
+    }
+    if (!first) {
+        if (m_data[m_pos] != ',') {
+            return fail("missing value separator");
+        }
+        m_pos++;
+        skipWhitespace();
+    }
+    first = false;
+    return true;
+}
+
+bool JsonStream::nextKey(std::string_view &key) {
+    bool wasFirst = m_first[m_depth];
+    if (!closeContainer('}', m_first[m_depth], "unterminated object")) {
+        return false;
+    }
+    if (m_pos >= m_size || m_data[m_pos] != '"') {
+        return fail(wasFirst ? "illegal value" : "object is missing after a comma");
+    }
+
+    bool escaped;
+    if (!scanString(&m_keyBuffer, key, escaped)) {
+        return false;
+    }
+    if (escaped) {
+        key = m_keyBuffer;
+    }
+
+    skipWhitespace();
+    if (m_pos >= m_size || m_data[m_pos] != ':') {
+        return fail("missing name separator");
+    }
+    m_pos++;
+    return true;
+}
+
+bool JsonStream::nextElement() {
+    return closeContainer(']', m_first[m_depth], "unterminated array");
+}
+
+bool JsonStream::scanString(std::string *decoded, std::string_view &raw, bool &escaped) {
+    size_t begin = m_pos + 1;   // Past the opening quote
+    size_t pos = begin;
+    escaped = false;
+
+    while (true) {
+        // Runs of plain characters are the common case and are copied (if at all) in bulk
+        size_t run = pos;
+        while (run < m_size) {
+            unsigned char c = m_data[run];
+            if (c == '"' || c == '\\' || c < 0x20) {
+                break;
+            }
+            run++;
+        }
+        if (escaped && decoded != nullptr) {
+            decoded->append(m_data + pos, run - pos);
+        }
+        pos = run;
+
+        if (pos >= m_size) {
+            m_pos = pos;
+            return fail("unterminated string");
+        }
+        if (m_data[pos] == '"') {
+            break;
+        }
+        if ((unsigned char)m_data[pos] < 0x20) {
+            m_pos = pos;
+            return fail("illegal value");
+        }
+
+        // Escape sequence
+        if (!escaped && decoded != nullptr) {
+            decoded->assign(m_data + begin, pos - begin);
+        }
+        escaped = true;
+        if (pos + 1 >= m_size) {
+            m_pos = pos;
+            return fail("unterminated string");
+        }
+        char e = m_data[pos + 1];
+        char c;
+        switch (e) {
+        case '"': case '\\': case '/': c = e; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+        case 'u': c = 0; break;
+        default:
+            m_pos = pos;
+            return fail("illegal escape sequence");
+        }
+        if (e != 'u') {
+            if (decoded != nullptr) {
+                decoded->push_back(c);
+            }
+            pos += 2;
+            continue;
+        }
+
+        // \uXXXX, possibly a surrogate pair, re-encoded as UTF-8
+        auto hex4 = [&](size_t at, unsigned &out) {
+            if (at + 4 > m_size) {
+                return false;
+            }
+            out = 0;
+            for (size_t i = at; i < at + 4; i++) {
+                char h = m_data[i];
+                unsigned digit = h >= '0' && h <= '9' ? h - '0'
+                               : h >= 'a' && h <= 'f' ? h - 'a' + 10
+                               : h >= 'A' && h <= 'F' ? h - 'A' + 10 : 16;
+                if (digit == 16) {
+                    return false;
+                }
+                out = out * 16 + digit;
+            }
+            return true;
+        };
+        unsigned code;
+        if (!hex4(pos + 2, code)) {
+            m_pos = pos;
+            return fail("illegal escape sequence");
+        }
+        pos += 6;
+        if (code >= 0xD800 && code < 0xDC00) {
+            unsigned low;
+            if (pos + 1 < m_size && m_data[pos] == '\\' && m_data[pos + 1] == 'u' && hex4(pos + 2, low)
+                && low >= 0xDC00 && low < 0xE000) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                pos += 6;
+            } else {
+                code = 0xFFFD;
+            }
+        } else if (code >= 0xDC00 && code < 0xE000) {
+            code = 0xFFFD;
+        }
+        if (decoded != nullptr) {
+            if (code < 0x80) {
+                decoded->push_back(char(code));
+            } else if (code < 0x800) {
+                decoded->push_back(char(0xC0 | (code >> 6)));
+                decoded->push_back(char(0x80 | (code & 0x3F)));
+            } else if (code < 0x10000) {
+                decoded->push_back(char(0xE0 | (code >> 12)));
+                decoded->push_back(char(0x80 | ((code >> 6) & 0x3F)));
+                decoded->push_back(char(0x80 | (code & 0x3F)));
+            } else {
+                decoded->push_back(char(0xF0 | (code >> 18)));
+                decoded->push_back(char(0x80 | ((code >> 12) & 0x3F)));
+                decoded->push_back(char(0x80 | ((code >> 6) & 0x3F)));
+                decoded->push_back(char(0x80 | (code & 0x3F)));
+            }
+        }
+    }
+
+    raw = std::string_view(m_data + begin, pos - begin);
+    m_pos = pos + 1;
+    return true;
+}
+
+bool JsonStream::scanNumber(size_t &end) {
+    auto isDigit = [&](size_t at) { return at < m_size && m_data[at] >= '0' && m_data[at] <= '9'; };
+
+    size_t pos = m_pos;
+    if (pos < m_size && m_data[pos] == '-') {
+        pos++;
+    }
+    if (pos < m_size && m_data[pos] == '0') {
+        pos++;
+    } else if (isDigit(pos)) {
+        while (isDigit(pos)) pos++;
+    } else {
+        return fail("illegal number");
+    }
+    if (pos < m_size && m_data[pos] == '.') {
+        pos++;
+        if (!isDigit(pos)) {
+            return fail("illegal number");
+        }
+        while (isDigit(pos)) pos++;
+    }
+    if (pos < m_size && (m_data[pos] == 'e' || m_data[pos] == 'E')) {
+        pos++;
+        if (pos < m_size && (m_data[pos] == '+' || m_data[pos] == '-')) {
+            pos++;
+        }
+        if (!isDigit(pos)) {
+            return fail("illegal number");
+        }
+        while (isDigit(pos)) pos++;
+    }
+    end = pos;
+    return true;
+}
+
+bool JsonStream::readNumber(double &value) {
+    if (peek() != Type::Number) {
+        return false;
+    }
+    size_t end;
+    if (!scanNumber(end)) {
+        return false;
+    }
+    std::from_chars_result result = std::from_chars(m_data + m_pos, m_data + end, value);
+    if (result.ec == std::errc::result_out_of_range) {
+        // Overflow to infinity and underflow to zero, as strtod does
+        value = std::strtod(std::string(m_data + m_pos, end - m_pos).c_str(), nullptr);
+    }
+    m_pos = end;
+    return true;
+}
+
+bool JsonStream::readString(std::string &value) {
+    if (peek() != Type::String) {
+        return false;
+    }
+    std::string_view raw;
+    bool escaped;
+    if (!scanString(&value, raw, escaped)) {
+        return false;
+    }
+    if (!escaped) {
+        value.assign(raw);
+    }
+    return true;
+}
+
+bool JsonStream::skipValue() {
+    std::string_view key;
+    switch (peek()) {
+    case Type::Object:
+        if (!beginObject()) {
+            return false;
+        }
+        while (nextKey(key)) {
+            if (!skipValue()) {
+                return false;
+            }
+        }
+        return !failed();
+    case Type::Array:
+        if (!beginArray()) {
+            return false;
+        }
+        while (nextElement()) {
+            if (!skipValue()) {
+                return false;
+            }
+        }
+        return !failed();
+    case Type::String: {
+        bool escaped;
+        return scanString(nullptr, key, escaped);
+    }
+    case Type::Number: {
+        size_t end;
+        if (!scanNumber(end)) {
+            return false;
+        }
+        m_pos = end;
+        return true;
+    }
+    case Type::Bool:
+    case Type::Null:
+        for (std::string_view literal : {"true", "false", "null"}) {
+            if (m_size - m_pos >= literal.size() && literal == std::string_view(m_data + m_pos, literal.size())) {
+                m_pos += literal.size();
+                return true;
+            }
+        }
+        return fail("illegal value");
+    default:
+        return fail("illegal value");
+    }
+}
+
+bool JsonStream::finish() {
+    if (failed()) {
+        return false;
+    }
+    skipWhitespace();
+    if (m_pos != m_size) {
+        return fail("garbage at the end of the document");
+    }
+    return true;
+}
+
+void JsonStream::seek(size_t offset) {
+    m_pos = offset;
+}
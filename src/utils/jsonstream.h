@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Pull-style JSON tokenizer over a byte range that stays alive while it is used (typically a
+// memory-mapped file). Nothing is materialized: callers walk objects and arrays themselves and
+// read only the values they want, so the cost is one pass over the bytes. Keys come back as
+// views into the input unless they contain escapes.
+//
+// The first syntax error is latched: every later call fails, and errorOffset()/errorString()
+// describe the error in the same terms as QJsonParseError.
+class JsonStream
+{
+public:
+    enum class Type { Object, Array, String, Number, Bool, Null, Invalid };
+
+    JsonStream(const char *data, size_t size);
+
+    // Type of the next value, without consuming it
+    Type peek();
+
+    // Object iteration: beginObject() consumes '{', then nextKey() returns each key with the
+    // reader positioned on its value, and returns false once '}' has been consumed
+    bool beginObject();
+    bool nextKey(std::string_view &key);
+
+    // Array iteration: beginArray() consumes '[', then nextElement() returns true while the
+    // reader is positioned on an element, and false once ']' has been consumed
+    bool beginArray();
+    bool nextElement();
+
+    // Read a value of the given type; on a type mismatch nothing is consumed
+    bool readNumber(double &value);
+    bool readString(std::string &value);
+
+    // Consume (and validate) the next value of any type
+    bool skipValue();
+
+    // True if only whitespace remains; flags trailing garbage as an error otherwise
+    bool finish();
+
+    // Offset of the next value; seek() returns to one so a value can be read out of order
+    size_t position() { skipWhitespace(); return m_pos; }
+    void seek(size_t offset);
+
+    bool failed() const { return m_error != nullptr; }
+    size_t errorOffset() const { return m_errorOffset; }
+    const char *errorString() const { return m_error; }
+
+private:
+    static constexpr int MAX_DEPTH = 1024;
+
+    void skipWhitespace();
+    bool fail(const char *error);
+    bool scanString(std::string *decoded, std::string_view &raw, bool &escaped);
+    bool scanNumber(size_t &end);
+    bool closeContainer(char close, bool &first, const char *unterminated);
+
+    const char *m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+    int m_depth = 0;
+
+    // Per nesting level: no element or member has been read yet at this level
+    bool m_first[MAX_DEPTH + 1] = {};
+
+    std::string m_keyBuffer;    // Decoded key when it had to be unescaped
+
+    const char *m_error = nullptr;
+    size_t m_errorOffset = 0;
+};
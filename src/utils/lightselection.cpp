@@ -0,0 +1,91 @@
+#include "lightselection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static float brightestChannel(const SceneColor &color) {
+    return std::max(color.r, std::max(color.g, color.b));
+}
+
+// Same falloff as default.frag: min(1, 1 / (c0 + c1 d + c2 d^2))
+static float attenuation(const glm::vec3 &function, float d) {
+    float denominator = function[0] + function[1] * d + function[2] * d * d;
+    return denominator <= 1.f ? 1.f : 1.f / denominator;
+}
+
+float LightSelection::attenuationRadius(const SceneLightData &light) {
+    if (light.type == LightType::LIGHT_DIRECTIONAL) {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    // Solve c2 d^2 + c1 d + c0 = brightness / cutoff for the largest positive d
+    float target = brightestChannel(light.color) / LIGHT_CUTOFF;
+    float c0 = light.function[0] - target;
+    float c1 = light.function[1];
+    float c2 = light.function[2];
+
+    if (c0 >= 0.f) {
+        return 0.f; // Already below the cutoff at the light's position
+    }
+    if (c2 > 0.f) {
+        float discriminant = c1 * c1 - 4.f * c2 * c0;
+        return (-c1 + std::sqrt(discriminant)) / (2.f * c2);
+    }
+    if (c1 > 0.f) {
+        return -c0 / c1;
+    }
+    return std::numeric_limits<float>::infinity();
+}
+
+float LightSelection::influence(const SceneLightData &light, float radius, const AABB &bounds) {
+    float brightness = brightestChannel(light.color);
+    if (light.type == LightType::LIGHT_DIRECTIONAL) {
+        return brightness;
+    }
+
+    glm::vec3 pos = glm::vec3(light.pos);
+    float d = std::sqrt(distanceSquared(bounds, pos));
+    if (d > radius) {
+        return 0.f;
+    }
+
+    if (light.type == LightType::LIGHT_SPOT) {
+        // Cone vs. bounding sphere: reject if the sphere lies entirely outside the outer angle
+        glm::vec3 toCenter = bounds.center() - pos;
+        float centerDistance = glm::length(toCenter);
+        float sphereRadius = glm::length(bounds.extent());
+        if (centerDistance > sphereRadius) {
+            float cosTheta = glm::dot(toCenter / centerDistance, glm::normalize(glm::vec3(light.dir)));
+            float theta = std::acos(std::clamp(cosTheta, -1.f, 1.f));
+            float spread = std::asin(sphereRadius / centerDistance);
+            if (theta > light.angle + spread) {
+                return 0.f;
+            }
+        }
+    }
+
+    return brightness * attenuation(light.function, d);
+}
+
+void LightSelection::select(const std::vector<SceneLightData> &lights, const std::vector<float> &radii,
+                            const AABB &bounds, int maxLights, std::vector<int> &selected) {
+    // Small fixed budget, so a scored list plus partial sort beats anything fancier
+    std::vector<std::pair<float, int>> scored;
+    scored.reserve(lights.size());
+    for (size_t i = 0; i < lights.size(); i++) {
+        float score = influence(lights[i], radii[i], bounds);
+        if (score > 0.f) {
+            scored.push_back({score, static_cast<int>(i)});
+        }
+    }
+
+    int count = std::min<int>(maxLights, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + count, scored.end(),
+                      [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    selected.clear();
+    for (int i = 0; i < count; i++) {
+        selected.push_back(scored[i].second);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "scenedata.h"
+#include "bounds.h"
+
+#include <vector>
+
+// Must match the size of the light arrays in default.frag
+constexpr int MAX_LIGHTS_PER_DRAW = 8;
+
+// Light contributions below this (in [0,1] color units) are invisible in an 8-bit framebuffer
+constexpr float LIGHT_CUTOFF = 1.f / 256.f;
+
+namespace LightSelection {
+    // Distance at which the light's attenuation function drops its brightest channel below
+    // LIGHT_CUTOFF. Returns infinity for lights that never fall off (directional, constant-only).
+    float attenuationRadius(const SceneLightData &light);
+
+    // Estimated contribution of light to anything inside bounds, 0 if it cannot reach it.
+    // radius is the precomputed attenuationRadius() of the light.
+    float influence(const SceneLightData &light, float radius, const AABB &bounds);
+
+    // Writes the indices of up to maxLights lights with the largest influence on bounds,
+    // most significant first. Lights that do not reach bounds at all are never selected.
+    void select(const std::vector<SceneLightData> &lights, const std::vector<float> &radii,
+                const AABB &bounds, int maxLights, std::vector<int> &selected);
+}
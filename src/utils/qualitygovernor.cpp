@@ -0,0 +1,60 @@
+#include "qualitygovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+static constexpr float LEVELS[] = {1.f, 0.8f, 0.6f, 0.45f, 0.3f, 0.2f};
+static constexpr int LEVEL_COUNT = sizeof(LEVELS) / sizeof(LEVELS[0]);
+
+void QualityGovernor::reset() {
+    m_level = 0;
+    m_settle = 0;
+    m_totalMs = 0.0;
+    m_samples = 0;
+    m_cheapFrames = 0;
+}
+
+float QualityGovernor::level() const {
+    return LEVELS[m_level];
+}
+
+int QualityGovernor::apply(int sliderValue) const {
+    return std::max(1, int(std::lround(sliderValue * LEVELS[m_level])));
+}
+
+bool QualityGovernor::update(double gpuMs, double budgetMs, bool mayLower, bool mayRaise) {
+    if (gpuMs < 0.0) {
+        return false;
+    }
+    if (m_settle > 0) {
+        m_settle--;
+        return false;
+    }
+
+    // Cheap frames only count while raising is allowed, so headroom another controller is
+    // already spending does not also raise the level the moment it is allowed to
+    m_cheapFrames = mayRaise && gpuMs < budgetMs * UPGRADE_BELOW ? m_cheapFrames + 1 : 0;
+    m_totalMs += gpuMs;
+    if (++m_samples < WINDOW) {
+        return false;
+    }
+
+    double averageMs = m_totalMs / m_samples;
+    m_totalMs = 0.0;
+    m_samples = 0;
+
+    int level = m_level;
+    if (mayLower && averageMs > budgetMs && m_level + 1 < LEVEL_COUNT) {
+        level = m_level + 1;
+    } else if (m_cheapFrames >= UPGRADE_FRAMES && m_level > 0) {
+        level = m_level - 1;
+    }
+    if (level == m_level) {
+        return false;
+    }
+
+    m_level = level;
+    m_settle = SETTLE_FRAMES;
+    m_cheapFrames = 0;
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// Lowers the tessellation when frames go over the GPU time budget and raises it again when
+// there is clear headroom. Quality moves through a fixed ladder of levels, each a fraction of
+// the Parameter 1/2 sliders, which stay the upper bound. A change re-tessellates every shape
+// and takes a few frames to show up in the measurements, so the governor waits for fresh
+// samples after each change, and requires a long stretch of cheap frames before stepping back
+// up. That asymmetry keeps it from oscillating between two levels. When another controller
+// shares the budget, the caller says which directions the governor may move in, so only one of
+// them reacts to a given frame time.
+class QualityGovernor
+{
+public:
+    void reset();
+
+    // Feeds one frame's GPU time (ms, or negative if unknown). Returns true if the level
+    // changed and the shapes have to be re-tessellated. The level only drops if mayLower and
+    // only rises if mayRaise.
+    bool update(double gpuMs, double budgetMs, bool mayLower, bool mayRaise);
+
+    // Fraction of the slider value currently allowed
+    float level() const;
+
+    // Effective tessellation for a slider value
+    int apply(int sliderValue) const;
+
+private:
+    static constexpr int WINDOW = 16;           // Frames averaged per decision
+    static constexpr int SETTLE_FRAMES = 8;     // Samples ignored after a change (readback latency)
+    static constexpr int UPGRADE_FRAMES = 120;  // Cheap frames needed before raising quality
+    static constexpr double UPGRADE_BELOW = 0.6; // "Cheap" means under this fraction of the budget
+
+    int m_level = 0;                            // Index into the ladder, 0 is full quality
+    int m_settle = 0;
+    double m_totalMs = 0.0;
+    int m_samples = 0;
+    int m_cheapFrames = 0;
+};
@@ -0,0 +1,495 @@
+#include "scenecache.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t MAGIC = 0x454843414353434eull;    // "NCSCACHE" read little-endian
+constexpr uint32_t VERSION = 5;
+constexpr size_t SECTION_ALIGNMENT = 64;
+constexpr uint32_t NO_STRING = ~0u;
+
+// Structs stored as raw bytes; the layout word below catches builds where they differ
+static_assert(std::is_trivially_copyable_v<SceneLightData>);
+static_assert(std::is_trivially_copyable_v<SceneCameraData>);
+static_assert(std::is_trivially_copyable_v<SceneGlobalData>);
+static_assert(sizeof(PrimitiveType) == sizeof(uint32_t));
+
+// Shape sections hold the scene's shapes, then the shapes of each template in order
+enum Section {
+    SECTION_CTMS,               // glm::mat4 per shape
+    SECTION_TYPES,              // uint32_t PrimitiveType per shape
+    SECTION_MATERIAL_INDICES,   // uint32_t index into SECTION_MATERIALS per shape
+    SECTION_MESHFILE_INDICES,   // uint32_t index into SECTION_MESHFILES per shape, or NO_MESHFILE
+    SECTION_MATERIALS,          // CompiledMaterial per unique material
+    SECTION_MESHFILES,          // uint32_t string offset per unique mesh path
+    SECTION_LIGHTS,             // SceneLightData per light
+    SECTION_STRINGS,            // NUL-terminated paths
+    SECTION_TEMPLATES,          // uint32_t shape count per template
+    SECTION_INSTANCE_TEMPLATES, // uint32_t template index per instance
+    SECTION_INSTANCE_CTMS,      // glm::mat4 per instance
+    SECTION_TEMPLATE_LIGHT_COUNTS, // uint32_t light count per template
+    SECTION_TEMPLATE_LIGHTS,    // SceneLightData per template light, relative to the template
+    SECTION_NODE_PARENTS,       // int32_t per hierarchy node
+    SECTION_NODE_LOCALS,        // glm::mat4 per hierarchy node
+    SECTION_NODE_FIRST_SHAPES,  // uint32_t per hierarchy node, and one past the last
+    SECTION_NODE_FIRST_LIGHTS,  // same
+    SECTION_NODE_FIRST_INSTANCES, // same
+    SECTION_LOCAL_LIGHTS,       // SceneLightData per scene light, relative to its node
+    SECTION_INSTANCE_NODES,     // int32_t hierarchy node per instance
+    SECTION_COUNT
+};
+
+struct SectionRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct CompiledFileMap {
+    uint32_t path;              // String offset, NO_STRING if unused
+    float repeatU;
+    float repeatV;
+    uint32_t isUsed;
+};
+
+// SceneMaterial with its paths interned, so equal materials are equal bytes
+struct CompiledMaterial {
+    glm::vec4 cAmbient;
+    glm::vec4 cDiffuse;
+    glm::vec4 cSpecular;
+    glm::vec4 cReflective;
+    glm::vec4 cTransparent;
+    glm::vec4 cEmissive;
+    float shininess;
+    float ior;
+    float blend;
+    uint32_t padding;
+    CompiledFileMap textureMap;
+    CompiledFileMap bumpMap;
+};
+
+struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t layout;
+
+    // Stamp of the scenefile this was compiled from
+    uint64_t sourceSize;
+    int64_t sourceModified;     // ms since epoch
+
+    uint32_t shapeCount;        // Scene and template shapes
+    uint32_t sceneShapeCount;
+    uint32_t materialCount;
+    uint32_t meshfileCount;
+    uint32_t lightCount;
+    uint32_t stringBytes;
+    uint32_t templateCount;
+    uint32_t instanceCount;
+    uint32_t templateLightCount;
+    uint32_t nodeCount;
+    uint32_t sceneLightCount;   // Lights of the scene's nodes, before the instances' lights
+    uint32_t padding;
+
+    SceneGlobalData globalData;
+    SceneCameraData cameraData;
+
+    SectionRange sections[SECTION_COUNT];
+};
+
+constexpr uint32_t layoutWord() {
+    return uint32_t(sizeof(Header)) ^ uint32_t(sizeof(SceneLightData)) << 10
+           ^ uint32_t(sizeof(CompiledMaterial)) << 20 ^ uint32_t(alignof(glm::mat4)) << 28;
+}
+
+size_t alignUp(size_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+template <typename T>
+void appendBytes(std::vector<char> &section, const T *data, size_t count) {
+    const char *bytes = reinterpret_cast<const char *>(data);
+    section.insert(section.end(), bytes, bytes + count * sizeof(T));
+}
+
+// Interns strings into the string table by value
+class StringTable {
+public:
+    uint32_t intern(const std::string &value) {
+        auto [found, inserted] = m_offsets.try_emplace(value, uint32_t(m_bytes.size()));
+        if (inserted) {
+            m_bytes.insert(m_bytes.end(), value.begin(), value.end());
+            m_bytes.push_back('\0');
+        }
+        return found->second;
+    }
+
+    const std::vector<char> &bytes() const { return m_bytes; }
+
+private:
+    std::unordered_map<std::string, uint32_t> m_offsets;
+    std::vector<char> m_bytes;
+};
+
+CompiledFileMap compileFileMap(const SceneFileMap &map, StringTable &strings) {
+    CompiledFileMap compiled{};
+    compiled.path = map.isUsed ? strings.intern(map.filename) : NO_STRING;
+    compiled.repeatU = map.isUsed ? map.repeatU : 0.f;
+    compiled.repeatV = map.isUsed ? map.repeatV : 0.f;
+    compiled.isUsed = map.isUsed;
+    return compiled;
+}
+
+CompiledMaterial compileMaterial(const SceneMaterial &material, StringTable &strings) {
+    // Value-initialized so the padding can't make equal materials compare different
+    CompiledMaterial compiled{};
+    compiled.cAmbient = material.cAmbient;
+    compiled.cDiffuse = material.cDiffuse;
+    compiled.cSpecular = material.cSpecular;
+    compiled.cReflective = material.cReflective;
+    compiled.cTransparent = material.cTransparent;
+    compiled.cEmissive = material.cEmissive;
+    compiled.shininess = material.shininess;
+    compiled.ior = material.ior;
+    compiled.blend = material.blend;
+    compiled.textureMap = compileFileMap(material.textureMap, strings);
+    compiled.bumpMap = compileFileMap(material.bumpMap, strings);
+    return compiled;
+}
+
+SceneFileMap expandFileMap(const CompiledFileMap &compiled, const char *strings) {
+    SceneFileMap map;
+    map.isUsed = compiled.isUsed != 0;
+    map.repeatU = compiled.repeatU;
+    map.repeatV = compiled.repeatV;
+    if (compiled.path != NO_STRING) {
+        map.filename = strings + compiled.path;
+    }
+    return map;
+}
+
+SceneMaterial expandMaterial(const CompiledMaterial &compiled, const char *strings) {
+    SceneMaterial material;
+    material.cAmbient = compiled.cAmbient;
+    material.cDiffuse = compiled.cDiffuse;
+    material.cSpecular = compiled.cSpecular;
+    material.shininess = compiled.shininess;
+    material.cReflective = compiled.cReflective;
+    material.cTransparent = compiled.cTransparent;
+    material.ior = compiled.ior;
+    material.textureMap = expandFileMap(compiled.textureMap, strings);
+    material.blend = compiled.blend;
+    material.cEmissive = compiled.cEmissive;
+    material.bumpMap = expandFileMap(compiled.bumpMap, strings);
+    return material;
+}
+
+void stampSource(const std::string &scenefile, uint64_t &size, int64_t &modified) {
+    QFileInfo info(QString::fromStdString(scenefile));
+    size = info.size();
+    modified = info.lastModified().toMSecsSinceEpoch();
+}
+
+}
+
+std::string SceneCache::cachePath(const std::string &scenefile) {
+    return scenefile + ".cache";
+}
+
+bool SceneCache::write(const std::string &cachefile, const std::string &scenefile, const RenderData &renderData) {
+    Header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.layout = layoutWord();
+    stampSource(scenefile, header.sourceSize, header.sourceModified);
+    header.globalData = renderData.globalData;
+    header.cameraData = renderData.cameraData;
+
+    std::vector<char> sections[SECTION_COUNT];
+    StringTable strings;
+
+    // The shape arrays are already in section layout
+    auto addShapes = [&](const RenderShapes &shapes) {
+        appendBytes(sections[SECTION_CTMS], shapes.ctms.data(), shapes.size());
+        appendBytes(sections[SECTION_TYPES], shapes.types.data(), shapes.size());
+        appendBytes(sections[SECTION_MATERIAL_INDICES], shapes.materials.data(), shapes.size());
+        appendBytes(sections[SECTION_MESHFILE_INDICES], shapes.meshfiles.data(), shapes.size());
+    };
+    size_t shapeCount = renderData.shapes.size();
+    addShapes(renderData.shapes);
+    for (const RenderTemplate &renderTemplate : renderData.templates) {
+        addShapes(renderTemplate.shapes);
+        uint32_t count = renderTemplate.shapes.size();
+        appendBytes(sections[SECTION_TEMPLATES], &count, 1);
+        shapeCount += count;
+        uint32_t lightCount = renderTemplate.lights.size();
+        appendBytes(sections[SECTION_TEMPLATE_LIGHT_COUNTS], &lightCount, 1);
+        appendBytes(sections[SECTION_TEMPLATE_LIGHTS], renderTemplate.lights.data(), lightCount);
+        header.templateLightCount += lightCount;
+    }
+    for (const RenderInstance &instance : renderData.instances) {
+        uint32_t templateIndex = instance.templateIndex;
+        appendBytes(sections[SECTION_INSTANCE_TEMPLATES], &templateIndex, 1);
+        appendBytes(sections[SECTION_INSTANCE_CTMS], &instance.ctm, 1);
+    }
+
+    // The material and mesh path tables are already interned, so shape indices carry over as is
+    for (const SceneMaterial &material : renderData.materials) {
+        CompiledMaterial compiled = compileMaterial(material, strings);
+        appendBytes(sections[SECTION_MATERIALS], &compiled, 1);
+    }
+    for (const std::string &meshfile : renderData.meshfiles) {
+        uint32_t path = strings.intern(meshfile);
+        appendBytes(sections[SECTION_MESHFILES], &path, 1);
+    }
+    appendBytes(sections[SECTION_LIGHTS], renderData.lights.data(), renderData.lights.size());
+    sections[SECTION_STRINGS] = strings.bytes();
+
+    const RenderHierarchy &hierarchy = renderData.hierarchy;
+    appendBytes(sections[SECTION_NODE_PARENTS], hierarchy.parents.data(), hierarchy.size());
+    appendBytes(sections[SECTION_NODE_LOCALS], hierarchy.locals.data(), hierarchy.size());
+    appendBytes(sections[SECTION_NODE_FIRST_SHAPES], hierarchy.firstShapes.data(), hierarchy.firstShapes.size());
+    appendBytes(sections[SECTION_NODE_FIRST_LIGHTS], hierarchy.firstLights.data(), hierarchy.firstLights.size());
+    appendBytes(sections[SECTION_NODE_FIRST_INSTANCES], hierarchy.firstInstances.data(), hierarchy.firstInstances.size());
+    appendBytes(sections[SECTION_LOCAL_LIGHTS], hierarchy.localLights.data(), hierarchy.localLights.size());
+    appendBytes(sections[SECTION_INSTANCE_NODES], hierarchy.instanceNodes.data(), hierarchy.instanceNodes.size());
+
+    header.shapeCount = shapeCount;
+    header.sceneShapeCount = renderData.shapes.size();
+    header.templateCount = renderData.templates.size();
+    header.instanceCount = renderData.instances.size();
+    header.materialCount = renderData.materials.size();
+    header.meshfileCount = renderData.meshfiles.size();
+    header.lightCount = renderData.lights.size();
+    header.stringBytes = strings.bytes().size();
+    header.nodeCount = hierarchy.size();
+    header.sceneLightCount = hierarchy.localLights.size();
+
+    size_t offset = alignUp(sizeof(Header));
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        header.sections[i] = {offset, sections[i].size()};
+        offset = alignUp(offset + sections[i].size());
+    }
+
+    // Written to a temporary and renamed on commit, so a reader never maps half a file
+    QSaveFile file(QString::fromStdString(cachefile));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    static const char zeros[SECTION_ALIGNMENT] = {};
+    size_t written = 0;
+    auto writeAt = [&](size_t position, const char *data, size_t size) {
+        file.write(zeros, position - written);
+        file.write(data, size);
+        written = position + size;
+    };
+    writeAt(0, reinterpret_cast<const char *>(&header), sizeof(Header));
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        writeAt(header.sections[i].offset, sections[i].data(), sections[i].size());
+    }
+    return file.commit();
+}
+
+bool SceneCache::load(const std::string &cachefile, const std::string &scenefile, RenderData &renderData) {
+    QFile file(QString::fromStdString(cachefile));
+    if (!file.open(QIODevice::ReadOnly) || size_t(file.size()) < sizeof(Header)) {
+        return false;
+    }
+    const char *data = reinterpret_cast<const char *>(file.map(0, file.size()));
+    if (data == nullptr) {
+        return false;
+    }
+    size_t fileSize = file.size();
+
+    Header header;
+    std::memcpy(&header, data, sizeof(Header));
+    uint64_t sourceSize;
+    int64_t sourceModified;
+    stampSource(scenefile, sourceSize, sourceModified);
+    if (header.magic != MAGIC || header.version != VERSION || header.layout != layoutWord()
+        || header.sourceSize != sourceSize || header.sourceModified != sourceModified) {
+        return false;
+    }
+
+    const uint64_t expectedSizes[SECTION_COUNT] = {
+        header.shapeCount * sizeof(glm::mat4), header.shapeCount * sizeof(uint32_t),
+        header.shapeCount * sizeof(uint32_t),
+        header.shapeCount * sizeof(uint32_t), header.materialCount * sizeof(CompiledMaterial),
+        header.meshfileCount * sizeof(uint32_t), header.lightCount * sizeof(SceneLightData),
+        header.stringBytes, header.templateCount * sizeof(uint32_t),
+        header.instanceCount * sizeof(uint32_t), header.instanceCount * sizeof(glm::mat4),
+        header.templateCount * sizeof(uint32_t), header.templateLightCount * sizeof(SceneLightData),
+        header.nodeCount * sizeof(int32_t), header.nodeCount * sizeof(glm::mat4),
+        (header.nodeCount + 1ull) * sizeof(uint32_t), (header.nodeCount + 1ull) * sizeof(uint32_t),
+        (header.nodeCount + 1ull) * sizeof(uint32_t), header.sceneLightCount * sizeof(SceneLightData),
+        header.instanceCount * sizeof(int32_t)};
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        const SectionRange &section = header.sections[i];
+        if (section.size != expectedSizes[i] || section.offset % SECTION_ALIGNMENT != 0
+            || section.offset > fileSize || section.size > fileSize - section.offset) {
+            std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+            return false;
+        }
+    }
+
+    // Every index must land inside its table before anything is copied out
+    const char *strings = data + header.sections[SECTION_STRINGS].offset;
+    if (header.stringBytes != 0 && strings[header.stringBytes - 1] != '\0') {
+        std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+        return false;
+    }
+    auto validString = [&](uint32_t offset) { return offset == NO_STRING || offset < header.stringBytes; };
+
+    // Sections are aligned in the file and the mapping is page aligned, so they are read in place
+    auto sectionData = [&](Section section) { return data + header.sections[section].offset; };
+    const glm::mat4 *ctms = reinterpret_cast<const glm::mat4 *>(sectionData(SECTION_CTMS));
+    const PrimitiveType *types = reinterpret_cast<const PrimitiveType *>(sectionData(SECTION_TYPES));
+    const uint32_t *materialIndices = reinterpret_cast<const uint32_t *>(sectionData(SECTION_MATERIAL_INDICES));
+    const uint32_t *meshfileIndices = reinterpret_cast<const uint32_t *>(sectionData(SECTION_MESHFILE_INDICES));
+    const CompiledMaterial *compiledMaterials = reinterpret_cast<const CompiledMaterial *>(sectionData(SECTION_MATERIALS));
+    const uint32_t *meshfiles = reinterpret_cast<const uint32_t *>(sectionData(SECTION_MESHFILES));
+    const SceneLightData *lights = reinterpret_cast<const SceneLightData *>(sectionData(SECTION_LIGHTS));
+    const uint32_t *templateSizes = reinterpret_cast<const uint32_t *>(sectionData(SECTION_TEMPLATES));
+    const uint32_t *instanceTemplates = reinterpret_cast<const uint32_t *>(sectionData(SECTION_INSTANCE_TEMPLATES));
+    const glm::mat4 *instanceCtms = reinterpret_cast<const glm::mat4 *>(sectionData(SECTION_INSTANCE_CTMS));
+    const uint32_t *templateLightCounts = reinterpret_cast<const uint32_t *>(sectionData(SECTION_TEMPLATE_LIGHT_COUNTS));
+    const SceneLightData *templateLights = reinterpret_cast<const SceneLightData *>(sectionData(SECTION_TEMPLATE_LIGHTS));
+    const int32_t *parents = reinterpret_cast<const int32_t *>(sectionData(SECTION_NODE_PARENTS));
+    const glm::mat4 *locals = reinterpret_cast<const glm::mat4 *>(sectionData(SECTION_NODE_LOCALS));
+    const uint32_t *firstShapes = reinterpret_cast<const uint32_t *>(sectionData(SECTION_NODE_FIRST_SHAPES));
+    const uint32_t *firstLights = reinterpret_cast<const uint32_t *>(sectionData(SECTION_NODE_FIRST_LIGHTS));
+    const uint32_t *firstInstances = reinterpret_cast<const uint32_t *>(sectionData(SECTION_NODE_FIRST_INSTANCES));
+    const SceneLightData *localLights = reinterpret_cast<const SceneLightData *>(sectionData(SECTION_LOCAL_LIGHTS));
+    const int32_t *instanceNodes = reinterpret_cast<const int32_t *>(sectionData(SECTION_INSTANCE_NODES));
+
+    uint64_t templateShapes = 0;
+    for (uint32_t i = 0; i < header.templateCount; i++) {
+        templateShapes += templateSizes[i];
+    }
+    if (header.sceneShapeCount > header.shapeCount || templateShapes != header.shapeCount - header.sceneShapeCount) {
+        std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+        return false;
+    }
+    uint64_t templateLightTotal = 0;
+    for (uint32_t i = 0; i < header.templateCount; i++) {
+        templateLightTotal += templateLightCounts[i];
+    }
+    uint64_t instanceLights = 0;
+    for (uint32_t i = 0; i < header.instanceCount; i++) {
+        if (instanceTemplates[i] >= header.templateCount) {
+            std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+            return false;
+        }
+        instanceLights += templateLightCounts[instanceTemplates[i]];
+    }
+    if (templateLightTotal != header.templateLightCount
+        || header.lightCount != header.sceneLightCount + instanceLights) {
+        std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+        return false;
+    }
+
+    // The hierarchy must be in depth-first order, with ranges that tile the scene's shapes,
+    // lights and instances, before a transform update can trust it
+    for (uint32_t i = 0; i < header.nodeCount; i++) {
+        if (parents[i] >= int32_t(i) || (parents[i] < 0) != (i == 0)) {
+            std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+            return false;
+        }
+    }
+    auto validRanges = [&](const uint32_t *first, uint32_t total) {
+        for (uint32_t i = 0; i < header.nodeCount; i++) {
+            if (first[i] > first[i + 1]) {
+                return false;
+            }
+        }
+        return (header.nodeCount == 0 || first[0] == 0) && first[header.nodeCount] == total;
+    };
+    if (!validRanges(firstShapes, header.sceneShapeCount) || !validRanges(firstLights, header.sceneLightCount)
+        || !validRanges(firstInstances, header.instanceCount)) {
+        std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+        return false;
+    }
+    for (uint32_t i = 0; i < header.instanceCount; i++) {
+        if (instanceNodes[i] < 0 || uint32_t(instanceNodes[i]) >= header.nodeCount) {
+            std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header.shapeCount; i++) {
+        if (uint32_t(types[i]) > uint32_t(PrimitiveType::PRIMITIVE_MESH) || materialIndices[i] >= header.materialCount
+            || (meshfileIndices[i] != NO_MESHFILE && meshfileIndices[i] >= header.meshfileCount)) {
+            std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+        if (!validString(compiledMaterials[i].textureMap.path) || !validString(compiledMaterials[i].bumpMap.path)) {
+            std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header.meshfileCount; i++) {
+        if (meshfiles[i] >= header.stringBytes) {
+            std::cerr << "Ignoring corrupt scene cache " << cachefile << std::endl;
+            return false;
+        }
+    }
+
+    renderData.globalData = header.globalData;
+    renderData.cameraData = header.cameraData;
+    renderData.lights.assign(lights, lights + header.lightCount);
+    renderData.materials.clear();
+    renderData.materials.reserve(header.materialCount);
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+        renderData.materials.push_back(expandMaterial(compiledMaterials[i], strings));
+    }
+    renderData.meshfiles.clear();
+    renderData.meshfiles.reserve(header.meshfileCount);
+    for (uint32_t i = 0; i < header.meshfileCount; i++) {
+        renderData.meshfiles.emplace_back(strings + meshfiles[i]);
+    }
+
+    // The shape arrays have the same layout as RenderShapes, so each is one bulk copy
+    auto copyShapes = [&](RenderShapes &shapes, uint32_t first, uint32_t count) {
+        shapes.ctms.assign(ctms + first, ctms + first + count);
+        shapes.types.assign(types + first, types + first + count);
+        shapes.materials.assign(materialIndices + first, materialIndices + first + count);
+        shapes.meshfiles.assign(meshfileIndices + first, meshfileIndices + first + count);
+    };
+    copyShapes(renderData.shapes, 0, header.sceneShapeCount);
+    renderData.templates.resize(header.templateCount);
+    uint32_t first = header.sceneShapeCount;
+    for (uint32_t i = 0; i < header.templateCount; i++) {
+        copyShapes(renderData.templates[i].shapes, first, templateSizes[i]);
+        first += templateSizes[i];
+    }
+    renderData.instances.resize(header.instanceCount);
+    for (uint32_t i = 0; i < header.instanceCount; i++) {
+        renderData.instances[i] = {int(instanceTemplates[i]), instanceCtms[i]};
+    }
+    for (uint32_t i = 0; i < header.templateCount; i++) {
+        renderData.templates[i].lights.assign(templateLights, templateLights + templateLightCounts[i]);
+        templateLights += templateLightCounts[i];
+    }
+
+    RenderHierarchy &hierarchy = renderData.hierarchy;
+    hierarchy.clear();
+    hierarchy.parents.assign(parents, parents + header.nodeCount);
+    hierarchy.computeSubtreeSizes();
+    hierarchy.locals.assign(locals, locals + header.nodeCount);
+    hierarchy.firstShapes.assign(firstShapes, firstShapes + header.nodeCount + 1);
+    hierarchy.firstLights.assign(firstLights, firstLights + header.nodeCount + 1);
+    hierarchy.firstInstances.assign(firstInstances, firstInstances + header.nodeCount + 1);
+    hierarchy.localLights.assign(localLights, localLights + header.sceneLightCount);
+    hierarchy.instanceNodes.assign(instanceNodes, instanceNodes + header.instanceCount);
+    return true;
+}
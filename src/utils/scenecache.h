@@ -0,0 +1,30 @@
+#pragma once
+
+#include "sceneparser.h"
+
+#include <string>
+
+// Compiled scenes: a versioned binary image of the flattened RenderData, written next to the
+// scenefile so later loads skip both JSON parsing and traverseDFS. The image is a header
+// (camera, global data and a section table) followed by 64-byte aligned SoA sections: shape
+// CTMs, primitive types, material and mesh path indices, then
+// the material and mesh path tables, the lights and a string table for file paths. The shape
+// sections match the arrays of RenderShapes, so loading copies them in bulk. Template shapes
+// follow the scene's own shapes in the shape sections, and the instances are stored as a
+// template index and a CTM each. The transform hierarchy is stored as its arrays too, so
+// scenes loaded from the image can be animated like freshly parsed ones.
+//
+// The header is stamped with the source file's size and modification time; an image that
+// does not match the current scenefile, or that was written by a different format version or
+// struct layout, is stale and ignored.
+namespace SceneCache {
+    // Where the compiled image of scenefile lives
+    std::string cachePath(const std::string &scenefile);
+
+    // Writes renderData, flattened from scenefile, to cachefile. Returns false if it can't.
+    bool write(const std::string &cachefile, const std::string &scenefile, const RenderData &renderData);
+
+    // Maps cachefile and fills renderData from it if it is a current image of scenefile.
+    // Returns false, without touching renderData, if the image is missing or stale.
+    bool load(const std::string &cachefile, const std::string &scenefile, RenderData &renderData);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory_resource>
 #include <vector>
 #include <string>
 
@@ -161,9 +162,13 @@ struct SceneTransformation {
 };
 
 // Struct which represents a node in the scene graph/tree, to be parsed by the student's `SceneParser`.
+// Its arrays allocate from resource, which is the reader's arena for parsed scenes.
 struct SceneNode {
-    std::vector<SceneTransformation*> transformations; // Note the order of transformations described in lab 5
-    std::vector<ScenePrimitive*> primitives;
-    std::vector<SceneLight*> lights;
-    std::vector<SceneNode*> children;
+    explicit SceneNode(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : transformations(resource), primitives(resource), lights(resource), children(resource) {}
+
+    std::pmr::vector<SceneTransformation*> transformations; // Note the order of transformations described in lab 5
+    std::pmr::vector<ScenePrimitive*> primitives;
+    std::pmr::vector<SceneLight*> lights;
+    std::pmr::vector<SceneNode*> children;
 };
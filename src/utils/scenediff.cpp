@@ -0,0 +1,105 @@
+#include "scenediff.h"
+#include "transformhierarchy.h"
+
+#include <cstring>
+
+namespace {
+
+// Equal in the fields that apply to the light's type; the others are never set
+bool sameLight(const SceneLightData &a, const SceneLightData &b) {
+    if (a.id != b.id || a.type != b.type || a.color != b.color || a.function != b.function) {
+        return false;
+    }
+    if (a.type != LightType::LIGHT_DIRECTIONAL && a.pos != b.pos) {
+        return false;
+    }
+    if (a.dir != b.dir) {
+        return false;
+    }
+    return a.type != LightType::LIGHT_SPOT || (a.penumbra == b.penumbra && a.angle == b.angle);
+}
+
+bool sameLights(const std::vector<SceneLightData> &a, const std::vector<SceneLightData> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!sameLight(a[i], b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sameTemplate(const RenderTemplate &a, const RenderTemplate &b) {
+    return a.shapes.ctms == b.shapes.ctms && a.shapes.types == b.shapes.types
+           && a.shapes.materials == b.shapes.materials && a.shapes.meshfiles == b.shapes.meshfiles
+           && sameLights(a.lights, b.lights);
+}
+
+}
+
+SceneDiff::Changes SceneDiff::diff(const RenderData &current, const RenderData &next) {
+    Changes changes;
+    const RenderHierarchy &a = current.hierarchy;
+    const RenderHierarchy &b = next.hierarchy;
+
+    // Same paths: same parents, and each node owns the same number of shapes, lights and instances
+    if (a.parents != b.parents || a.firstShapes != b.firstShapes || a.firstLights != b.firstLights
+        || a.firstInstances != b.firstInstances || current.shapes.types != next.shapes.types
+        || current.shapes.meshfiles != next.shapes.meshfiles || current.meshfiles != next.meshfiles
+        || current.instances.size() != next.instances.size() || current.lights.size() != next.lights.size()) {
+        changes.structural = true;
+        return changes;
+    }
+
+    for (uint32_t node = 0; node < a.size(); node++) {
+        if (a.locals[node] != b.locals[node]) {
+            changes.movedNodes.push_back(node);
+        }
+    }
+
+    changes.materials = current.shapes.materials != next.shapes.materials
+                        || current.materials.size() != next.materials.size();
+    for (size_t i = 0; i < current.materials.size() && !changes.materials; i++) {
+        changes.materials = !sameMaterial(current.materials[i], next.materials[i]);
+    }
+
+    changes.lights = !sameLights(a.localLights, b.localLights);
+
+    changes.templates = current.templates.size() != next.templates.size();
+    for (size_t t = 0; t < current.templates.size() && !changes.templates; t++) {
+        changes.templates = !sameTemplate(current.templates[t], next.templates[t]);
+    }
+    for (size_t i = 0; i < current.instances.size() && !changes.templates; i++) {
+        changes.templates = current.instances[i].templateIndex != next.instances[i].templateIndex;
+    }
+
+    changes.globals = std::memcmp(&current.globalData, &next.globalData, sizeof(SceneGlobalData)) != 0;
+    changes.camera = std::memcmp(&current.cameraData, &next.cameraData, sizeof(SceneCameraData)) != 0;
+    return changes;
+}
+
+void SceneDiff::apply(const Changes &changes, RenderData &current, RenderData &next) {
+    if (changes.materials) {
+        current.materials = std::move(next.materials);
+        current.shapes.materials = std::move(next.shapes.materials);
+    }
+    if (changes.templates) {
+        current.templates = std::move(next.templates);
+        for (size_t i = 0; i < current.instances.size(); i++) {
+            current.instances[i].templateIndex = next.instances[i].templateIndex;
+        }
+    }
+    // Lights come from next in full, placed as next places them; moved nodes then place their
+    // own again, from the same local lights
+    if (changes.lights || changes.templates) {
+        current.hierarchy.localLights = std::move(next.hierarchy.localLights);
+        current.lights = std::move(next.lights);
+    }
+    for (uint32_t node : changes.movedNodes) {
+        TransformHierarchy::setLocal(current, node, next.hierarchy.locals[node]);
+    }
+    current.globalData = next.globalData;
+    current.cameraData = next.cameraData;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "sceneparser.h"
+
+#include <cstdint>
+#include <vector>
+
+// What changed between two flattenings of the same scenefile, so an edit to a loaded scene can
+// be patched in instead of reloading it. Nodes are matched by path from the root: when both
+// hierarchies have the same parents, node i is the same group in each, and so are shape i,
+// light i and instance i. Any other change of shape is structural.
+namespace SceneDiff {
+    struct Changes {
+        bool structural = false;            // The graph differs; nothing below is filled in
+        std::vector<uint32_t> movedNodes;   // Hierarchy nodes whose local matrix changed
+        bool materials = false;             // The material table or some shape's material index
+        bool lights = false;                // Light parameters other than their placement
+        bool templates = false;             // Template contents, or what an instance references
+        bool globals = false;
+        bool camera = false;
+
+        bool empty() const {
+            return !structural && movedNodes.empty() && !materials && !lights && !templates && !globals && !camera;
+        }
+    };
+
+    Changes diff(const RenderData &current, const RenderData &next);
+
+    // Patches current to match next by the changes found above, except structural ones. Moved
+    // nodes are only marked (see TransformHierarchy::update()); next is left partly moved from.
+    void apply(const Changes &changes, RenderData &current, RenderData &next);
+}
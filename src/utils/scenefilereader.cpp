@@ -1,15 +1,19 @@
 #include "scenefilereader.h"
 #include "scenedata.h"
+#include "jsonstream.h"
 
 #include "glm/gtc/type_ptr.hpp"
 
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <iostream>
 #include <filesystem>
+#include <new>
+#include <string_view>
+#include <type_traits>
 
 #include <QFile>
-#include <QJsonArray>
 
 #define ERROR_AT(e) "error at line " << e.lineNumber() << " col " << e.columnNumber() << ": "
 #define PARSE_ERROR(e) std::cout << ERROR_AT(e) << "could not parse <" << e.tagName().toStdString() \
@@ -18,38 +22,32 @@
                                          << e.tagName().toStdString() << ">" << std::endl;
 
 // Students, please ignore this file.
+template <typename T>
+T *ScenefileReader::create() {
+    void *memory = m_arena.allocate(sizeof(T), alignof(T));
+    if constexpr (std::is_same_v<T, SceneNode>) {
+        return new (memory) SceneNode(&m_arena);
+    } else {
+        return new (memory) T();
+    }
+}
+
 ScenefileReader::ScenefileReader(const std::string &name) {
     file_name = name;
 
     memset(&m_cameraData, 0, sizeof(SceneCameraData));
     memset(&m_globalData, 0, sizeof(SceneGlobalData));
 
-    m_root = new SceneNode;
+    m_root = create<SceneNode>();
 
     m_templates.clear();
-    m_nodes.clear();
-
-    m_nodes.push_back(m_root);
 }
 
 ScenefileReader::~ScenefileReader() {
-    // Delete all Scene Nodes
-    for (unsigned int node = 0; node < m_nodes.size(); node++) {
-        for (size_t i = 0; i < (m_nodes[node])->transformations.size(); i++)
-        {
-            delete (m_nodes[node])->transformations[i];
-        }
-        for (size_t i = 0; i < (m_nodes[node])->primitives.size(); i++)
-        {
-            delete (m_nodes[node])->primitives[i];
-        }
-        (m_nodes[node])->transformations.clear();
-        (m_nodes[node])->primitives.clear();
-        (m_nodes[node])->children.clear();
-        delete m_nodes[node];
+    // Primitives own their strings; everything else goes with the arena
+    for (ScenePrimitive *primitive : m_primitives) {
+        primitive->~ScenePrimitive();
     }
-
-    m_nodes.clear();
     m_templates.clear();
 }
 
@@ -65,6 +63,231 @@ SceneNode *ScenefileReader::getRootNode() const {
     return m_root;
 }
 
+const std::map<std::string, SceneNode *> &ScenefileReader::getTemplates() const {
+    return m_templates;
+}
+
+namespace {
+
+// Every key the scenefile format knows, across all object types. Which keys are valid where
+// is decided by the switch in each parse function.
+enum class Key : uint8_t {
+    Unknown,
+    GlobalData, CameraData, Name, Groups, TemplateGroups,
+    AmbientCoeff, DiffuseCoeff, SpecularCoeff, TransparentCoeff,
+    Position, Up, HeightAngle, Aperture, FocalLength, Look, Focus,
+    Type, Color, AttenuationCoeff, Direction, Penumbra, Angle,
+    Translate, Rotate, Scale, Matrix, Lights, Primitives,
+    MeshFile, Ambient, Diffuse, Specular, Reflective, Transparent, Shininess, Ior, Blend,
+    TextureFile, TextureU, TextureV, BumpMapFile, BumpMapU, BumpMapV,
+};
+
+// In Key order, so KEY_NAMES[size_t(key) - 1] is the spelling of key
+constexpr std::string_view KEY_NAMES[] = {
+    "globalData", "cameraData", "name", "groups", "templateGroups",
+    "ambientCoeff", "diffuseCoeff", "specularCoeff", "transparentCoeff",
+    "position", "up", "heightAngle", "aperture", "focalLength", "look", "focus",
+    "type", "color", "attenuationCoeff", "direction", "penumbra", "angle",
+    "translate", "rotate", "scale", "matrix", "lights", "primitives",
+    "meshFile", "ambient", "diffuse", "specular", "reflective", "transparent", "shininess", "ior", "blend",
+    "textureFile", "textureU", "textureV", "bumpMapFile", "bumpMapU", "bumpMapV",
+};
+constexpr size_t KEY_COUNT = std::size(KEY_NAMES);
+static_assert(KEY_COUNT == size_t(Key::BumpMapV), "KEY_NAMES must list every Key in order");
+
+// Perfect hash of the key set: the length and three characters spread all keys over distinct
+// slots, so a lookup is one table read and one comparison. Keys shorter than 2 are never valid.
+constexpr size_t KEY_TABLE_SIZE = 128;
+constexpr size_t keyHash(std::string_view key) {
+    return (key.size() * 9 + (unsigned char)key[0] * 7 + (unsigned char)key[1]
+            + (unsigned char)key.back() * 8) % KEY_TABLE_SIZE;
+}
+
+constexpr std::array<Key, KEY_TABLE_SIZE> KEY_TABLE = [] {
+    std::array<Key, KEY_TABLE_SIZE> table{};
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+        table[keyHash(KEY_NAMES[i])] = Key(i + 1);
+    }
+    return table;
+}();
+
+// Adding a key can break the hash; if this fires, search for new multipliers
+constexpr bool keyHashIsPerfect() {
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+        if (KEY_TABLE[keyHash(KEY_NAMES[i])] != Key(i + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(keyHashIsPerfect(), "scenefile keys collide in KEY_TABLE");
+
+Key lookupKey(std::string_view key) {
+    if (key.size() < 2) {
+        return Key::Unknown;
+    }
+    Key candidate = KEY_TABLE[keyHash(key)];
+    return candidate != Key::Unknown && KEY_NAMES[size_t(candidate) - 1] == key ? candidate : Key::Unknown;
+}
+
+// Field values captured while streaming through an object. Objects are validated once they
+// close, in the same order and with the same messages as when the whole document was loaded.
+struct NumberField {
+    bool present = false;
+    bool isNumber = false;
+    double value = 0.0;
+};
+
+struct StringField {
+    bool present = false;
+    bool isString = false;
+    std::string value;
+};
+
+struct ArrayField {
+    bool present = false;
+    bool isArray = false;
+    int size = 0;
+    bool allNumbers = true;
+    double values[4] = {};  // The first four elements, if they are numbers
+};
+
+struct MatrixField {
+    bool present = false;
+    bool isArray = false;
+    int rows = 0;
+    const char *error = nullptr;    // First problem with a row, in row order
+    glm::mat4 matrix = glm::mat4(0.f);
+};
+
+// The readers consume one value of any type; they only fail on a syntax error
+bool readField(JsonStream &json, NumberField &field) {
+    field = NumberField();
+    field.present = true;
+    if (json.peek() != JsonStream::Type::Number) {
+        return json.skipValue();
+    }
+    field.isNumber = true;
+    return json.readNumber(field.value);
+}
+
+bool readField(JsonStream &json, StringField &field) {
+    field.present = true;
+    field.isString = false;
+    field.value.clear();
+    if (json.peek() != JsonStream::Type::String) {
+        return json.skipValue();
+    }
+    field.isString = true;
+    return json.readString(field.value);
+}
+
+bool readField(JsonStream &json, ArrayField &field) {
+    field = ArrayField();
+    field.present = true;
+    if (json.peek() != JsonStream::Type::Array) {
+        return json.skipValue();
+    }
+    field.isArray = true;
+
+    json.beginArray();
+    while (json.nextElement()) {
+        if (json.peek() == JsonStream::Type::Number) {
+            double value;
+            if (!json.readNumber(value)) {
+                return false;
+            }
+            if (field.size < 4) {
+                field.values[field.size] = value;
+            }
+        } else {
+            field.allNumbers = false;
+            if (!json.skipValue()) {
+                return false;
+            }
+        }
+        field.size++;
+    }
+    return !json.failed();
+}
+
+bool readField(JsonStream &json, MatrixField &field) {
+    field = MatrixField();
+    field.present = true;
+    if (json.peek() != JsonStream::Type::Array) {
+        return json.skipValue();
+    }
+    field.isArray = true;
+
+    float *matrixPtr = glm::value_ptr(field.matrix);
+    json.beginArray();
+    while (json.nextElement()) {
+        int rowIndex = field.rows++;
+        ArrayField row;
+        if (!readField(json, row)) {
+            return false;
+        }
+        if (field.error != nullptr) {
+            continue;
+        }
+        if (!row.isArray) {
+            field.error = "group matrix must be of type array of array";
+        } else if (row.size != 4) {
+            field.error = "group matrix must be 4x4";
+        } else if (!row.allNumbers) {
+            field.error = "group matrix must contain all floating-point values";
+        } else if (rowIndex < 4) {
+            for (int colIndex = 0; colIndex < 4; colIndex++) {
+                // fill in column-wise
+                matrixPtr[colIndex * 4 + rowIndex] = (float)row.values[colIndex];
+            }
+        }
+    }
+    return !json.failed();
+}
+
+// Validates an array field that must hold size numbers, printing the first problem
+bool checkArray(const ArrayField &field, int size, const char *notArray, const char *wrongSize, const char *notNumbers) {
+    if (!field.isArray) {
+        std::cout << notArray << std::endl;
+        return false;
+    }
+    if (field.size != size) {
+        std::cout << wrongSize << std::endl;
+        return false;
+    }
+    if (!field.allNumbers) {
+        std::cout << notNumbers << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Checks the type of the next value. On a mismatch, prints message unless the value is not
+// JSON at all, in which case the syntax error is latched for readJSON to report instead.
+bool expectType(JsonStream &json, JsonStream::Type type, const char *message) {
+    JsonStream::Type actual = json.peek();
+    if (actual == type) {
+        return true;
+    }
+    if (actual == JsonStream::Type::Invalid) {
+        json.skipValue();
+    } else {
+        std::cout << message << std::endl;
+    }
+    return false;
+}
+
+void unknownField(std::string_view field, const char *object) {
+    std::cout << "unknown field \"" << field << "\" on " << object << " object" << std::endl;
+}
+
+void missingField(const char *field, const char *object) {
+    std::cout << "missing required field \"" << field << "\" on " << object << " object" << std::endl;
+}
+
+}
+
 // This is where it all goes down...
 bool ScenefileReader::readJSON() {
     // Read the file
@@ -74,126 +297,182 @@ bool ScenefileReader::readJSON() {
         return false;
     }
 
-    // Load the JSON document
-    QByteArray fileContents = file.readAll();
-    QJsonParseError jsonError;
-    QJsonDocument doc = QJsonDocument::fromJson(fileContents, &jsonError);
-    if (doc.isNull()) {
+    // Stream straight over the mapped file; only fall back to reading it where it can't be
+    // mapped (e.g. Qt resources)
+    QByteArray contents;
+    const char *data = reinterpret_cast<const char *>(file.map(0, file.size()));
+    size_t size = file.size();
+    if (data == nullptr) {
+        contents = file.readAll();
+        data = contents.constData();
+        size = contents.size();
+    }
+
+    JsonStream json(data, size);
+    bool parsed = parseScenefile(json);
+    if (!parsed && json.failed()) {
         std::cout << "could not parse " << file_name << std::endl;
-        std::cout << "parse error at line " << jsonError.offset << ": "
-                  << jsonError.errorString().toStdString() << std::endl;
-        return false;
+        std::cout << "parse error at line " << json.errorOffset() << ": " << json.errorString() << std::endl;
     }
     file.close();
-
-    if (!doc.isObject()) {
-        std::cout << "document is not an object" << std::endl;
+    if (!parsed) {
         return false;
     }
 
-    // Get the root element
-    QJsonObject scenefile = doc.object();
+    std::cout << "Finished reading " << file_name << std::endl;
+    return true;
+}
 
-    if (!scenefile.contains("globalData")) {
-        std::cout << "missing required field \"globalData\" on root object" << std::endl;
-        return false;
-    }
-    if (!scenefile.contains("cameraData")) {
-        std::cout << "missing required field \"cameraData\" on root object" << std::endl;
+/**
+ * Parse the root object. Validation errors are printed here; syntax errors are left on the
+ * stream for readJSON.
+ */
+bool ScenefileReader::parseScenefile(JsonStream &json) {
+    if (json.peek() != JsonStream::Type::Object) {
+        if (json.skipValue() && json.finish()) {
+            std::cout << "document is not an object" << std::endl;
+        }
         return false;
     }
 
-    QStringList requiredFields = {"globalData", "cameraData"};
-    QStringList optionalFields = {"name", "groups", "templateGroups"};
-    // If other fields are present, raise an error
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : scenefile.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on root object" << std::endl;
+    bool hasGlobalData = false;
+    bool hasCameraData = false;
+    json.beginObject();
+    std::string_view key;
+    while (json.nextKey(key)) {
+        switch (lookupKey(key)) {
+        case Key::GlobalData:
+            hasGlobalData = true;
+            if (!parseGlobalData(json)) {
+                if (!json.failed()) {
+                    std::cout << "could not parse \"globalData\"" << std::endl;
+                }
+                return false;
+            }
+            break;
+        case Key::CameraData:
+            hasCameraData = true;
+            if (!parseCameraData(json)) {
+                if (!json.failed()) {
+                    std::cout << "could not parse \"cameraData\"" << std::endl;
+                }
+                return false;
+            }
+            break;
+        case Key::TemplateGroups:
+            if (!parseTemplateGroups(json)) {
+                return false;
+            }
+            break;
+        case Key::Groups:
+            if (!parseGroups(json, m_root)) {
+                return false;
+            }
+            break;
+        case Key::Name:
+            if (!json.skipValue()) {
+                return false;
+            }
+            break;
+        default:
+            unknownField(key, "root");
             return false;
         }
     }
-
-    // Parse the global data
-    if (!parseGlobalData(scenefile["globalData"].toObject())) {
-        std::cout << "could not parse \"globalData\"" << std::endl;
+    if (!json.finish()) {
         return false;
     }
 
-    // Parse the camera data
-    if (!parseCameraData(scenefile["cameraData"].toObject())) {
-        std::cout << "could not parse \"cameraData\"" << std::endl;
+    if (!hasGlobalData) {
+        missingField("globalData", "root");
         return false;
     }
-
-    // Parse the template groups
-    if (scenefile.contains("templateGroups")) {
-        if (!parseTemplateGroups(scenefile["templateGroups"])) {
-            return false;
-        }
+    if (!hasCameraData) {
+        missingField("cameraData", "root");
+        return false;
     }
 
-    // Parse the groups
-    if (scenefile.contains("groups")) {
-        if (!parseGroups(scenefile["groups"], m_root)) {
-            return false;
+    // Groups named after a template that is defined further down the file still refer to it
+    for (const PendingReference &pending : m_pendingReferences) {
+        auto found = m_templates.find(pending.name);
+        if (found != m_templates.end()) {
+            pending.parent->children[pending.child] = found->second;
         }
     }
+    m_pendingReferences.clear();
 
-    std::cout << "Finished reading " << file_name << std::endl;
     return true;
 }
 
 /**
  * Parse a globalData field and fill in m_globalData.
  */
-bool ScenefileReader::parseGlobalData(const QJsonObject &globalData) {
-    QStringList requiredFields = {"ambientCoeff", "diffuseCoeff", "specularCoeff"};
-    QStringList optionalFields = {"transparentCoeff"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto field : globalData.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on globalData object" << std::endl;
-            return false;
+bool ScenefileReader::parseGlobalData(JsonStream &json) {
+    NumberField ambient, diffuse, specular, transparent;
+
+    // Anything but an object is read as an empty one and fails on the required fields
+    if (json.peek() != JsonStream::Type::Object) {
+        if (!json.skipValue()) {
+            return false;
+        }
+    } else {
+        json.beginObject();
+        std::string_view key;
+        while (json.nextKey(key)) {
+            bool read;
+            switch (lookupKey(key)) {
+            case Key::AmbientCoeff: read = readField(json, ambient); break;
+            case Key::DiffuseCoeff: read = readField(json, diffuse); break;
+            case Key::SpecularCoeff: read = readField(json, specular); break;
+            case Key::TransparentCoeff: read = readField(json, transparent); break;
+            default:
+                unknownField(key, "globalData");
+                return false;
+            }
+            if (!read) {
+                return false;
+            }
         }
-    }
-    for (auto field : requiredFields) {
-        if (!globalData.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on globalData object" << std::endl;
+        if (json.failed()) {
             return false;
         }
     }
 
-    // Parse the global data
-    if (globalData["ambientCoeff"].isDouble()) {
-        m_globalData.ka = globalData["ambientCoeff"].toDouble();
+    if (!ambient.present) {
+        missingField("ambientCoeff", "globalData");
+        return false;
     }
-    else {
-        std::cout << "globalData ambientCoeff must be a floating-point value" << std::endl;
+    if (!diffuse.present) {
+        missingField("diffuseCoeff", "globalData");
         return false;
     }
-    if (globalData["diffuseCoeff"].isDouble()) {
-        m_globalData.kd = globalData["diffuseCoeff"].toDouble();
+    if (!specular.present) {
+        missingField("specularCoeff", "globalData");
+        return false;
     }
-    else {
-        std::cout << "globalData diffuseCoeff must be a floating-point value" << std::endl;
+
+    // Parse the global data
+    if (!ambient.isNumber) {
+        std::cout << "globalData ambientCoeff must be a floating-point value" << std::endl;
         return false;
     }
-    if (globalData["specularCoeff"].isDouble()) {
-        m_globalData.ks = globalData["specularCoeff"].toDouble();
+    m_globalData.ka = ambient.value;
+    if (!diffuse.isNumber) {
+        std::cout << "globalData diffuseCoeff must be a floating-point value" << std::endl;
+        return false;
     }
-    else {
+    m_globalData.kd = diffuse.value;
+    if (!specular.isNumber) {
         std::cout << "globalData specularCoeff must be a floating-point value" << std::endl;
         return false;
     }
-    if (globalData.contains("transparentCoeff")) {
-        if (globalData["transparentCoeff"].isDouble()) {
-            m_globalData.kt = globalData["transparentCoeff"].toDouble();
-        }
-        else {
+    m_globalData.ks = specular.value;
+    if (transparent.present) {
+        if (!transparent.isNumber) {
             std::cout << "globalData transparentCoeff must be a floating-point value" << std::endl;
             return false;
         }
+        m_globalData.kt = transparent.value;
     }
 
     return true;
@@ -202,25 +481,46 @@ bool ScenefileReader::parseGlobalData(const QJsonObject &globalData) {
 /**
  * Parse a Light and add a new CS123SceneLightData to m_lights.
  */
-bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *node) {
-    QStringList requiredFields = {"type", "color"};
-    QStringList optionalFields = {"name", "attenuationCoeff", "direction", "penumbra", "angle"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : lightData.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on light object" << std::endl;
+bool ScenefileReader::parseLightData(JsonStream &json, SceneNode *node) {
+    StringField type;
+    ArrayField color, attenuation, direction;
+    NumberField penumbra, angle;
+
+    json.beginObject();
+    std::string_view key;
+    while (json.nextKey(key)) {
+        bool read;
+        switch (lookupKey(key)) {
+        case Key::Type: read = readField(json, type); break;
+        case Key::Color: read = readField(json, color); break;
+        case Key::Name: read = json.skipValue(); break;
+        case Key::AttenuationCoeff: read = readField(json, attenuation); break;
+        case Key::Direction: read = readField(json, direction); break;
+        case Key::Penumbra: read = readField(json, penumbra); break;
+        case Key::Angle: read = readField(json, angle); break;
+        default:
+            unknownField(key, "light");
             return false;
         }
-    }
-    for (auto &field : requiredFields) {
-        if (!lightData.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on light object" << std::endl;
+        if (!read) {
             return false;
         }
     }
+    if (json.failed()) {
+        return false;
+    }
+
+    if (!type.present) {
+        missingField("type", "light");
+        return false;
+    }
+    if (!color.present) {
+        missingField("color", "light");
+        return false;
+    }
 
     // Create a default light
-    SceneLight *light = new SceneLight();
+    SceneLight *light = create<SceneLight>();
     memset(light, 0, sizeof(SceneLight));
     node->lights.push_back(light);
 
@@ -228,140 +528,101 @@ bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *no
     light->function = glm::vec3(1, 0, 0);
 
     // parse the color
-    if (!lightData["color"].isArray()) {
-        std::cout << "light color must be of type array" << std::endl;
-        return false;
-    }
-    QJsonArray colorArray = lightData["color"].toArray();
-    if (colorArray.size() != 3) {
-        std::cout << "light color must be of size 3" << std::endl;
+    if (!checkArray(color, 3, "light color must be of type array", "light color must be of size 3",
+                    "light color must contain floating-point values")) {
         return false;
     }
-    if (!colorArray[0].isDouble() || !colorArray[1].isDouble() || !colorArray[2].isDouble()) {
-        std::cout << "light color must contain floating-point values" << std::endl;
-        return false;
-    }
-    light->color.r = colorArray[0].toDouble();
-    light->color.g = colorArray[1].toDouble();
-    light->color.b = colorArray[2].toDouble();
+    light->color.r = color.values[0];
+    light->color.g = color.values[1];
+    light->color.b = color.values[2];
 
     // parse the type
-    if (!lightData["type"].isString()) {
+    if (!type.isString) {
         std::cout << "light type must be of type string" << std::endl;
         return false;
     }
-    std::string lightType = lightData["type"].toString().toStdString();
+    const std::string &lightType = type.value;
 
     // parse directional light
     if (lightType == "directional") {
         light->type = LightType::LIGHT_DIRECTIONAL;
 
         // parse direction
-        if (!lightData.contains("direction")) {
+        if (!direction.present) {
             std::cout << "directional light must contain field \"direction\"" << std::endl;
             return false;
         }
-        if (!lightData["direction"].isArray()) {
-            std::cout << "directional light direction must be of type array" << std::endl;
+        if (!checkArray(direction, 3, "directional light direction must be of type array",
+                        "directional light direction must be of size 3",
+                        "directional light direction must contain floating-point values")) {
             return false;
         }
-        QJsonArray directionArray = lightData["direction"].toArray();
-        if (directionArray.size() != 3) {
-            std::cout << "directional light direction must be of size 3" << std::endl;
-            return false;
-        }
-        if (!directionArray[0].isDouble() || !directionArray[1].isDouble() || !directionArray[2].isDouble()) {
-            std::cout << "directional light direction must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->dir.x = directionArray[0].toDouble();
-        light->dir.y = directionArray[1].toDouble();
-        light->dir.z = directionArray[2].toDouble();
+        light->dir.x = direction.values[0];
+        light->dir.y = direction.values[1];
+        light->dir.z = direction.values[2];
     }
     else if (lightType == "point") {
         light->type = LightType::LIGHT_POINT;
 
         // parse the attenuation coefficient
-        if (!lightData.contains("attenuationCoeff")) {
+        if (!attenuation.present) {
             std::cout << "point light must contain field \"attenuationCoeff\"" << std::endl;
             return false;
         }
-        if (!lightData["attenuationCoeff"].isArray()) {
-            std::cout << "point light attenuationCoeff must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray attenuationArray = lightData["attenuationCoeff"].toArray();
-        if (attenuationArray.size() != 3) {
-            std::cout << "point light attenuationCoeff must be of size 3" << std::endl;
+        if (!checkArray(attenuation, 3, "point light attenuationCoeff must be of type array",
+                        "point light attenuationCoeff must be of size 3",
+                        "ppoint light attenuationCoeff must contain floating-point values")) {
             return false;
         }
-        if (!attenuationArray[0].isDouble() || !attenuationArray[1].isDouble() || !attenuationArray[2].isDouble()) {
-            std::cout << "ppoint light attenuationCoeff must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->function.x = attenuationArray[0].toDouble();
-        light->function.y = attenuationArray[1].toDouble();
-        light->function.z = attenuationArray[2].toDouble();
+        light->function.x = attenuation.values[0];
+        light->function.y = attenuation.values[1];
+        light->function.z = attenuation.values[2];
     }
     else if (lightType == "spot") {
-        QStringList pointRequiredFields = {"direction", "penumbra", "angle", "attenuationCoeff"};
-        for (auto &field : pointRequiredFields) {
-            if (!lightData.contains(field)) {
-                std::cout << "missing required field \"" << field.toStdString() << "\" on spotlight object" << std::endl;
+        std::pair<const char *, bool> spotRequiredFields[] = {
+            {"direction", direction.present}, {"penumbra", penumbra.present},
+            {"angle", angle.present}, {"attenuationCoeff", attenuation.present}};
+        for (auto &[field, present] : spotRequiredFields) {
+            if (!present) {
+                missingField(field, "spotlight");
                 return false;
             }
         }
         light->type = LightType::LIGHT_SPOT;
 
         // parse direction
-        if (!lightData["direction"].isArray()) {
-            std::cout << "spotlight direction must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray directionArray = lightData["direction"].toArray();
-        if (directionArray.size() != 3) {
-            std::cout << "spotlight direction must be of size 3" << std::endl;
-            return false;
-        }
-        if (!directionArray[0].isDouble() || !directionArray[1].isDouble() || !directionArray[2].isDouble()) {
-            std::cout << "spotlight direction must contain floating-point values" << std::endl;
+        if (!checkArray(direction, 3, "spotlight direction must be of type array",
+                        "spotlight direction must be of size 3",
+                        "spotlight direction must contain floating-point values")) {
             return false;
         }
-        light->dir.x = directionArray[0].toDouble();
-        light->dir.y = directionArray[1].toDouble();
-        light->dir.z = directionArray[2].toDouble();
+        light->dir.x = direction.values[0];
+        light->dir.y = direction.values[1];
+        light->dir.z = direction.values[2];
 
         // parse attenuation coefficient
-        if (!lightData["attenuationCoeff"].isArray()) {
-            std::cout << "spotlight attenuationCoeff must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray attenuationArray = lightData["attenuationCoeff"].toArray();
-        if (attenuationArray.size() != 3) {
-            std::cout << "spotlight attenuationCoeff must be of size 3" << std::endl;
-            return false;
-        }
-        if (!attenuationArray[0].isDouble() || !attenuationArray[1].isDouble() || !attenuationArray[2].isDouble()) {
-            std::cout << "spotlight direction must contain floating-point values" << std::endl;
+        if (!checkArray(attenuation, 3, "spotlight attenuationCoeff must be of type array",
+                        "spotlight attenuationCoeff must be of size 3",
+                        "spotlight direction must contain floating-point values")) {
             return false;
         }
-        light->function.x = attenuationArray[0].toDouble();
-        light->function.y = attenuationArray[1].toDouble();
-        light->function.z = attenuationArray[2].toDouble();
+        light->function.x = attenuation.values[0];
+        light->function.y = attenuation.values[1];
+        light->function.z = attenuation.values[2];
 
         // parse penumbra
-        if (!lightData["penumbra"].isDouble()) {
+        if (!penumbra.isNumber) {
             std::cout << "spotlight penumbra must be of type float" << std::endl;
             return false;
         }
-        light->penumbra = lightData["penumbra"].toDouble() * M_PI / 180.f;
+        light->penumbra = penumbra.value * M_PI / 180.f;
 
         // parse angle
-        if (!lightData["angle"].isDouble()) {
+        if (!angle.isNumber) {
             std::cout << "spotlight angle must be of type float" << std::endl;
             return false;
         }
-        light->angle = lightData["angle"].toDouble() * M_PI / 180.f;
+        light->angle = angle.value * M_PI / 180.f;
     }
     else {
         std::cout << "unknown light type \"" << lightType << "\"" << std::endl;
@@ -374,464 +635,415 @@ bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *no
 /**
  * Parse cameraData and fill in m_cameraData.
  */
-bool ScenefileReader::parseCameraData(const QJsonObject &cameradata) {
-    QStringList requiredFields = {"position", "up", "heightAngle"};
-    QStringList optionalFields = {"aperture", "focalLength", "look", "focus"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : cameradata.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on cameraData object" << std::endl;
-            return false;
+bool ScenefileReader::parseCameraData(JsonStream &json) {
+    ArrayField position, up, look, focus;
+    NumberField heightAngle, aperture, focalLength;
+
+    // Anything but an object is read as an empty one and fails on the required fields
+    if (json.peek() != JsonStream::Type::Object) {
+        if (!json.skipValue()) {
+            return false;
+        }
+    } else {
+        json.beginObject();
+        std::string_view key;
+        while (json.nextKey(key)) {
+            bool read;
+            switch (lookupKey(key)) {
+            case Key::Position: read = readField(json, position); break;
+            case Key::Up: read = readField(json, up); break;
+            case Key::HeightAngle: read = readField(json, heightAngle); break;
+            case Key::Aperture: read = readField(json, aperture); break;
+            case Key::FocalLength: read = readField(json, focalLength); break;
+            case Key::Look: read = readField(json, look); break;
+            case Key::Focus: read = readField(json, focus); break;
+            default:
+                unknownField(key, "cameraData");
+                return false;
+            }
+            if (!read) {
+                return false;
+            }
         }
-    }
-    for (auto &field : requiredFields) {
-        if (!cameradata.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on cameraData object" << std::endl;
+        if (json.failed()) {
             return false;
         }
     }
 
+    if (!position.present) {
+        missingField("position", "cameraData");
+        return false;
+    }
+    if (!up.present) {
+        missingField("up", "cameraData");
+        return false;
+    }
+    if (!heightAngle.present) {
+        missingField("heightAngle", "cameraData");
+        return false;
+    }
+
     // Must have either look or focus, but not both
-    if (cameradata.contains("look") && cameradata.contains("focus")) {
+    if (look.present && focus.present) {
         std::cout << "cameraData cannot contain both \"look\" and \"focus\"" << std::endl;
         return false;
     }
 
     // Parse the camera data
-    if (cameradata["position"].isArray()) {
-        QJsonArray position = cameradata["position"].toArray();
-        if (position.size() != 3) {
-            std::cout << "cameraData position must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!position[0].isDouble() || !position[1].isDouble() || !position[2].isDouble()) {
-            std::cout << "cameraData position must be a floating-point value" << std::endl;
-            return false;
-        }
-        m_cameraData.pos.x = position[0].toDouble();
-        m_cameraData.pos.y = position[1].toDouble();
-        m_cameraData.pos.z = position[2].toDouble();
-        m_cameraData.pos.w = 1.f;
-    }
-    else {
-        std::cout << "cameraData position must be an array" << std::endl;
+    if (!checkArray(position, 3, "cameraData position must be an array", "cameraData position must have 3 elements",
+                    "cameraData position must be a floating-point value")) {
         return false;
     }
+    m_cameraData.pos = glm::vec4(position.values[0], position.values[1], position.values[2], 1.f);
 
-    if (cameradata["up"].isArray()) {
-        QJsonArray up = cameradata["up"].toArray();
-        if (up.size() != 3) {
-            std::cout << "cameraData up must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!up[0].isDouble() || !up[1].isDouble() || !up[2].isDouble()) {
-            std::cout << "cameraData up must be a floating-point value" << std::endl;
-            return false;
-        }
-        m_cameraData.up.x = up[0].toDouble();
-        m_cameraData.up.y = up[1].toDouble();
-        m_cameraData.up.z = up[2].toDouble();
-        m_cameraData.up.w = 0.f;
-    }
-    else {
-        std::cout << "cameraData up must be an array" << std::endl;
+    if (!checkArray(up, 3, "cameraData up must be an array", "cameraData up must have 3 elements",
+                    "cameraData up must be a floating-point value")) {
         return false;
     }
+    m_cameraData.up = glm::vec4(up.values[0], up.values[1], up.values[2], 0.f);
 
-    if (cameradata["heightAngle"].isDouble()) {
-        m_cameraData.heightAngle = cameradata["heightAngle"].toDouble() * M_PI / 180.f;
-    }
-    else {
+    if (!heightAngle.isNumber) {
         std::cout << "cameraData heightAngle must be a floating-point value" << std::endl;
         return false;
     }
+    m_cameraData.heightAngle = heightAngle.value * M_PI / 180.f;
 
-    if (cameradata.contains("aperture")) {
-        if (cameradata["aperture"].isDouble()) {
-            m_cameraData.aperture = cameradata["aperture"].toDouble();
-        }
-        else {
+    if (aperture.present) {
+        if (!aperture.isNumber) {
             std::cout << "cameraData aperture must be a floating-point value" << std::endl;
             return false;
         }
+        m_cameraData.aperture = aperture.value;
     }
 
-    if (cameradata.contains("focalLength")) {
-        if (cameradata["focalLength"].isDouble()) {
-            m_cameraData.focalLength = cameradata["focalLength"].toDouble();
-        }
-        else {
+    if (focalLength.present) {
+        if (!focalLength.isNumber) {
             std::cout << "cameraData focalLength must be a floating-point value" << std::endl;
             return false;
         }
+        m_cameraData.focalLength = focalLength.value;
     }
 
     // Parse the look or focus
     // if the focus is specified, we will convert it to a look vector later
-    if (cameradata.contains("look")) {
-        if (cameradata["look"].isArray()) {
-            QJsonArray look = cameradata["look"].toArray();
-            if (look.size() != 3) {
-                std::cout << "cameraData look must have 3 elements" << std::endl;
-                return false;
-            }
-            if (!look[0].isDouble() || !look[1].isDouble() || !look[2].isDouble()) {
-                std::cout << "cameraData look must be a floating-point value" << std::endl;
-                return false;
-            }
-            m_cameraData.look.x = look[0].toDouble();
-            m_cameraData.look.y = look[1].toDouble();
-            m_cameraData.look.z = look[2].toDouble();
-            m_cameraData.look.w = 0.f;
-        }
-        else {
-            std::cout << "cameraData look must be an array" << std::endl;
+    if (look.present) {
+        if (!checkArray(look, 3, "cameraData look must be an array", "cameraData look must have 3 elements",
+                        "cameraData look must be a floating-point value")) {
             return false;
         }
+        m_cameraData.look = glm::vec4(look.values[0], look.values[1], look.values[2], 0.f);
     }
-    else if (cameradata.contains("focus")) {
-        if (cameradata["focus"].isArray()) {
-            QJsonArray focus = cameradata["focus"].toArray();
-            if (focus.size() != 3) {
-                std::cout << "cameraData focus must have 3 elements" << std::endl;
-                return false;
-            }
-            if (!focus[0].isDouble() || !focus[1].isDouble() || !focus[2].isDouble()) {
-                std::cout << "cameraData focus must be a floating-point value" << std::endl;
-                return false;
-            }
-            m_cameraData.look.x = focus[0].toDouble();
-            m_cameraData.look.y = focus[1].toDouble();
-            m_cameraData.look.z = focus[2].toDouble();
-            m_cameraData.look.w = 1.f;
-        }
-        else {
-            std::cout << "cameraData focus must be an array" << std::endl;
+    else if (focus.present) {
+        if (!checkArray(focus, 3, "cameraData focus must be an array", "cameraData focus must have 3 elements",
+                        "cameraData focus must be a floating-point value")) {
             return false;
         }
+        m_cameraData.look = glm::vec4(focus.values[0], focus.values[1], focus.values[2], 1.f);
     }
 
     // Convert the focus point (stored in the look vector) into a
     // look vector from the camera position to that focus point.
-    if (cameradata.contains("focus")) {
+    if (focus.present) {
         m_cameraData.look -= m_cameraData.pos;
     }
 
     return true;
 }
 
-bool ScenefileReader::parseTemplateGroups(const QJsonValue &templateGroups) {
-    if (!templateGroups.isArray()) {
-        std::cout << "templateGroups must be an array" << std::endl;
+bool ScenefileReader::parseTemplateGroups(JsonStream &json) {
+    if (!expectType(json, JsonStream::Type::Array, "templateGroups must be an array")) {
         return false;
     }
 
-    QJsonArray templateGroupsArray = templateGroups.toArray();
-    for (auto templateGroup : templateGroupsArray) {
-        if (!templateGroup.isObject()) {
-            std::cout << "templateGroup items must be of type object" << std::endl;
+    // Groups from here on resolve template names as they are read
+    m_templatesRead = true;
+
+    json.beginArray();
+    while (json.nextElement()) {
+        if (!expectType(json, JsonStream::Type::Object, "templateGroup items must be of type object")) {
             return false;
         }
 
-        if (!parseTemplateGroupData(templateGroup.toObject())) {
+        if (!parseTemplateGroupData(json)) {
             return false;
         }
     }
 
-    return true;
+    return !json.failed();
 }
 
-bool ScenefileReader::parseTemplateGroupData(const QJsonObject &templateGroup) {
-    QStringList requiredFields = {"name"};
-    QStringList optionalFields = {"translate", "rotate", "scale", "matrix", "lights", "primitives", "groups"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : templateGroup.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on templateGroup object" << std::endl;
-            return false;
-        }
-    }
+bool ScenefileReader::parseTemplateGroupData(JsonStream &json) {
+    SceneNode *templateNode = create<SceneNode>();
 
-    for (auto &field : requiredFields) {
-        if (!templateGroup.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on templateGroup object" << std::endl;
-            return false;
-        }
+    std::string name;
+    SceneNode *reference = nullptr;
+    if (!parseGroupData(json, templateNode, true, name, reference)) {
+        return false;
     }
 
-    if (!templateGroup["name"].isString()) {
-        std::cout << "templateGroup name must be a string" << std::endl;
-    }
-    if (m_templates.contains(templateGroup["name"].toString().toStdString())) {
+    if (m_templates.contains(name)) {
         std::cout << "templateGroups cannot have the same" << std::endl;
     }
+    m_templates[name] = templateNode;
 
-    SceneNode *templateNode = new SceneNode;
-    m_nodes.push_back(templateNode);
-    m_templates[templateGroup["name"].toString().toStdString()] = templateNode;
-
-    return parseGroupData(templateGroup, templateNode);
+    return true;
 }
 
 /**
- * Parse a group object and create a new CS123SceneNode in m_nodes.
- * NAME OF NODE CANNOT REFERENCE TEMPLATE NODE
+ * Parse a group object into node. Group names that refer to a template stop the parse and
+ * return the template in reference instead; template names are only validated.
  */
-bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node) {
-    QStringList optionalFields = {"name", "translate", "rotate", "scale", "matrix", "lights", "primitives", "groups"};
-    QStringList allFields = optionalFields;
-    for (auto &field : object.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on group object" << std::endl;
+bool ScenefileReader::parseGroupData(JsonStream &json, SceneNode *node, bool isTemplate,
+                                     std::string &name, SceneNode *&reference) {
+    const char *objectName = isTemplate ? "templateGroup" : "group";
+    StringField nameField;
+    ArrayField translate, rotate, scale;
+    MatrixField matrix;
+
+    json.beginObject();
+    std::string_view key;
+    while (json.nextKey(key)) {
+        bool read = true;
+        switch (lookupKey(key)) {
+        case Key::Name:
+            if (!readField(json, nameField)) {
+                return false;
+            }
+            if (isTemplate) {
+                break;
+            }
+            if (!nameField.isString) {
+                std::cout << "group name must be of type string" << std::endl;
+                return false;
+            }
+
+            // if its a reference to a template, the rest of the group is ignored
+            if (auto found = m_templates.find(nameField.value); found != m_templates.end()) {
+                reference = found->second;
+                while (json.nextKey(key)) {
+                    if (!json.skipValue()) {
+                        return false;
+                    }
+                }
+                return !json.failed();
+            }
+            break;
+        case Key::Translate: read = readField(json, translate); break;
+        case Key::Rotate: read = readField(json, rotate); break;
+        case Key::Scale: read = readField(json, scale); break;
+        case Key::Matrix: read = readField(json, matrix); break;
+
+        // parse lights if any
+        case Key::Lights:
+            if (!expectType(json, JsonStream::Type::Array, "group lights must be of type array")) {
+                return false;
+            }
+            json.beginArray();
+            while (json.nextElement()) {
+                if (!expectType(json, JsonStream::Type::Object, "light must be of type object")) {
+                    return false;
+                }
+                if (!parseLightData(json, node)) {
+                    return false;
+                }
+            }
+            break;
+
+        // parse primitives if any
+        case Key::Primitives:
+            if (!expectType(json, JsonStream::Type::Array, "group primitives must be of type array")) {
+                return false;
+            }
+            json.beginArray();
+            while (json.nextElement()) {
+                if (!expectType(json, JsonStream::Type::Object, "primitive must be of type object")) {
+                    return false;
+                }
+                if (!parsePrimitive(json, node)) {
+                    return false;
+                }
+            }
+            break;
+
+        // parse children groups if any
+        case Key::Groups:
+            read = parseGroups(json, node);
+            break;
+
+        default:
+            unknownField(key, objectName);
             return false;
         }
-    }
-
-    // parse translation if defined
-    if (object.contains("translate")) {
-        if (!object["translate"].isArray()) {
-            std::cout << "group translate must be of type array" << std::endl;
+        if (!read || json.failed()) {
             return false;
         }
+    }
+    if (json.failed()) {
+        return false;
+    }
 
-        QJsonArray translateArray = object["translate"].toArray();
-        if (translateArray.size() != 3) {
-            std::cout << "group translate must have 3 elements" << std::endl;
+    if (isTemplate) {
+        if (!nameField.present) {
+            missingField("name", "templateGroup");
             return false;
         }
-        if (!translateArray[0].isDouble() || !translateArray[1].isDouble() || !translateArray[2].isDouble()) {
-            std::cout << "group translate must contain floating-point values" << std::endl;
+        if (!nameField.isString) {
+            std::cout << "templateGroup name must be a string" << std::endl;
+        }
+    }
+    name = nameField.value;
+
+    // Transformations apply in this order whatever order the keys appear in
+    if (translate.present) {
+        if (!checkArray(translate, 3, "group translate must be of type array", "group translate must have 3 elements",
+                        "group translate must contain floating-point values")) {
             return false;
         }
 
-        SceneTransformation *translation = new SceneTransformation();
+        SceneTransformation *translation = create<SceneTransformation>();
         translation->type = TransformationType::TRANSFORMATION_TRANSLATE;
-        translation->translate.x = translateArray[0].toDouble();
-        translation->translate.y = translateArray[1].toDouble();
-        translation->translate.z = translateArray[2].toDouble();
+        translation->translate = glm::vec3(translate.values[0], translate.values[1], translate.values[2]);
 
         node->transformations.push_back(translation);
     }
 
-    // parse rotation if defined
-    if (object.contains("rotate")) {
-        if (!object["rotate"].isArray()) {
-            std::cout << "group rotate must be of type array" << std::endl;
-            return false;
-        }
-
-        QJsonArray rotateArray = object["rotate"].toArray();
-        if (rotateArray.size() != 4) {
-            std::cout << "group rotate must have 4 elements" << std::endl;
-            return false;
-        }
-        if (!rotateArray[0].isDouble() || !rotateArray[1].isDouble() || !rotateArray[2].isDouble() || !rotateArray[3].isDouble()) {
-            std::cout << "group rotate must contain floating-point values" << std::endl;
+    if (rotate.present) {
+        if (!checkArray(rotate, 4, "group rotate must be of type array", "group rotate must have 4 elements",
+                        "group rotate must contain floating-point values")) {
             return false;
         }
 
-        SceneTransformation *rotation = new SceneTransformation();
+        SceneTransformation *rotation = create<SceneTransformation>();
         rotation->type = TransformationType::TRANSFORMATION_ROTATE;
-        rotation->rotate.x = rotateArray[0].toDouble();
-        rotation->rotate.y = rotateArray[1].toDouble();
-        rotation->rotate.z = rotateArray[2].toDouble();
-        rotation->angle = rotateArray[3].toDouble() * M_PI / 180.f;
+        rotation->rotate = glm::vec3(rotate.values[0], rotate.values[1], rotate.values[2]);
+        rotation->angle = rotate.values[3] * M_PI / 180.f;
 
         node->transformations.push_back(rotation);
     }
 
-    // parse scale if defined
-    if (object.contains("scale")) {
-        if (!object["scale"].isArray()) {
-            std::cout << "group scale must be of type array" << std::endl;
-            return false;
-        }
-
-        QJsonArray scaleArray = object["scale"].toArray();
-        if (scaleArray.size() != 3) {
-            std::cout << "group scale must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!scaleArray[0].isDouble() || !scaleArray[1].isDouble() || !scaleArray[2].isDouble()) {
-            std::cout << "group scale must contain floating-point values" << std::endl;
+    if (scale.present) {
+        if (!checkArray(scale, 3, "group scale must be of type array", "group scale must have 3 elements",
+                        "group scale must contain floating-point values")) {
             return false;
         }
 
-        SceneTransformation *scale = new SceneTransformation();
-        scale->type = TransformationType::TRANSFORMATION_SCALE;
-        scale->scale.x = scaleArray[0].toDouble();
-        scale->scale.y = scaleArray[1].toDouble();
-        scale->scale.z = scaleArray[2].toDouble();
+        SceneTransformation *scaling = create<SceneTransformation>();
+        scaling->type = TransformationType::TRANSFORMATION_SCALE;
+        scaling->scale = glm::vec3(scale.values[0], scale.values[1], scale.values[2]);
 
-        node->transformations.push_back(scale);
+        node->transformations.push_back(scaling);
     }
 
-    // parse matrix if defined
-    if (object.contains("matrix")) {
-        if (!object["matrix"].isArray()) {
+    if (matrix.present) {
+        if (!matrix.isArray) {
             std::cout << "group matrix must be of type array of array" << std::endl;
             return false;
         }
-
-        QJsonArray matrixArray = object["matrix"].toArray();
-        if (matrixArray.size() != 4) {
+        if (matrix.rows != 4) {
             std::cout << "group matrix must be 4x4" << std::endl;
             return false;
         }
-
-        SceneTransformation *matrixTransformation = new SceneTransformation();
-        matrixTransformation->type = TransformationType::TRANSFORMATION_MATRIX;
-
-        float *matrixPtr = glm::value_ptr(matrixTransformation->matrix);
-        int rowIndex = 0;
-        for (auto row : matrixArray) {
-            if (!row.isArray()) {
-                std::cout << "group matrix must be of type array of array" << std::endl;
-                return false;
-            }
-
-            QJsonArray rowArray = row.toArray();
-            if (rowArray.size() != 4) {
-                std::cout << "group matrix must be 4x4" << std::endl;
-                return false;
-            }
-
-            int colIndex = 0;
-            for (auto val : rowArray) {
-                if (!val.isDouble()) {
-                    std::cout << "group matrix must contain all floating-point values" << std::endl;
-                    return false;
-                }
-
-                // fill in column-wise
-                matrixPtr[colIndex * 4 + rowIndex] = (float)val.toDouble();
-                colIndex++;
-            }
-            rowIndex++;
-        }
-
-        node->transformations.push_back(matrixTransformation);
-    }
-
-    // parse lights if any
-    if (object.contains("lights")) {
-        if (!object["lights"].isArray()) {
-            std::cout << "group lights must be of type array" << std::endl;
+        if (matrix.error != nullptr) {
+            std::cout << matrix.error << std::endl;
             return false;
         }
-        QJsonArray lightsArray = object["lights"].toArray();
-        for (auto light : lightsArray) {
-            if (!light.isObject()) {
-                std::cout << "light must be of type object" << std::endl;
-                return false;
-            }
-
-            if (!parseLightData(light.toObject(), node)) {
-                return false;
-            }
-        }
-    }
 
-    // parse primitives if any
-    if (object.contains("primitives")) {
-        if (!object["primitives"].isArray()) {
-            std::cout << "group primitives must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray primitivesArray = object["primitives"].toArray();
-        for (auto primitive : primitivesArray) {
-            if (!primitive.isObject()) {
-                std::cout << "primitive must be of type object" << std::endl;
-                return false;
-            }
-
-            if (!parsePrimitive(primitive.toObject(), node)) {
-                return false;
-            }
-        }
-    }
+        SceneTransformation *matrixTransformation = create<SceneTransformation>();
+        matrixTransformation->type = TransformationType::TRANSFORMATION_MATRIX;
+        matrixTransformation->matrix = matrix.matrix;
 
-    // parse children groups if any
-    if (object.contains("groups")) {
-        if (!parseGroups(object["groups"], node)) {
-            return false;
-        }
+        node->transformations.push_back(matrixTransformation);
     }
 
     return true;
 }
 
-bool ScenefileReader::parseGroups(const QJsonValue &groups, SceneNode *parent) {
-    if (!groups.isArray()) {
-        std::cout << "groups must be of type array" << std::endl;
+bool ScenefileReader::parseGroups(JsonStream &json, SceneNode *parent) {
+    if (!expectType(json, JsonStream::Type::Array, "groups must be of type array")) {
         return false;
     }
 
-    QJsonArray groupsArray = groups.toArray();
-    for (auto group : groupsArray) {
-        if (!group.isObject()) {
-            std::cout << "group items must be of type object" << std::endl;
+    json.beginArray();
+    while (json.nextElement()) {
+        if (!expectType(json, JsonStream::Type::Object, "group items must be of type object")) {
             return false;
         }
 
-        QJsonObject groupData = group.toObject();
-        if (groupData.contains("name")) {
-            if (!groupData["name"].isString()) {
-                std::cout << "group name must be of type string" << std::endl;
-                return false;
-            }
-
-            // if its a reference to a template group append it
-            std::string groupName = groupData["name"].toString().toStdString();
-            if (m_templates.contains(groupName)) {
-                parent->children.push_back(m_templates[groupName]);
-                continue;
-            }
-        }
-
-        SceneNode *node = new SceneNode;
-        m_nodes.push_back(node);
+        SceneNode *node = create<SceneNode>();
+        size_t child = parent->children.size();
         parent->children.push_back(node);
 
-        if (!parseGroupData(group.toObject(), node)) {
+        std::string name;
+        SceneNode *reference = nullptr;
+        if (!parseGroupData(json, node, false, name, reference)) {
             return false;
         }
+
+        // if its a reference to a template group append it instead
+        if (reference != nullptr) {
+            parent->children[child] = reference;
+        } else if (!name.empty() && !m_templatesRead) {
+            m_pendingReferences.push_back({parent, child, name});
+        }
     }
 
-    return true;
+    return !json.failed();
 }
 
 /**
  * Parse an <object type="primitive"> tag into node.
  */
-bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
-    QStringList requiredFields = {"type"};
-    QStringList optionalFields = {
-        "meshFile", "ambient", "diffuse", "specular", "reflective", "transparent", "shininess", "ior",
-        "blend", "textureFile", "textureU", "textureV", "bumpMapFile", "bumpMapU", "bumpMapV"};
-
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto field : prim.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on primitive object" << std::endl;
-            return false;
-        }
-    }
-    for (auto field : requiredFields) {
-        if (!prim.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on primitive object" << std::endl;
-            return false;
-        }
+bool ScenefileReader::parsePrimitive(JsonStream &json, SceneNode *node) {
+    StringField type, meshFile, textureFile, bumpMapFile;
+    ArrayField ambient, diffuse, specular, reflective, transparent;
+    NumberField shininess, ior, blend, textureU, textureV, bumpMapU, bumpMapV;
+
+    json.beginObject();
+    std::string_view key;
+    while (json.nextKey(key)) {
+        bool read;
+        switch (lookupKey(key)) {
+        case Key::Type: read = readField(json, type); break;
+        case Key::MeshFile: read = readField(json, meshFile); break;
+        case Key::Ambient: read = readField(json, ambient); break;
+        case Key::Diffuse: read = readField(json, diffuse); break;
+        case Key::Specular: read = readField(json, specular); break;
+        case Key::Reflective: read = readField(json, reflective); break;
+        case Key::Transparent: read = readField(json, transparent); break;
+        case Key::Shininess: read = readField(json, shininess); break;
+        case Key::Ior: read = readField(json, ior); break;
+        case Key::Blend: read = readField(json, blend); break;
+        case Key::TextureFile: read = readField(json, textureFile); break;
+        case Key::TextureU: read = readField(json, textureU); break;
+        case Key::TextureV: read = readField(json, textureV); break;
+        case Key::BumpMapFile: read = readField(json, bumpMapFile); break;
+        case Key::BumpMapU: read = readField(json, bumpMapU); break;
+        case Key::BumpMapV: read = readField(json, bumpMapV); break;
+        default:
+            unknownField(key, "primitive");
+            return false;
+        }
+        if (!read) {
+            return false;
+        }
+    }
+    if (json.failed()) {
+        return false;
     }
 
-    if (!prim["type"].isString()) {
+    if (!type.present) {
+        missingField("type", "primitive");
+        return false;
+    }
+    if (!type.isString) {
         std::cout << "primitive type must be of type string" << std::endl;
         return false;
     }
-    std::string primType = prim["type"].toString().toStdString();
+    const std::string &primType = type.value;
 
     // Default primitive
-    ScenePrimitive *primitive = new ScenePrimitive();
+    ScenePrimitive *primitive = create<ScenePrimitive>();
+    m_primitives.push_back(primitive);
     SceneMaterial &mat = primitive->material;
     mat.clear();
     primitive->type = PrimitiveType::PRIMITIVE_CUBE;
@@ -851,16 +1063,16 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
         primitive->type = PrimitiveType::PRIMITIVE_CONE;
     else if (primType == "mesh") {
         primitive->type = PrimitiveType::PRIMITIVE_MESH;
-        if (!prim.contains("meshFile")) {
+        if (!meshFile.present) {
             std::cout << "primitive type mesh must contain field meshFile" << std::endl;
             return false;
         }
-        if (!prim["meshFile"].isString()) {
+        if (!meshFile.isString) {
             std::cout << "primitive meshFile must be of type string" << std::endl;
             return false;
         }
 
-        std::filesystem::path relativePath(prim["meshFile"].toString().toStdString());
+        std::filesystem::path relativePath(meshFile.value);
         primitive->meshfile = (basepath / relativePath).string();
     }
     else {
@@ -868,161 +1080,103 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
         return false;
     }
 
-    if (prim.contains("ambient")) {
-        if (!prim["ambient"].isArray()) {
-            std::cout << "primitive ambient must be of type array" << std::endl;
+    if (ambient.present) {
+        if (!checkArray(ambient, 3, "primitive ambient must be of type array", "primitive ambient array must be of size 3",
+                        "primitive ambient must contain floating-point values")) {
             return false;
         }
-        QJsonArray ambientArray = prim["ambient"].toArray();
-        if (ambientArray.size() != 3) {
-            std::cout << "primitive ambient array must be of size 3" << std::endl;
-            return false;
-        }
-
         for (int i = 0; i < 3; i++) {
-            if (!ambientArray[i].isDouble()) {
-                std::cout << "primitive ambient must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cAmbient[i] = ambientArray[i].toDouble();
+            mat.cAmbient[i] = ambient.values[i];
         }
     }
 
-    if (prim.contains("diffuse")) {
-        if (!prim["diffuse"].isArray()) {
-            std::cout << "primitive diffuse must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray diffuseArray = prim["diffuse"].toArray();
-        if (diffuseArray.size() != 3) {
-            std::cout << "primitive diffuse array must be of size 3" << std::endl;
+    if (diffuse.present) {
+        if (!checkArray(diffuse, 3, "primitive diffuse must be of type array", "primitive diffuse array must be of size 3",
+                        "primitive diffuse must contain floating-point values")) {
             return false;
         }
-
         for (int i = 0; i < 3; i++) {
-            if (!diffuseArray[i].isDouble()) {
-                std::cout << "primitive diffuse must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cDiffuse[i] = diffuseArray[i].toDouble();
+            mat.cDiffuse[i] = diffuse.values[i];
         }
     }
 
-    if (prim.contains("specular")) {
-        if (!prim["specular"].isArray()) {
-            std::cout << "primitive specular must be of type array" << std::endl;
+    if (specular.present) {
+        if (!checkArray(specular, 3, "primitive specular must be of type array", "primitive specular array must be of size 3",
+                        "primitive specular must contain floating-point values")) {
             return false;
         }
-        QJsonArray specularArray = prim["specular"].toArray();
-        if (specularArray.size() != 3) {
-            std::cout << "primitive specular array must be of size 3" << std::endl;
-            return false;
-        }
-
         for (int i = 0; i < 3; i++) {
-            if (!specularArray[i].isDouble()) {
-                std::cout << "primitive specular must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cSpecular[i] = specularArray[i].toDouble();
+            mat.cSpecular[i] = specular.values[i];
         }
     }
 
-    if (prim.contains("reflective")) {
-        if (!prim["reflective"].isArray()) {
-            std::cout << "primitive reflective must be of type array" << std::endl;
+    if (reflective.present) {
+        if (!checkArray(reflective, 3, "primitive reflective must be of type array", "primitive reflective array must be of size 3",
+                        "primitive reflective must contain floating-point values")) {
             return false;
         }
-        QJsonArray reflectiveArray = prim["reflective"].toArray();
-        if (reflectiveArray.size() != 3) {
-            std::cout << "primitive reflective array must be of size 3" << std::endl;
-            return false;
-        }
-
         for (int i = 0; i < 3; i++) {
-            if (!reflectiveArray[i].isDouble()) {
-                std::cout << "primitive reflective must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cReflective[i] = reflectiveArray[i].toDouble();
+            mat.cReflective[i] = reflective.values[i];
         }
     }
 
-    if (prim.contains("transparent")) {
-        if (!prim["transparent"].isArray()) {
-            std::cout << "primitive transparent must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray transparentArray = prim["transparent"].toArray();
-        if (transparentArray.size() != 3) {
-            std::cout << "primitive transparent array must be of size 3" << std::endl;
+    if (transparent.present) {
+        if (!checkArray(transparent, 3, "primitive transparent must be of type array", "primitive transparent array must be of size 3",
+                        "primitive transparent must contain floating-point values")) {
             return false;
         }
-
         for (int i = 0; i < 3; i++) {
-            if (!transparentArray[i].isDouble()) {
-                std::cout << "primitive transparent must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cTransparent[i] = transparentArray[i].toDouble();
+            mat.cTransparent[i] = transparent.values[i];
         }
     }
 
-    if (prim.contains("shininess")) {
-        if (!prim["shininess"].isDouble()) {
+    if (shininess.present) {
+        if (!shininess.isNumber) {
             std::cout << "primitive shininess must be of type float" << std::endl;
             return false;
         }
-
-        mat.shininess = (float) prim["shininess"].toDouble();
+        mat.shininess = (float)shininess.value;
     }
 
-    if (prim.contains("ior")) {
-        if (!prim["ior"].isDouble()) {
+    if (ior.present) {
+        if (!ior.isNumber) {
             std::cout << "primitive ior must be of type float" << std::endl;
             return false;
         }
-
-        mat.ior = (float) prim["ior"].toDouble();
+        mat.ior = (float)ior.value;
     }
 
-    if (prim.contains("blend")) {
-        if (!prim["blend"].isDouble()) {
+    if (blend.present) {
+        if (!blend.isNumber) {
             std::cout << "primitive blend must be of type float" << std::endl;
             return false;
         }
-
-        mat.blend = (float)prim["blend"].toDouble();
+        mat.blend = (float)blend.value;
     }
 
-    if (prim.contains("textureFile")) {
-        if (!prim["textureFile"].isString()) {
+    if (textureFile.present) {
+        if (!textureFile.isString) {
             std::cout << "primitive textureFile must be of type string" << std::endl;
             return false;
         }
-        std::filesystem::path fileRelativePath(prim["textureFile"].toString().toStdString());
+        std::filesystem::path fileRelativePath(textureFile.value);
 
         mat.textureMap.filename = (basepath / fileRelativePath).string();
-        mat.textureMap.repeatU = prim.contains("textureU") && prim["textureU"].isDouble() ? prim["textureU"].toDouble() : 1;
-        mat.textureMap.repeatV = prim.contains("textureV") && prim["textureV"].isDouble() ? prim["textureV"].toDouble() : 1;
+        mat.textureMap.repeatU = textureU.isNumber ? textureU.value : 1;
+        mat.textureMap.repeatV = textureV.isNumber ? textureV.value : 1;
         mat.textureMap.isUsed = true;
     }
 
-    if (prim.contains("bumpMapFile")) {
-        if (!prim["bumpMapFile"].isString()) {
+    if (bumpMapFile.present) {
+        if (!bumpMapFile.isString) {
             std::cout << "primitive bumpMapFile must be of type string" << std::endl;
             return false;
         }
-        std::filesystem::path fileRelativePath(prim["bumpMapFile"].toString().toStdString());
+        std::filesystem::path fileRelativePath(bumpMapFile.value);
 
         mat.bumpMap.filename = (basepath / fileRelativePath).string();
-        mat.bumpMap.repeatU = prim.contains("bumpMapU") && prim["bumpMapU"].isDouble() ? prim["bumpMapU"].toDouble() : 1;
-        mat.bumpMap.repeatV = prim.contains("bumpMapV") && prim["bumpMapV"].isDouble() ? prim["bumpMapV"].toDouble() : 1;
+        mat.bumpMap.repeatU = bumpMapU.isNumber ? bumpMapU.value : 1;
+        mat.bumpMap.repeatV = bumpMapV.isNumber ? bumpMapV.value : 1;
         mat.bumpMap.isUsed = true;
     }
 
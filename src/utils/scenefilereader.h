@@ -2,11 +2,11 @@
 
 #include "scenedata.h"
 
+#include <memory_resource>
 #include <vector>
 #include <map>
 
-#include <QJsonDocument>
-#include <QJsonObject>
+class JsonStream;
 
 // This class parses the scene graph specified by the CS123 Xml file format.
 class ScenefileReader {
@@ -17,6 +17,9 @@ public:
     // Clean up all data for the scene
     ~ScenefileReader();
 
+    ScenefileReader(const ScenefileReader &) = delete;
+    ScenefileReader &operator=(const ScenefileReader &) = delete;
+
     // Parse the XML scene file. Returns false if scene is invalid.
     bool readJSON();
 
@@ -26,25 +29,48 @@ public:
 
     SceneNode *getRootNode() const;
 
+    // Root node of every templateGroup, by name. Groups that reference a template share this
+    // node as their child instead of holding a copy.
+    const std::map<std::string, SceneNode *> &getTemplates() const;
+
 private:
     // The filename should be contained within this parser implementation.
     // If you want to parse a new file, instantiate a different parser.
-    bool parseGlobalData(const QJsonObject &globaldata);
-    bool parseCameraData(const QJsonObject &cameradata);
-    bool parseTemplateGroups(const QJsonValue &templateGroups);
-    bool parseTemplateGroupData(const QJsonObject &templateGroup);
-    bool parseGroups(const QJsonValue &groups, SceneNode *parent);
-    bool parseGroupData(const QJsonObject &object, SceneNode *node);
-    bool parsePrimitive(const QJsonObject &prim, SceneNode *node);
-    bool parseLightData(const QJsonObject &lightData, SceneNode *node);
+    // Each parse function reads one value from the stream, building scene nodes as it goes
+    bool parseScenefile(JsonStream &json);
+    bool parseGlobalData(JsonStream &json);
+    bool parseCameraData(JsonStream &json);
+    bool parseTemplateGroups(JsonStream &json);
+    bool parseTemplateGroupData(JsonStream &json);
+    bool parseGroups(JsonStream &json, SceneNode *parent);
+    bool parseGroupData(JsonStream &json, SceneNode *node, bool isTemplate, std::string &name, SceneNode *&reference);
+    bool parsePrimitive(JsonStream &json, SceneNode *node);
+    bool parseLightData(JsonStream &json, SceneNode *node);
+
+    // Value-initialized T in m_arena
+    template <typename T>
+    T *create();
 
     std::string file_name;
 
     mutable std::map<std::string, SceneNode *> m_templates;
 
+    // Named groups read before "templateGroups"; resolved once the whole file has been read
+    struct PendingReference {
+        SceneNode *parent;
+        size_t child;
+        std::string name;
+    };
+    bool m_templatesRead = false;
+    std::vector<PendingReference> m_pendingReferences;
+
     SceneGlobalData m_globalData;
     SceneCameraData m_cameraData;
 
+    // Every node, transformation, primitive and light of the graph, and the arrays of every
+    // node, are bump-allocated from m_arena and released together with it
+    std::pmr::monotonic_buffer_resource m_arena;
+    std::pmr::vector<ScenePrimitive *> m_primitives{&m_arena};    // The only ones owning heap memory
+
     SceneNode *m_root;
-    std::vector<SceneNode *> m_nodes;
 };
@@ -0,0 +1,74 @@
+#include "sceneloader.h"
+
+SceneLoader::SceneLoader(QObject *parent) : QObject(parent) {}
+
+SceneLoader::~SceneLoader() {
+    // A load still running gives up at its next report instead of holding up the join
+    ++m_generation;
+}
+
+void SceneLoader::load(const std::string &filepath) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        generation = ++m_generation;
+        m_result.reset();
+    }
+    m_loading = true;
+    if (!m_pool) {
+        m_pool = std::make_unique<ThreadPool>(1);
+    }
+
+    m_pool->submit([this, generation, filepath] {
+        // Reports are posted to the loader's thread; returning false cancels the parse
+        auto report = [this, generation](int percent) {
+            if (m_generation != generation) {
+                return false;
+            }
+            QMetaObject::invokeMethod(this, [this, generation, percent] {
+                if (m_generation == generation) {
+                    emit progress(percent);
+                }
+            }, Qt::QueuedConnection);
+            return true;
+        };
+        if (!report(0)) {
+            return;
+        }
+
+        auto scene = std::make_unique<RenderData>();
+        bool ok = SceneParser::parse(filepath, *scene, true, report);
+        {
+            std::lock_guard<std::mutex> lock(m_resultMutex);
+            if (m_generation != generation) {
+                return;
+            }
+            if (ok) {
+                m_result = std::move(scene);
+            }
+        }
+        QMetaObject::invokeMethod(this, [this, generation, ok] {
+            if (m_generation == generation) {
+                m_loading = false;
+                emit finished(ok);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void SceneLoader::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        ++m_generation;
+        m_result.reset();
+    }
+    if (m_loading) {
+        m_loading = false;
+        emit finished(false);
+    }
+}
+
+std::unique_ptr<RenderData> SceneLoader::take() {
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    return std::move(m_result);
+}
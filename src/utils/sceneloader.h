@@ -0,0 +1,46 @@
+#pragma once
+
+#include "sceneparser.h"
+#include "threadpool.h"
+
+#include <QObject>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Loads scenefiles on a worker thread, so file I/O, parsing and flattening never block the GUI
+// thread. One load is current at a time: starting another, or cancel(), abandons the current
+// one at its next progress report and drops its result. progress() and finished() arrive on
+// the thread that owns the loader, and only for the current load; the scene is then collected
+// with take().
+class SceneLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SceneLoader(QObject *parent = nullptr);
+    ~SceneLoader();
+
+    void load(const std::string &filepath);
+    void cancel();
+    bool isLoading() const { return m_loading; }
+
+    // The scene of the current load once it has finished, a single time; null otherwise
+    std::unique_ptr<RenderData> take();
+
+signals:
+    void progress(int percent);
+    void finished(bool ok);
+
+private:
+    bool m_loading = false;
+    std::atomic<uint64_t> m_generation = 0;     // Of the current load; workers compare theirs to it
+
+    std::mutex m_resultMutex;
+    std::unique_ptr<RenderData> m_result;       // Guarded by m_resultMutex
+
+    // Declared last so it is destroyed (and a running load joined) before the state it writes to
+    std::unique_ptr<ThreadPool> m_pool;
+};
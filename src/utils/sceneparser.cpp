@@ -1,14 +1,177 @@
 #include "sceneparser.h"
 #include "scenefilereader.h"
+#include "scenecache.h"
+#include "threadpool.h"
+#include "transformhierarchy.h"
 #include <glm/gtx/transform.hpp>
 
-#include <chrono>
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
-void traverseDFS(const SceneNode* node, const glm::mat4 &currentTransform, RenderData &renderData) {
-    if (node == nullptr) {
-        return;
+void RenderShapes::push_back(const glm::mat4 &ctm, PrimitiveType type, uint32_t material, uint32_t meshfile) {
+    ctms.push_back(ctm);
+    types.push_back(type);
+    materials.push_back(material);
+    meshfiles.push_back(meshfile);
+}
+
+void RenderShapes::clear() {
+    ctms.clear();
+    types.clear();
+    materials.clear();
+    meshfiles.clear();
+}
+
+static bool sameFileMap(const SceneFileMap &a, const SceneFileMap &b) {
+    return a.isUsed == b.isUsed
+           && (!a.isUsed || (a.repeatU == b.repeatU && a.repeatV == b.repeatV && a.filename == b.filename));
+}
+
+bool sameMaterial(const SceneMaterial &a, const SceneMaterial &b) {
+    return a.cAmbient == b.cAmbient && a.cDiffuse == b.cDiffuse && a.cSpecular == b.cSpecular
+           && a.cReflective == b.cReflective && a.cTransparent == b.cTransparent && a.cEmissive == b.cEmissive
+           && a.shininess == b.shininess && a.ior == b.ior && a.blend == b.blend
+           && sameFileMap(a.textureMap, b.textureMap) && sameFileMap(a.bumpMap, b.bumpMap);
+}
+
+void RenderHierarchy::clear() {
+    parents.clear();
+    subtreeSizes.clear();
+    locals.clear();
+    firstShapes.clear();
+    firstLights.clear();
+    firstInstances.clear();
+    localLights.clear();
+    instanceNodes.clear();
+    dirty.clear();
+}
+
+void RenderHierarchy::computeSubtreeSizes() {
+    // Children come after their parents, so a backwards pass sees every subtree complete
+    subtreeSizes.assign(parents.size(), 1);
+    for (size_t i = parents.size(); i-- > 1;) {
+        subtreeSizes[parents[i]] += subtreeSizes[i];
+    }
+}
+
+namespace {
+
+void hashBytes(uint64_t &hash, const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+}
+
+void hashFileMap(uint64_t &hash, const SceneFileMap &map) {
+    hashBytes(hash, &map.isUsed, sizeof(map.isUsed));
+    if (map.isUsed) {
+        hashBytes(hash, &map.repeatU, sizeof(float));
+        hashBytes(hash, &map.repeatV, sizeof(float));
+        hashBytes(hash, map.filename.data(), map.filename.size());
+    }
+}
+
+uint64_t hashMaterial(const SceneMaterial &material) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const SceneColor *color : {&material.cAmbient, &material.cDiffuse, &material.cSpecular,
+                                    &material.cReflective, &material.cTransparent, &material.cEmissive}) {
+        hashBytes(hash, &(*color)[0], sizeof(SceneColor));
     }
+    for (const float *value : {&material.shininess, &material.ior, &material.blend}) {
+        hashBytes(hash, value, sizeof(float));
+    }
+    hashFileMap(hash, material.textureMap);
+    hashFileMap(hash, material.bumpMap);
+    return hash;
+}
+
+// Distinct materials and mesh paths in order of first use, with the hash of each material
+// kept so a table can be merged into another without hashing again
+class InternTable {
+public:
+    uint32_t material(const SceneMaterial &material, uint64_t hash) {
+        auto [begin, end] = m_materialIndices.equal_range(hash);
+        for (auto it = begin; it != end; ++it) {
+            if (sameMaterial(materials[it->second], material)) {
+                return it->second;
+            }
+        }
+        m_materialIndices.emplace(hash, uint32_t(materials.size()));
+        materials.push_back(material);
+        hashes.push_back(hash);
+        return materials.size() - 1;
+    }
+
+    uint32_t meshfile(const std::string &meshfile) {
+        auto [found, inserted] = m_meshfileIndices.try_emplace(meshfile, uint32_t(meshfiles.size()));
+        if (inserted) {
+            meshfiles.push_back(meshfile);
+        }
+        return found->second;
+    }
+
+    std::vector<SceneMaterial> materials;
+    std::vector<uint64_t> hashes;
+    std::vector<std::string> meshfiles;
+
+private:
+    std::unordered_multimap<uint64_t, uint32_t> m_materialIndices;
+    std::unordered_map<std::string, uint32_t> m_meshfileIndices;
+};
+
+// A template reference, before templates are numbered
+struct PendingInstance {
+    const SceneNode* node;
+    glm::mat4 ctm;
+};
+
+// A piece of the scene graph to flatten: one node without its children, a whole subtree, or
+// a reference to a template
+struct FlattenItem {
+    enum class Kind { Node, Subtree, Instance };
+
+    Kind kind;
+    const SceneNode* node;
+    glm::mat4 parentCtm;
+    int parentItem; // the Node item of the parent node, -1 for the root
+};
+
+// Output of a run of consecutive items, flattened by one worker. Shape material and mesh
+// indices refer to the chunk's table, its own unless it is the only chunk, until the chunks
+// are merged.
+struct FlattenChunk {
+    size_t begin;
+    size_t end;
+
+    RenderShapes shapes;
+    std::vector<SceneLightData> lights;
+    std::vector<PendingInstance> instances;
+    InternTable ownTable;
+    InternTable *table = &ownTable;
+
+    // Nodes of the hierarchy, if one is built. Until the merge, the parent of an item's first
+    // node and the node of an Instance item are the parent item, encoded by itemParent().
+    RenderHierarchy ownHierarchy;
+    RenderHierarchy *hierarchy = nullptr;
+    std::vector<int> itemNodes; // first node of each item, -1 for instances
+};
+
+int itemParent(int parentItem) {
+    return parentItem < 0 ? -1 : -2 - parentItem;
+}
+
+// The graph is split until there are this many items per thread (or nothing left to split),
+// and the items are grouped into CHUNKS_PER_THREAD chunks per thread to even out the load
+constexpr size_t ITEMS_PER_THREAD = 64;
+constexpr size_t CHUNKS_PER_THREAD = 8;
+
+glm::mat4 nodeTransform(const SceneNode* node, const glm::mat4 &currentTransform) {
     glm::mat4 ctm = currentTransform;
     //building cummulative transform
     for (const auto& transformation : node->transformations) {
@@ -29,64 +192,384 @@ void traverseDFS(const SceneNode* node, const glm::mat4 &currentTransform, Rende
             break;
         }
     }
-    // constructing RenderShapeData object using the primitive and its corresponding CTM
-    // append the RenderShapeData onto renderData.shapes
+    return ctm;
+}
+
+// constructing SceneLightData object for a light under the cumulative transform ctm
+SceneLightData nodeLight(const SceneLight &light, const glm::mat4 &ctm) {
+    // Value-initialized so fields the light's type leaves unset are zero, not garbage
+    SceneLightData lightData{};
+    lightData.id = light.id;
+    lightData.type = light.type;
+    lightData.color = light.color;
+    lightData.function = light.function;
+    lightData.dir = ctm * light.dir;
+    switch (light.type) {
+    case LightType::LIGHT_DIRECTIONAL:
+        lightData.dir = glm::normalize(ctm * light.dir);
+        break;
+    case LightType::LIGHT_POINT:
+        lightData.pos = ctm * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        break;
+    case LightType::LIGHT_SPOT:
+        lightData.pos = ctm * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        lightData.dir = glm::normalize(ctm * light.dir);
+        lightData.penumbra = light.penumbra;
+        lightData.angle = light.angle;
+        break;
+    default:
+        break;
+    }
+    return lightData;
+}
+
+// Appends node's own primitives and lights, with its cumulative transform ctm, onto chunk
+void emitNode(const SceneNode* node, const glm::mat4 &ctm, FlattenChunk &chunk) {
     for (const auto &primitive : node->primitives) {
-        RenderShapeData shapeData;
-        shapeData.primitive = *primitive;
-        shapeData.ctm = ctm;
-        renderData.shapes.push_back(shapeData);
+        uint32_t material = chunk.table->material(primitive->material, hashMaterial(primitive->material));
+        uint32_t meshfile = primitive->type == PrimitiveType::PRIMITIVE_MESH
+                                ? chunk.table->meshfile(primitive->meshfile) : NO_MESHFILE;
+        chunk.shapes.push_back(ctm, primitive->type, material, meshfile);
     }
-    // constructing SceneLightData object for renderData.lights
     for (const auto &light : node->lights) {
-        SceneLightData lightData;
-        lightData.id = light->id;
-        lightData.type = light->type;
-        lightData.color = light->color;
-        lightData.function = light->function;
-        lightData.dir = ctm * light->dir;
-        switch (light->type) {
-        case LightType::LIGHT_DIRECTIONAL:
-            lightData.dir = glm::normalize(ctm * light->dir);
-            break;
-        case LightType::LIGHT_POINT:
-            lightData.pos = ctm * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        chunk.lights.push_back(nodeLight(*light, ctm));
+    }
+}
+
+// Adds node, about to be emitted, to chunk's hierarchy under parent. Returns its index there,
+// or -1 if the chunk builds no hierarchy.
+int addNode(const SceneNode* node, int parent, FlattenChunk &chunk) {
+    RenderHierarchy *hierarchy = chunk.hierarchy;
+    if (hierarchy == nullptr) {
+        return -1;
+    }
+    hierarchy->parents.push_back(parent);
+    hierarchy->locals.push_back(nodeTransform(node, glm::mat4(1.0f)));
+    hierarchy->firstShapes.push_back(chunk.shapes.size());
+    hierarchy->firstLights.push_back(chunk.lights.size());
+    hierarchy->firstInstances.push_back(chunk.instances.size());
+    for (const auto &light : node->lights) {
+        hierarchy->localLights.push_back(nodeLight(*light, glm::mat4(1.0f)));
+    }
+    return hierarchy->size() - 1;
+}
+
+void addInstance(const SceneNode* templateNode, const glm::mat4 &ctm, int parent, FlattenChunk &chunk) {
+    chunk.instances.push_back({templateNode, ctm});
+    if (chunk.hierarchy != nullptr) {
+        chunk.hierarchy->instanceNodes.push_back(parent);
+    }
+}
+
+bool isTemplate(const SceneNode* node, const std::unordered_set<const SceneNode*> *templates) {
+    return templates != nullptr && templates->contains(node);
+}
+
+// Flattens node's subtree into chunk, under the hierarchy node parent. References to a
+// template node are recorded as instances rather than descended into; without templates,
+// every subtree is expanded in place.
+void traverseDFS(const SceneNode* node, const glm::mat4 &currentTransform, FlattenChunk &chunk,
+                 const std::unordered_set<const SceneNode*> *templates, int parent) {
+    if (node == nullptr) {
+        return;
+    }
+    glm::mat4 ctm = nodeTransform(node, currentTransform);
+    int index = addNode(node, parent, chunk);
+    emitNode(node, ctm, chunk);
+    // recursively descending tree
+    for (const SceneNode* child : node->children) {
+        if (isTemplate(child, templates)) {
+            addInstance(child, ctm, index, chunk);
+        } else {
+            traverseDFS(child, ctm, chunk, templates, index);
+        }
+    }
+}
+
+// Splits the graph under root into items in depth-first order, a level at a time, until there
+// are at least target items. Flattening the items in order visits everything in the same
+// order as one traversal of root would.
+std::vector<FlattenItem> partition(const SceneNode* root, const std::unordered_set<const SceneNode*> *templates,
+                                   size_t target) {
+    using Kind = FlattenItem::Kind;
+    std::vector<FlattenItem> items = {{Kind::Subtree, root, glm::mat4(1.0f), -1}};
+    bool split = true;
+    while (split && items.size() < target) {
+        split = false;
+        std::vector<FlattenItem> next;
+        next.reserve(items.size() * 2);
+        // Items are renumbered; a parent always comes before its children, so it has been already
+        std::vector<int> newIndices(items.size());
+        for (size_t i = 0; i < items.size(); i++) {
+            FlattenItem item = items[i];
+            if (item.parentItem >= 0) {
+                item.parentItem = newIndices[item.parentItem];
+            }
+            newIndices[i] = next.size();
+            if (item.kind != Kind::Subtree || item.node->children.empty()) {
+                next.push_back(item);
+                continue;
+            }
+            next.push_back({Kind::Node, item.node, item.parentCtm, item.parentItem});
+            glm::mat4 ctm = nodeTransform(item.node, item.parentCtm);
+            for (const SceneNode* child : item.node->children) {
+                next.push_back({isTemplate(child, templates) ? Kind::Instance : Kind::Subtree, child, ctm, newIndices[i]});
+            }
+            split = true;
+        }
+        items = std::move(next);
+    }
+    return items;
+}
+
+void flattenChunk(const std::vector<FlattenItem> &items, FlattenChunk &chunk,
+                  const std::unordered_set<const SceneNode*> *templates) {
+    for (size_t i = chunk.begin; i < chunk.end; i++) {
+        const FlattenItem &item = items[i];
+        int parent = itemParent(item.parentItem);
+        int firstNode = chunk.hierarchy != nullptr ? int(chunk.hierarchy->size()) : -1;
+        switch (item.kind) {
+        case FlattenItem::Kind::Node:
+            // The children follow as items of their own
+            addNode(item.node, parent, chunk);
+            emitNode(item.node, nodeTransform(item.node, item.parentCtm), chunk);
             break;
-        case LightType::LIGHT_SPOT:
-            lightData.pos = ctm * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-            lightData.dir = glm::normalize(ctm * light->dir);
-            lightData.penumbra = light->penumbra;
-            lightData.angle = light->angle;
+        case FlattenItem::Kind::Subtree:
+            traverseDFS(item.node, item.parentCtm, chunk, templates, parent);
             break;
-        default:
+        case FlattenItem::Kind::Instance:
+            addInstance(item.node, item.parentCtm, parent, chunk);
+            firstNode = -1;
             break;
         }
-        renderData.lights.push_back(lightData);
+        chunk.itemNodes.push_back(firstNode);
     }
-    // recursively descending tree
-    for (const SceneNode* child : node->children) {
-        traverseDFS(child, ctm, renderData);
+}
+
+// Flattens the graph under root into shapes, lights and (when templates is set) instances,
+// interning materials and mesh paths into table, and into hierarchy if it is given. With a
+// pool the graph is split into chunks flattened in parallel, each into buffers of its own; the
+// chunks are then merged in order, at offsets given by prefix sums of their sizes, so the
+// result is the same for any number of threads.
+void flattenGraph(const SceneNode* root, const std::unordered_set<const SceneNode*> *templates, ThreadPool *pool,
+                  InternTable &table, RenderShapes &shapes, std::vector<SceneLightData> &lights,
+                  std::vector<PendingInstance> *instances, RenderHierarchy *hierarchy) {
+    if (root == nullptr) {
+        return;
+    }
+    size_t threads = pool != nullptr ? pool->size() : 1;
+    std::vector<FlattenItem> items = pool != nullptr
+        ? partition(root, templates, threads * ITEMS_PER_THREAD)
+        : std::vector<FlattenItem>{{FlattenItem::Kind::Subtree, root, glm::mat4(1.0f), -1}};
+
+    size_t chunkCount = std::min(items.size(), threads * CHUNKS_PER_THREAD);
+    std::vector<FlattenChunk> chunks(chunkCount);
+    for (size_t c = 0; c < chunkCount; c++) {
+        chunks[c].begin = items.size() * c / chunkCount;
+        chunks[c].end = items.size() * (c + 1) / chunkCount;
+    }
+    if (chunkCount == 1) {
+        // Nothing to merge: intern straight into table and emit straight into the outputs
+        FlattenChunk &chunk = chunks[0];
+        chunk.table = &table;
+        chunk.hierarchy = hierarchy;
+        std::swap(chunk.shapes, shapes);
+        std::swap(chunk.lights, lights);
+        flattenChunk(items, chunk, templates);
+        std::swap(chunk.shapes, shapes);
+        std::swap(chunk.lights, lights);
+        if (instances != nullptr) {
+            instances->insert(instances->end(), chunk.instances.begin(), chunk.instances.end());
+        }
+        return;
+    }
+    auto forEachChunk = [&](const std::function<void(FlattenChunk &)> &fn) {
+        for (FlattenChunk &chunk : chunks) {
+            pool->submit([&fn, &chunk] { fn(chunk); });
+        }
+        pool->wait();
+    };
+    if (hierarchy != nullptr) {
+        for (FlattenChunk &chunk : chunks) {
+            chunk.hierarchy = &chunk.ownHierarchy;
+        }
+    }
+    forEachChunk([&](FlattenChunk &chunk) { flattenChunk(items, chunk, templates); });
+
+    // Interning the chunk tables in chunk order keeps first-use order, then each chunk's
+    // shapes are copied to their place with their indices translated
+    std::vector<std::vector<uint32_t>> materialMaps(chunkCount);
+    std::vector<std::vector<uint32_t>> meshfileMaps(chunkCount);
+    std::vector<size_t> shapeOffsets(chunkCount + 1, shapes.size());
+    std::vector<size_t> lightOffsets(chunkCount + 1, lights.size());
+    std::vector<size_t> instanceOffsets(chunkCount + 1, instances != nullptr ? instances->size() : 0);
+    std::vector<size_t> nodeOffsets(chunkCount + 1, hierarchy != nullptr ? hierarchy->size() : 0);
+    for (size_t c = 0; c < chunkCount; c++) {
+        const InternTable &chunkTable = chunks[c].ownTable;
+        for (size_t i = 0; i < chunkTable.materials.size(); i++) {
+            materialMaps[c].push_back(table.material(chunkTable.materials[i], chunkTable.hashes[i]));
+        }
+        for (const std::string &meshfile : chunkTable.meshfiles) {
+            meshfileMaps[c].push_back(table.meshfile(meshfile));
+        }
+        shapeOffsets[c + 1] = shapeOffsets[c] + chunks[c].shapes.size();
+        lightOffsets[c + 1] = lightOffsets[c] + chunks[c].lights.size();
+        instanceOffsets[c + 1] = instanceOffsets[c] + chunks[c].instances.size();
+        nodeOffsets[c + 1] = nodeOffsets[c] + chunks[c].ownHierarchy.size();
+    }
+
+    // Hierarchy references to another item become node indices once every chunk's first node
+    // is known
+    std::vector<int> itemNodes(items.size(), -1);
+    for (size_t c = 0; c < chunkCount; c++) {
+        for (size_t i = 0; i < chunks[c].itemNodes.size(); i++) {
+            if (chunks[c].itemNodes[i] >= 0) {
+                itemNodes[chunks[c].begin + i] = nodeOffsets[c] + chunks[c].itemNodes[i];
+            }
+        }
+    }
+    auto globalNode = [&](int node, size_t c) {
+        return node >= 0 ? int(nodeOffsets[c] + node) : node == -1 ? -1 : itemNodes[-2 - node];
+    };
+    if (hierarchy != nullptr) {
+        hierarchy->parents.resize(nodeOffsets[chunkCount]);
+        hierarchy->locals.resize(nodeOffsets[chunkCount]);
+        hierarchy->firstShapes.resize(nodeOffsets[chunkCount]);
+        hierarchy->firstLights.resize(nodeOffsets[chunkCount]);
+        hierarchy->firstInstances.resize(nodeOffsets[chunkCount]);
+    }
+
+    shapes.ctms.resize(shapeOffsets[chunkCount]);
+    shapes.types.resize(shapeOffsets[chunkCount]);
+    shapes.materials.resize(shapeOffsets[chunkCount]);
+    shapes.meshfiles.resize(shapeOffsets[chunkCount]);
+    forEachChunk([&](FlattenChunk &chunk) {
+        size_t c = &chunk - chunks.data();
+        size_t offset = shapeOffsets[c];
+        const RenderShapes &source = chunk.shapes;
+        std::copy(source.ctms.begin(), source.ctms.end(), shapes.ctms.begin() + offset);
+        std::copy(source.types.begin(), source.types.end(), shapes.types.begin() + offset);
+        for (size_t i = 0; i < source.size(); i++) {
+            shapes.materials[offset + i] = materialMaps[c][source.materials[i]];
+            shapes.meshfiles[offset + i] = source.meshfiles[i] != NO_MESHFILE
+                                               ? meshfileMaps[c][source.meshfiles[i]] : NO_MESHFILE;
+        }
+        chunk.shapes = RenderShapes();
+
+        if (hierarchy != nullptr) {
+            const RenderHierarchy &nodes = chunk.ownHierarchy;
+            size_t nodeOffset = nodeOffsets[c];
+            std::copy(nodes.locals.begin(), nodes.locals.end(), hierarchy->locals.begin() + nodeOffset);
+            for (size_t i = 0; i < nodes.size(); i++) {
+                hierarchy->parents[nodeOffset + i] = globalNode(nodes.parents[i], c);
+                hierarchy->firstShapes[nodeOffset + i] = offset + nodes.firstShapes[i];
+                hierarchy->firstLights[nodeOffset + i] = lightOffsets[c] + nodes.firstLights[i];
+                hierarchy->firstInstances[nodeOffset + i] = instanceOffsets[c] + nodes.firstInstances[i];
+            }
+        }
+    });
+
+    // Lights and instances are few; they are appended in chunk order
+    for (size_t c = 0; c < chunkCount; c++) {
+        FlattenChunk &chunk = chunks[c];
+        lights.insert(lights.end(), chunk.lights.begin(), chunk.lights.end());
+        if (instances != nullptr) {
+            instances->insert(instances->end(), chunk.instances.begin(), chunk.instances.end());
+        }
+        if (hierarchy != nullptr) {
+            const RenderHierarchy &nodes = chunk.ownHierarchy;
+            hierarchy->localLights.insert(hierarchy->localLights.end(), nodes.localLights.begin(), nodes.localLights.end());
+            for (int node : nodes.instanceNodes) {
+                hierarchy->instanceNodes.push_back(globalNode(node, c));
+            }
+        }
     }
 }
 
-bool SceneParser::parse(std::string filepath, RenderData &renderData) {
-    ScenefileReader fileReader = ScenefileReader(filepath);
-    bool success = fileReader.readJSON();
-    if (!success) {
-        return false;
+}
+
+void SceneParser::flatten(const ScenefileReader &fileReader, RenderData &renderData, int threads) {
+    if (threads <= 0) {
+        threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 1) {
+        pool = std::make_unique<ThreadPool>(threads);
     }
 
-    // TODO: Use your Lab 5 code here
     renderData.globalData = fileReader.getGlobalData();
     renderData.cameraData = fileReader.getCameraData();
 
-    SceneNode* rootNode = fileReader.getRootNode();
-    glm::mat4 identity = glm::mat4(1.0f); //initialize identity matrix
-
     renderData.shapes.clear();
     renderData.lights.clear();
+    renderData.templates.clear();
+    renderData.instances.clear();
+    renderData.hierarchy.clear();
+
+    std::unordered_set<const SceneNode*> templateNodes;
+    for (const auto &[name, node] : fileReader.getTemplates()) {
+        templateNodes.insert(node);
+    }
+    InternTable table;
+    std::vector<PendingInstance> pending;
+    RenderHierarchy &hierarchy = renderData.hierarchy;
+    flattenGraph(fileReader.getRootNode(), &templateNodes, pool.get(), table, renderData.shapes,
+                 renderData.lights, &pending, &hierarchy);
+    hierarchy.firstShapes.push_back(renderData.shapes.size());
+    hierarchy.firstLights.push_back(renderData.lights.size());
+    hierarchy.firstInstances.push_back(pending.size());
+    hierarchy.computeSubtreeSizes();
+
+    // Templates are numbered, and flattened once, in order of first reference. References
+    // nested inside a template are expanded into its definition, so only the outermost ones
+    // become instances.
+    std::unordered_map<const SceneNode*, int> templateIndices;
+    for (const PendingInstance &instance : pending) {
+        auto [found, inserted] = templateIndices.try_emplace(instance.node, int(renderData.templates.size()));
+        if (inserted) {
+            RenderTemplate &added = renderData.templates.emplace_back();
+            flattenGraph(instance.node, nullptr, pool.get(), table, added.shapes, added.lights, nullptr, nullptr);
+        }
+        renderData.instances.push_back({found->second, instance.ctm});
+    }
 
-    traverseDFS(rootNode, identity, renderData);
+    // Lights are few and are selected per shape in world space, so instances get their own copies
+    for (const RenderInstance &instance : renderData.instances) {
+        for (const SceneLightData &light : renderData.templates[instance.templateIndex].lights) {
+            renderData.lights.push_back(TransformHierarchy::transformLight(light, instance.ctm));
+        }
+    }
+
+    renderData.materials = std::move(table.materials);
+    renderData.meshfiles = std::move(table.meshfiles);
+}
+
+bool SceneParser::parse(std::string filepath, RenderData &renderData, bool useCache,
+                        const std::function<bool(int)> &progress) {
+    auto report = [&](int percent) { return !progress || progress(percent); };
+
+    // A compiled image that is current for this file replaces both reading and flattening
+    std::string cachefile = SceneCache::cachePath(filepath);
+    if (useCache && SceneCache::load(cachefile, filepath, renderData)) {
+        std::cout << "Finished reading " << cachefile << std::endl;
+        return report(100);
+    }
+
+    ScenefileReader fileReader = ScenefileReader(filepath);
+    bool success = fileReader.readJSON();
+    if (!success || !report(50)) {
+        return false;
+    }
+
+    // TODO: Use your Lab 5 code here
+    flatten(fileReader, renderData);
+    if (!report(90)) {
+        return false;
+    }
+
+    if (useCache && !SceneCache::write(cachefile, filepath, renderData)) {
+        std::cerr << "could not write scene cache " << cachefile << std::endl;
+    }
 
-    return true;
+    return report(100);
 }
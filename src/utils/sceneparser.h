@@ -1,13 +1,62 @@
 #pragma once
 
 #include "scenedata.h"
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <string>
 
-// Struct which contains data for a single primitive, to be used for rendering
-struct RenderShapeData {
-    ScenePrimitive primitive;
-    glm::mat4 ctm; // the cumulative transformation matrix
+constexpr uint32_t NO_MESHFILE = ~0u;
+
+// Flattened shapes as parallel arrays, one entry per shape in each. The per-shape data is only
+// what every frame touches: a transform, the primitive type, and indices into the material and
+// mesh path tables of RenderData, which hold each distinct value once.
+struct RenderShapes {
+    std::vector<glm::mat4> ctms; // the cumulative transformation matrices
+    std::vector<PrimitiveType> types;
+    std::vector<uint32_t> materials; // index into RenderData::materials
+    std::vector<uint32_t> meshfiles; // index into RenderData::meshfiles, NO_MESHFILE if not a mesh
+
+    size_t size() const { return ctms.size(); }
+    void push_back(const glm::mat4 &ctm, PrimitiveType type, uint32_t material, uint32_t meshfile);
+    void clear();
+};
+
+// The primitives of a templateGroup, flattened once. Each ctm is relative to the template
+// node's parent, so an instance's shapes are at instance.ctm * shape ctm.
+struct RenderTemplate {
+    RenderShapes shapes;
+    std::vector<SceneLightData> lights; // relative to the template node's parent, like the shapes
+};
+
+// One reference to a template
+struct RenderInstance {
+    int templateIndex;
+    glm::mat4 ctm; // the cumulative transformation matrix of the referencing group
+};
+
+// The groups of the scene outside any template, kept so they can be moved after flattening (see
+// TransformHierarchy). Nodes are in depth-first order: a node's parent comes before it, and its
+// subtree is the nodes [i, i + subtreeSizes[i]). Node i's own shapes and lights are those from
+// firstShapes[i] and firstLights[i] up to the entries of node i + 1. The template instances
+// anywhere under it are among those from firstInstances[i] up to that of node
+// i + subtreeSizes[i], which also takes in instances its ancestors reference after it.
+// The first arrays have one entry past the last node.
+struct RenderHierarchy {
+    std::vector<int> parents; // -1 for the root
+    std::vector<uint32_t> subtreeSizes;
+    std::vector<glm::mat4> locals; // each node's transformations, composed
+    std::vector<uint32_t> firstShapes; // into RenderData::shapes
+    std::vector<uint32_t> firstLights; // into RenderData::lights, whose scene lights come first
+    std::vector<uint32_t> firstInstances; // into RenderData::instances
+    std::vector<SceneLightData> localLights; // the scene lights, relative to their nodes
+    std::vector<int> instanceNodes; // the node referencing each instance
+
+    std::vector<uint32_t> dirty; // nodes whose local matrix changed since the last update
+
+    size_t size() const { return parents.size(); }
+    void clear();
+    void computeSubtreeSizes(); // from parents
 };
 
 // Struct which contains all the data needed to render a scene
@@ -15,15 +64,37 @@ struct RenderData {
     SceneGlobalData globalData;
     SceneCameraData cameraData;
 
-    std::vector<SceneLightData> lights;
-    std::vector<RenderShapeData> shapes;
+    std::vector<SceneLightData> lights; // including the lights of every instance, in world space
+    RenderShapes shapes; // shapes outside of any template instance
+
+    std::vector<RenderTemplate> templates;
+    std::vector<RenderInstance> instances;
+
+    RenderHierarchy hierarchy;
+
+    // Distinct materials and mesh paths of every shape, scene and template alike
+    std::vector<SceneMaterial> materials;
+    std::vector<std::string> meshfiles;
 };
 
+// Equal in every field that affects rendering; materials are interned by this
+bool sameMaterial(const SceneMaterial &a, const SceneMaterial &b);
+
+class ScenefileReader;
+
 class SceneParser {
 public:
     // Parse the scene and store the results in renderData.
     // @param filepath    The path of the scene file to load.
     // @param renderData  On return, this will contain the metadata of the loaded scene.
+    // @param useCache    Load from, and refresh, the compiled image next to the scene file.
+    // @param progress    If set, called with the percentage done between stages; returning
+    //                    false cancels the parse.
     // @return            A boolean value indicating whether the parse was successful.
-    static bool parse(std::string filepath, RenderData &renderData);
+    static bool parse(std::string filepath, RenderData &renderData, bool useCache = true,
+                      const std::function<bool(int)> &progress = nullptr);
+
+    // Flatten a scene graph that has been read into renderData. Subtrees are flattened on up to
+    // threads threads (<= 0 for one per core); the result does not depend on the thread count.
+    static void flatten(const ScenefileReader &fileReader, RenderData &renderData, int threads = 0);
 };
@@ -0,0 +1,199 @@
+#include "scenetools.h"
+
+#include "utils/scenecache.h"
+#include "utils/scenefilereader.h"
+#include "utils/sceneparser.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Runs parse iterations times and prints the best and mean time it reports, as throughput
+static void report(const char *name, int iterations, double megabytes, const std::function<double()> &parse) {
+    double best = 1e30;
+    double total = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        double ms = parse();
+        best = std::min(best, ms);
+        total += ms;
+    }
+    double mean = total / iterations;
+    std::cout << "  " << name << ": best " << best << " ms (" << megabytes / (best / 1000.0) << " MB/s), mean "
+              << mean << " ms (" << megabytes / (mean / 1000.0) << " MB/s)" << std::endl;
+}
+
+int runParseBenchmark(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " --parse-benchmark <scenefile> [iterations]" << std::endl;
+        return 1;
+    }
+    std::string scenefile = argv[2];
+    int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 10;
+
+    QFile file(scenefile.c_str());
+    if (!file.open(QFile::ReadOnly)) {
+        std::cerr << "could not open " << scenefile << std::endl;
+        return 1;
+    }
+    double megabytes = file.size() / (1024.0 * 1024.0);
+    file.close();
+
+    // One visible run first, so validation errors are not hidden by the timed runs
+    {
+        ScenefileReader reader(scenefile);
+        if (!reader.readJSON()) {
+            return 1;
+        }
+    }
+    std::cout << "Parsing " << megabytes << " MB, " << iterations << " iterations" << std::endl;
+
+    QElapsedTimer timer;
+    report("streaming reader", iterations, megabytes, [&] {
+        // Silence "Finished reading"; destroying the scene graph is not part of parsing
+        std::streambuf *output = std::cout.rdbuf(nullptr);
+        timer.start();
+        auto reader = std::make_unique<ScenefileReader>(scenefile);
+        reader->readJSON();
+        double ms = timer.nsecsElapsed() / 1e6;
+        std::cout.rdbuf(output);
+        return ms;
+    });
+    report("QJsonDocument (DOM only)", iterations, megabytes, [&] {
+        timer.start();
+        QFile domFile(scenefile.c_str());
+        domFile.open(QFile::ReadOnly);
+        QJsonDocument document = QJsonDocument::fromJson(domFile.readAll());
+        double ms = timer.nsecsElapsed() / 1e6;
+        return ms;
+    });
+    return 0;
+}
+
+int runSceneCompiler(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " --compile-scene <scenefile> [output]" << std::endl;
+        return 1;
+    }
+    std::string scenefile = argv[2];
+    std::string cachefile = argc > 3 ? argv[3] : SceneCache::cachePath(scenefile);
+
+    QElapsedTimer timer;
+    timer.start();
+    RenderData renderData;
+    if (!SceneParser::parse(scenefile, renderData, false)) {
+        return 1;
+    }
+    double parseMs = timer.nsecsElapsed() / 1e6;
+
+    if (!SceneCache::write(cachefile, scenefile, renderData)) {
+        std::cerr << "could not write " << cachefile << std::endl;
+        return 1;
+    }
+
+    timer.start();
+    RenderData compiled;
+    if (!SceneCache::load(cachefile, scenefile, compiled)) {
+        std::cerr << "could not load " << cachefile << " back" << std::endl;
+        return 1;
+    }
+    double loadMs = timer.nsecsElapsed() / 1e6;
+
+    std::cout << "Compiled " << renderData.shapes.size() << " shapes, " << renderData.templates.size()
+              << " templates with " << renderData.instances.size() << " instances, "
+              << renderData.materials.size() << " materials and " << renderData.lights.size()
+              << " lights into " << cachefile << std::endl;
+    std::cout << "  JSON parse and flatten: " << parseMs << " ms" << std::endl;
+    std::cout << "  compiled load: " << loadMs << " ms" << std::endl;
+    return 0;
+}
+
+// Same shapes, instances and tables, compared field by field
+static bool sameFlattening(const RenderData &a, const RenderData &b) {
+    auto sameShapes = [](const RenderShapes &x, const RenderShapes &y) {
+        return x.ctms == y.ctms && x.types == y.types && x.materials == y.materials && x.meshfiles == y.meshfiles;
+    };
+    if (!sameShapes(a.shapes, b.shapes) || a.templates.size() != b.templates.size()
+        || a.instances.size() != b.instances.size() || a.lights.size() != b.lights.size()
+        || a.materials.size() != b.materials.size() || a.meshfiles != b.meshfiles) {
+        return false;
+    }
+    for (size_t i = 0; i < a.templates.size(); i++) {
+        if (!sameShapes(a.templates[i].shapes, b.templates[i].shapes)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.instances.size(); i++) {
+        if (a.instances[i].templateIndex != b.instances[i].templateIndex || a.instances[i].ctm != b.instances[i].ctm) {
+            return false;
+        }
+    }
+    // Directional lights have no position
+    for (size_t i = 0; i < a.lights.size(); i++) {
+        const SceneLightData &x = a.lights[i];
+        const SceneLightData &y = b.lights[i];
+        if (x.type != y.type || x.dir != y.dir || (x.type != LightType::LIGHT_DIRECTIONAL && x.pos != y.pos)) {
+            return false;
+        }
+    }
+    const RenderHierarchy &x = a.hierarchy;
+    const RenderHierarchy &y = b.hierarchy;
+    return x.parents == y.parents && x.locals == y.locals && x.firstShapes == y.firstShapes
+           && x.firstLights == y.firstLights && x.firstInstances == y.firstInstances
+           && x.instanceNodes == y.instanceNodes;
+}
+
+int runFlattenBenchmark(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " --flatten-benchmark <scenefile> [max threads] [iterations]" << std::endl;
+        return 1;
+    }
+    std::string scenefile = argv[2];
+    int maxThreads = argc > 3 ? std::max(1, std::atoi(argv[3]))
+                              : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int iterations = argc > 4 ? std::max(1, std::atoi(argv[4])) : 5;
+
+    ScenefileReader reader(scenefile);
+    if (!reader.readJSON()) {
+        return 1;
+    }
+
+    RenderData reference;
+    SceneParser::flatten(reader, reference, 1);
+    std::cout << "Flattening " << reference.shapes.size() << " shapes, " << reference.instances.size()
+              << " instances, " << iterations << " iterations" << std::endl;
+
+    QElapsedTimer timer;
+    double serialMs = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        double best = 1e30;
+        for (int i = 0; i < iterations; i++) {
+            RenderData renderData;
+            timer.start();
+            SceneParser::flatten(reader, renderData, threads);
+            best = std::min(best, timer.nsecsElapsed() / 1e6);
+            if (i == 0 && !sameFlattening(reference, renderData)) {
+                std::cerr << "  " << threads << " threads: output differs from 1 thread" << std::endl;
+                return 1;
+            }
+        }
+        if (threads == 1) {
+            serialMs = best;
+        }
+        std::cout << "  " << threads << " threads: best " << best << " ms (" << serialMs / best << "x)" << std::endl;
+    }
+    return 0;
+}
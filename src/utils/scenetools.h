@@ -0,0 +1,20 @@
+#pragma once
+
+// Headless scene tools, run from main() before any window exists.
+
+// Times scenefile parsing and reports throughput.
+//   --parse-benchmark <scenefile> [iterations]
+// Runs the streaming ScenefileReader and, for reference, a QJsonDocument DOM build of the
+// same bytes, and prints the best and mean time of each in ms and MB/s.
+int runParseBenchmark(int argc, char *argv[]);
+
+// Compiles a scenefile into the binary image SceneParser loads instead of the JSON.
+//   --compile-scene <scenefile> [output]
+// The output defaults to SceneCache::cachePath(scenefile), where loads look for it.
+int runSceneCompiler(int argc, char *argv[]);
+
+// Times flattening of an already-read scenefile on 1 to max threads threads.
+//   --flatten-benchmark <scenefile> [max threads] [iterations]
+// Max threads defaults to the hardware concurrency. Each thread count's output is checked
+// against the single-threaded one, and the best time of each is printed with its speedup.
+int runFlattenBenchmark(int argc, char *argv[]);
@@ -0,0 +1,188 @@
+#include "shaderbuilder.h"
+#include "shaderloader.h"
+
+#include <iostream>
+
+void ShaderBuilder::initialize() {
+    if (GLEW_KHR_parallel_shader_compile) {
+        // 0xFFFFFFFF lets the driver pick as many compiler threads as it likes
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        m_parallel = true;
+    } else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        m_parallel = true;
+    } else {
+        m_parallel = false;
+    }
+    std::cout << "Parallel shader compile: " << (m_parallel ? "enabled" : "unavailable") << std::endl;
+}
+
+GLuint ShaderBuilder::compile(GLenum shaderType, const std::string &code) {
+    GLuint shaderID = glCreateShader(shaderType);
+    const char *codePtr = code.c_str();
+    glShaderSource(shaderID, 1, &codePtr, nullptr);
+    glCompileShader(shaderID);
+    // Deliberately no GL_COMPILE_STATUS query here, it would wait for the compile
+    return shaderID;
+}
+
+int ShaderBuilder::request(const char *vertexPath, const char *fragmentPath,
+                           const std::vector<std::string> &defines) {
+    return request(vertexPath, nullptr, nullptr, fragmentPath, defines);
+}
+
+int ShaderBuilder::request(const char *vertexPath, const char *controlPath, const char *evaluationPath,
+                           const char *fragmentPath, const std::vector<std::string> &defines) {
+    bool tessellated = controlPath != nullptr && evaluationPath != nullptr;
+    std::string name = std::string(vertexPath) + "|" + fragmentPath;
+    if (tessellated) {
+        name += std::string("|") + controlPath + "|" + evaluationPath;
+    }
+    for (const std::string &define : defines) {
+        name += "|" + define;
+    }
+
+    auto it = m_handles.find(name);
+    if (it != m_handles.end()) {
+        return it->second;
+    }
+
+    ProgramBuild build;
+    build.name = name;
+    build.program = 0;
+    build.vertexShader = 0;
+    build.controlShader = 0;
+    build.evaluationShader = 0;
+    build.fragmentShader = 0;
+    build.state = BuildState::BUILD_PENDING;
+
+    try {
+        std::string vertexCode = ShaderLoader::readShaderSource(vertexPath, defines);
+        std::string fragmentCode = ShaderLoader::readShaderSource(fragmentPath, defines);
+
+        build.vertexShader = compile(GL_VERTEX_SHADER, vertexCode);
+        build.fragmentShader = compile(GL_FRAGMENT_SHADER, fragmentCode);
+        if (tessellated) {
+            build.controlShader = compile(GL_TESS_CONTROL_SHADER, ShaderLoader::readShaderSource(controlPath, defines));
+            build.evaluationShader = compile(GL_TESS_EVALUATION_SHADER,
+                                             ShaderLoader::readShaderSource(evaluationPath, defines));
+        }
+
+        // Linking can be issued before the compiles finish, the driver chains them
+        build.program = glCreateProgram();
+        glAttachShader(build.program, build.vertexShader);
+        glAttachShader(build.program, build.fragmentShader);
+        if (tessellated) {
+            glAttachShader(build.program, build.controlShader);
+            glAttachShader(build.program, build.evaluationShader);
+        }
+        glLinkProgram(build.program);
+    } catch (const std::runtime_error &e) {
+        std::cerr << "Failed to build shader " << name << ": " << e.what() << std::endl;
+        build.state = BuildState::BUILD_FAILED;
+    }
+
+    int handle = m_builds.size();
+    m_builds.push_back(build);
+    m_handles[name] = handle;
+    return handle;
+}
+
+void ShaderBuilder::finish(ProgramBuild &build) {
+    GLint status;
+    glGetProgramiv(build.program, GL_LINK_STATUS, &status);
+
+    if (status == GL_FALSE) {
+        std::cerr << "Failed to build shader " << build.name << std::endl;
+        for (GLuint shaderID : {build.vertexShader, build.controlShader, build.evaluationShader, build.fragmentShader}) {
+            if (shaderID == 0) {
+                continue;
+            }
+            GLint compiled;
+            glGetShaderiv(shaderID, GL_COMPILE_STATUS, &compiled);
+            if (compiled == GL_FALSE) {
+                GLint length;
+                glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &length);
+                std::string log(length, '\0');
+                glGetShaderInfoLog(shaderID, length, nullptr, &log[0]);
+                std::cerr << log << std::endl;
+            }
+        }
+
+        GLint length;
+        glGetProgramiv(build.program, GL_INFO_LOG_LENGTH, &length);
+        std::string log(length, '\0');
+        glGetProgramInfoLog(build.program, length, nullptr, &log[0]);
+        std::cerr << log << std::endl;
+
+        glDeleteProgram(build.program);
+        build.program = 0;
+        build.state = BuildState::BUILD_FAILED;
+    } else {
+        build.state = BuildState::BUILD_READY;
+    }
+
+    // Shaders no longer necessary, stored in program
+    glDeleteShader(build.vertexShader);
+    glDeleteShader(build.controlShader);
+    glDeleteShader(build.evaluationShader);
+    glDeleteShader(build.fragmentShader);
+    build.vertexShader = 0;
+    build.controlShader = 0;
+    build.evaluationShader = 0;
+    build.fragmentShader = 0;
+}
+
+void ShaderBuilder::poll() {
+    for (ProgramBuild &build : m_builds) {
+        if (build.state != BuildState::BUILD_PENDING) {
+            continue;
+        }
+
+        if (m_parallel) {
+            GLint done;
+            glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+            if (done == GL_TRUE) {
+                finish(build);
+            }
+        } else {
+            // Without the extension the status query blocks, so only pay for one per frame
+            finish(build);
+            return;
+        }
+    }
+}
+
+GLuint ShaderBuilder::get(int handle, GLuint fallback) const {
+    if (handle < 0 || handle >= static_cast<int>(m_builds.size())) {
+        return fallback;
+    }
+    const ProgramBuild &build = m_builds[handle];
+    return build.state == BuildState::BUILD_READY ? build.program : fallback;
+}
+
+bool ShaderBuilder::isReady(int handle) const {
+    return handle >= 0 && handle < static_cast<int>(m_builds.size())
+           && m_builds[handle].state == BuildState::BUILD_READY;
+}
+
+bool ShaderBuilder::hasPending() const {
+    for (const ProgramBuild &build : m_builds) {
+        if (build.state == BuildState::BUILD_PENDING) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShaderBuilder::clear() {
+    for (ProgramBuild &build : m_builds) {
+        if (build.vertexShader) glDeleteShader(build.vertexShader);
+        if (build.controlShader) glDeleteShader(build.controlShader);
+        if (build.evaluationShader) glDeleteShader(build.evaluationShader);
+        if (build.fragmentShader) glDeleteShader(build.fragmentShader);
+        if (build.program) glDeleteProgram(build.program);
+    }
+    m_builds.clear();
+    m_handles.clear();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Builds shader programs without stalling the GUI thread on the driver.
+// request() issues the compiles and the link immediately and returns a handle; poll() is
+// then called once per frame and promotes finished programs to ready. With
+// KHR_parallel_shader_compile the driver compiles on its own threads and poll() only asks
+// GL_COMPLETION_STATUS. Without it, poll() resolves at most one program per call so a
+// burst of variants is spread over several frames instead of freezing one.
+class ShaderBuilder
+{
+public:
+    // Must be called with a current context, after glewInit()
+    void initialize();
+
+    // Starts building a program. Requests for the same sources and defines share a handle.
+    int request(const char *vertexPath, const char *fragmentPath,
+                const std::vector<std::string> &defines = {});
+
+    // Same, with tessellation control and evaluation stages between the vertex and fragment ones
+    int request(const char *vertexPath, const char *controlPath, const char *evaluationPath,
+                const char *fragmentPath, const std::vector<std::string> &defines = {});
+
+    // Checks in-flight programs; call once per frame with the context current
+    void poll();
+
+    // Returns the program for handle if it finished linking, otherwise fallback
+    GLuint get(int handle, GLuint fallback) const;
+
+    bool isReady(int handle) const;
+    bool hasPending() const;
+
+    // Deletes every program and shader owned by the builder
+    void clear();
+
+private:
+    enum class BuildState {
+        BUILD_PENDING,
+        BUILD_READY,
+        BUILD_FAILED
+    };
+
+    struct ProgramBuild {
+        std::string name;
+        GLuint program;
+        GLuint vertexShader;
+        GLuint controlShader;                   // 0 without tessellation
+        GLuint evaluationShader;                // Same
+        GLuint fragmentShader;
+        BuildState state;
+    };
+
+    GLuint compile(GLenum shaderType, const std::string &code);
+    void finish(ProgramBuild &build);
+
+    std::vector<ProgramBuild> m_builds;
+    std::map<std::string, int> m_handles;
+    bool m_parallel = false;
+};
@@ -8,6 +8,8 @@
 #include <QFile>
 #include <QTextStream>
 #include <iostream>
+#include <string>
+#include <vector>
 
 class ShaderLoader{
 public:
@@ -44,11 +46,9 @@ public:
         return programID;
     }
 
-private:
-    static GLuint createShader(GLenum shaderType, const char *filepath){
-        GLuint shaderID = glCreateShader(shaderType);
-
-        // Read shader file.
+    // Reads a shader file and injects a `#define` for each entry of defines right after
+    // the `#version` line, so one source file can be compiled into several variants.
+    static std::string readShaderSource(const char *filepath, const std::vector<std::string> &defines = {}){
         std::string code;
         QString filepathStr = QString(filepath);
         QFile file(filepathStr);
@@ -59,6 +59,37 @@ private:
             throw std::runtime_error(std::string("Failed to open shader: ")+filepath);
         }
 
+        if (defines.empty()) {
+            return code;
+        }
+
+        std::string header;
+        for (const std::string &define : defines) {
+            header += "#define " + define + "\n";
+        }
+
+        // #version must stay the first statement of the shader
+        size_t insertPos = 0;
+        size_t versionPos = code.find("#version");
+        if (versionPos != std::string::npos) {
+            size_t lineEnd = code.find('\n', versionPos);
+            if (lineEnd == std::string::npos) {
+                code += '\n';
+                lineEnd = code.size() - 1;
+            }
+            insertPos = lineEnd + 1;
+        }
+        code.insert(insertPos, header);
+        return code;
+    }
+
+private:
+    static GLuint createShader(GLenum shaderType, const char *filepath){
+        GLuint shaderID = glCreateShader(shaderType);
+
+        // Read shader file.
+        std::string code = readShaderSource(filepath);
+
         // Compile shader code.
         const char *codePtr = code.c_str();
         glShaderSource(shaderID, 1, &codePtr, nullptr); // Assumes code is null terminated
@@ -0,0 +1,93 @@
+#include "transformhierarchy.h"
+
+#include <algorithm>
+
+void TransformHierarchy::setLocal(RenderData &renderData, int node, const glm::mat4 &local) {
+    renderData.hierarchy.locals[node] = local;
+    renderData.hierarchy.dirty.push_back(node);
+}
+
+glm::mat4 TransformHierarchy::world(const RenderHierarchy &hierarchy, int node) {
+    glm::mat4 ctm = hierarchy.locals[node];
+    for (int ancestor = hierarchy.parents[node]; ancestor >= 0; ancestor = hierarchy.parents[ancestor]) {
+        ctm = hierarchy.locals[ancestor] * ctm;
+    }
+    return ctm;
+}
+
+SceneLightData TransformHierarchy::transformLight(SceneLightData light, const glm::mat4 &ctm) {
+    light.dir = ctm * light.dir;
+    if (light.type != LightType::LIGHT_DIRECTIONAL) {
+        light.pos = ctm * light.pos;
+    }
+    if (light.type != LightType::LIGHT_POINT) {
+        light.dir = glm::normalize(light.dir);
+    }
+    return light;
+}
+
+TransformHierarchy::Update TransformHierarchy::update(RenderData &renderData, std::vector<AABB> *shapeBounds) {
+    RenderHierarchy &hierarchy = renderData.hierarchy;
+    Update moved;
+    if (hierarchy.dirty.empty()) {
+        return moved;
+    }
+
+    // Sorted, a dirty node inside an earlier dirty node's subtree comes before that subtree ends
+    std::sort(hierarchy.dirty.begin(), hierarchy.dirty.end());
+    std::vector<glm::mat4> worlds; // of the subtree being updated, indexed from its root
+    uint32_t covered = 0;
+    for (uint32_t root : hierarchy.dirty) {
+        if (root < covered) {
+            continue;
+        }
+        uint32_t end = root + hierarchy.subtreeSizes[root];
+        covered = end;
+
+        // Parents come before children, and every parent but the root's is inside the range
+        worlds.resize(end - root);
+        int parent = hierarchy.parents[root];
+        worlds[0] = parent >= 0 ? world(hierarchy, parent) * hierarchy.locals[root] : hierarchy.locals[root];
+        for (uint32_t node = root + 1; node < end; node++) {
+            worlds[node - root] = worlds[hierarchy.parents[node] - root] * hierarchy.locals[node];
+        }
+
+        for (uint32_t node = root; node < end; node++) {
+            const glm::mat4 &ctm = worlds[node - root];
+            for (uint32_t shape = hierarchy.firstShapes[node]; shape < hierarchy.firstShapes[node + 1]; shape++) {
+                renderData.shapes.ctms[shape] = ctm;
+                if (shapeBounds != nullptr) {
+                    (*shapeBounds)[shape] = transformBounds(unitPrimitiveBounds(), ctm);
+                }
+            }
+            for (uint32_t light = hierarchy.firstLights[node]; light < hierarchy.firstLights[node + 1]; light++) {
+                renderData.lights[light] = transformLight(hierarchy.localLights[light], ctm);
+            }
+        }
+        if (hierarchy.firstShapes[root] != hierarchy.firstShapes[end]) {
+            moved.shapeRanges.emplace_back(hierarchy.firstShapes[root], hierarchy.firstShapes[end]);
+        }
+        moved.lightsMoved |= hierarchy.firstLights[root] != hierarchy.firstLights[end];
+
+        for (uint32_t i = hierarchy.firstInstances[root]; i < hierarchy.firstInstances[end]; i++) {
+            int node = hierarchy.instanceNodes[i];
+            if (node >= int(root) && node < int(end)) {
+                renderData.instances[i].ctm = worlds[node - root];
+                moved.instancesMoved = true;
+            }
+        }
+    }
+    hierarchy.dirty.clear();
+
+    // The lights of the instances follow the scene's own, in instance order
+    if (moved.instancesMoved) {
+        size_t light = hierarchy.firstLights.back();
+        for (const RenderInstance &instance : renderData.instances) {
+            for (const SceneLightData &local : renderData.templates[instance.templateIndex].lights) {
+                renderData.lights[light++] = transformLight(local, instance.ctm);
+                moved.lightsMoved = true;
+            }
+        }
+    }
+    return moved;
+}
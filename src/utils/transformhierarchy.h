@@ -0,0 +1,36 @@
+#pragma once
+
+#include "sceneparser.h"
+#include "bounds.h"
+
+#include <utility>
+#include <vector>
+
+// Moving groups of a flattened scene without flattening it again. setLocal() replaces a node's
+// transformations and marks it dirty; update() then recomputes the world matrix of every node
+// under a dirty one, a subtree at a time in one linear pass over its contiguous range of
+// RenderHierarchy, and writes the results through to the subtree's shapes, lights and template
+// instances. Nothing outside the dirty subtrees is read or written, so animating a few nodes
+// costs time in proportion to their subtrees (and depth), not to the scene.
+namespace TransformHierarchy {
+    // What an update() moved
+    struct Update {
+        std::vector<std::pair<uint32_t, uint32_t>> shapeRanges; // [begin, end) of RenderData::shapes
+        bool lightsMoved = false;
+        bool instancesMoved = false; // and with them the lights of their templates, if any
+    };
+
+    // Replaces the composed transformations of a hierarchy node
+    void setLocal(RenderData &renderData, int node, const glm::mat4 &local);
+
+    // World matrix of a node, composed from its ancestors' locals
+    glm::mat4 world(const RenderHierarchy &hierarchy, int node);
+
+    // Brings everything under the nodes set since the last update up to date. shapeBounds, if
+    // given, holds the world bounds of each of RenderData::shapes and is refreshed along with
+    // their CTMs.
+    Update update(RenderData &renderData, std::vector<AABB> *shapeBounds = nullptr);
+
+    // A light relative to some node, moved by the node's world matrix ctm
+    SceneLightData transformLight(SceneLightData light, const glm::mat4 &ctm);
+}